@@ -0,0 +1,370 @@
+/* Copyright (c) 2025 Hans-Kristian Arntzen for Valve Corporation
+ * SPDX-License-Identifier: MIT
+ */
+
+#define NOMINMAX
+#include "blob_compression.hpp"
+#include "logging.hpp"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <string.h>
+
+namespace Util
+{
+static const char chunked_blob_magic[8] = { 'D', '3', 'D', 'L', 'Z', '4', 'C', 'B' };
+
+enum
+{
+	ChunkedBlobVersion = 1,
+	MinMatch = 4,
+	// The last match has to start this many bytes before the end of the block,
+	// and the last bytes are always literals.
+	MatchFindLimit = 12,
+	LastLiterals = 5,
+	MaxDistance = 65535,
+	HashLog = 14
+};
+
+static uint32_t read_u32(const uint8_t *ptr)
+{
+	uint32_t v;
+	memcpy(&v, ptr, sizeof(v));
+	return v;
+}
+
+static uint32_t hash_sequence(uint32_t seq)
+{
+	return (seq * 2654435761u) >> (32 - HashLog);
+}
+
+static bool write_length(uint8_t *&op, const uint8_t *oend, size_t len)
+{
+	while (len >= 255)
+	{
+		if (op >= oend)
+			return false;
+		*op++ = 255;
+		len -= 255;
+	}
+
+	if (op >= oend)
+		return false;
+	*op++ = uint8_t(len);
+	return true;
+}
+
+// A sequence is a token, literals and, unless it ends the block, a match.
+static bool write_sequence(uint8_t *&op, const uint8_t *oend, const uint8_t *literals, size_t num_literals,
+                           size_t offset, size_t match_length)
+{
+	if (op >= oend)
+		return false;
+
+	bool has_match = offset != 0;
+	size_t match_code = has_match ? match_length - MinMatch : 0;
+	*op++ = uint8_t((std::min<size_t>(num_literals, 15) << 4) | std::min<size_t>(match_code, 15));
+
+	if (num_literals >= 15 && !write_length(op, oend, num_literals - 15))
+		return false;
+
+	if (num_literals > size_t(oend - op))
+		return false;
+	memcpy(op, literals, num_literals);
+	op += num_literals;
+
+	if (!has_match)
+		return true;
+
+	if (oend - op < 2)
+		return false;
+	*op++ = uint8_t(offset & 0xff);
+	*op++ = uint8_t(offset >> 8);
+
+	return match_code < 15 || write_length(op, oend, match_code - 15);
+}
+
+size_t lz4_compress_bound(size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+size_t lz4_compress_block(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity)
+{
+	const uint8_t *ip = src;
+	const uint8_t *anchor = src;
+	const uint8_t *end = src + size;
+	uint8_t *op = dst;
+	const uint8_t *oend = dst + capacity;
+
+	if (size > MatchFindLimit)
+	{
+		// Greedy matching against the most recent position with the same hash.
+		std::vector<uint32_t> table(1u << HashLog, 0);
+		const uint8_t *match_limit = end - MatchFindLimit;
+		const uint8_t *extend_limit = end - LastLiterals;
+
+		while (ip < match_limit)
+		{
+			uint32_t seq = read_u32(ip);
+			uint32_t &entry = table[hash_sequence(seq)];
+			const uint8_t *ref = src + entry;
+			entry = uint32_t(ip - src);
+
+			if (ref >= ip || ip - ref > MaxDistance || read_u32(ref) != seq)
+			{
+				// Skip ahead faster through data which does not compress.
+				ip += 1 + ((ip - anchor) >> 6);
+				continue;
+			}
+
+			const uint8_t *match_end = ip + MinMatch;
+			ref += MinMatch;
+			while (match_end < extend_limit && *match_end == *ref)
+			{
+				match_end++;
+				ref++;
+			}
+
+			if (!write_sequence(op, oend, anchor, size_t(ip - anchor), size_t(match_end - ref),
+			                    size_t(match_end - ip)))
+				return 0;
+
+			ip = match_end;
+			anchor = ip;
+		}
+	}
+
+	if (!write_sequence(op, oend, anchor, size_t(end - anchor), 0, 0))
+		return 0;
+
+	return size_t(op - dst);
+}
+
+static bool read_length(const uint8_t *&ip, const uint8_t *iend, size_t &len)
+{
+	uint8_t b;
+	do
+	{
+		if (ip >= iend)
+			return false;
+		b = *ip++;
+		len += b;
+	} while (b == 255);
+
+	return true;
+}
+
+bool lz4_decompress_block(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size)
+{
+	const uint8_t *ip = src;
+	const uint8_t *iend = src + src_size;
+	uint8_t *op = dst;
+	uint8_t *oend = dst + dst_size;
+
+	while (ip < iend)
+	{
+		uint8_t token = *ip++;
+
+		size_t num_literals = token >> 4;
+		if (num_literals == 15 && !read_length(ip, iend, num_literals))
+			return false;
+
+		if (num_literals > size_t(iend - ip) || num_literals > size_t(oend - op))
+			return false;
+		memcpy(op, ip, num_literals);
+		ip += num_literals;
+		op += num_literals;
+
+		// The last sequence has no match.
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return false;
+		size_t offset = size_t(ip[0]) | (size_t(ip[1]) << 8);
+		ip += 2;
+
+		if (offset == 0 || offset > size_t(op - dst))
+			return false;
+
+		size_t match_length = token & 15;
+		if (match_length == 15 && !read_length(ip, iend, match_length))
+			return false;
+		match_length += MinMatch;
+
+		if (match_length > size_t(oend - op))
+			return false;
+
+		const uint8_t *ref = op - offset;
+		if (offset >= match_length)
+		{
+			memcpy(op, ref, match_length);
+			op += match_length;
+		}
+		else
+		{
+			// Overlapping matches repeat the last offset bytes.
+			for (size_t i = 0; i < match_length; i++)
+				*op++ = ref[i];
+		}
+	}
+
+	return op == oend;
+}
+
+static uint32_t get_num_chunks(uint64_t raw_size, uint32_t chunk_size)
+{
+	return uint32_t((raw_size + chunk_size - 1) / chunk_size);
+}
+
+bool parse_chunked_blob_header(const uint8_t *data, size_t size, ChunkedBlobHeader &header)
+{
+	if (size < sizeof(header))
+		return false;
+
+	memcpy(&header, data, sizeof(header));
+	return memcmp(header.magic, chunked_blob_magic, sizeof(chunked_blob_magic)) == 0 &&
+	       header.version == ChunkedBlobVersion && header.chunk_size != 0 &&
+	       header.num_chunks == get_num_chunks(header.raw_size, header.chunk_size);
+}
+
+// Runs func(index) for every index below count, spread over up to num_threads threads.
+template <typename Func>
+static bool parallel_for(uint32_t count, unsigned num_threads, const Func &func)
+{
+	std::atomic<uint32_t> next_index{0};
+	std::atomic<bool> success{true};
+
+	auto worker = [&]() {
+		uint32_t index;
+		while (success && (index = next_index.fetch_add(1, std::memory_order_relaxed)) < count)
+			if (!func(index))
+				success = false;
+	};
+
+	num_threads = std::max(1u, std::min<unsigned>(num_threads, count));
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < num_threads; i++)
+		threads.emplace_back(worker);
+	worker();
+	for (auto &thread : threads)
+		thread.join();
+
+	return success.load();
+}
+
+bool compress_chunked_blob(const uint8_t *data, size_t size, uint32_t chunk_size, unsigned num_threads,
+                           std::vector<uint8_t> &blob)
+{
+	ChunkedBlobHeader header = {};
+	memcpy(header.magic, chunked_blob_magic, sizeof(chunked_blob_magic));
+	header.version = ChunkedBlobVersion;
+	header.chunk_size = chunk_size;
+	header.raw_size = size;
+	header.num_chunks = get_num_chunks(size, chunk_size);
+
+	std::vector<std::vector<uint8_t>> chunks(header.num_chunks);
+
+	bool success = parallel_for(header.num_chunks, num_threads, [&](uint32_t index) -> bool {
+		size_t offset = size_t(index) * chunk_size;
+		size_t raw_size = std::min<size_t>(chunk_size, size - offset);
+
+		auto &chunk = chunks[index];
+		chunk.resize(lz4_compress_bound(raw_size));
+		size_t compressed_size = lz4_compress_block(data + offset, raw_size, chunk.data(), chunk.size());
+
+		// Chunks which do not shrink are stored as is, which also tells the decompressor to copy them.
+		if (compressed_size == 0 || compressed_size >= raw_size)
+			chunk.assign(data + offset, data + offset + raw_size);
+		else
+			chunk.resize(compressed_size);
+		return true;
+	});
+
+	if (!success)
+		return false;
+
+	size_t total_size = sizeof(header) + chunks.size() * sizeof(uint32_t);
+	for (auto &chunk : chunks)
+		total_size += chunk.size();
+
+	blob.clear();
+	blob.reserve(total_size);
+	blob.insert(blob.end(), reinterpret_cast<const uint8_t *>(&header),
+	            reinterpret_cast<const uint8_t *>(&header) + sizeof(header));
+
+	for (auto &chunk : chunks)
+	{
+		auto chunk_size_stored = uint32_t(chunk.size());
+		blob.insert(blob.end(), reinterpret_cast<const uint8_t *>(&chunk_size_stored),
+		            reinterpret_cast<const uint8_t *>(&chunk_size_stored) + sizeof(chunk_size_stored));
+	}
+
+	for (auto &chunk : chunks)
+		blob.insert(blob.end(), chunk.begin(), chunk.end());
+
+	return true;
+}
+
+bool decompress_chunked_blob(const uint8_t *blob, size_t size, uint8_t *dst, size_t dst_size, unsigned num_threads)
+{
+	ChunkedBlobHeader header;
+	if (!parse_chunked_blob_header(blob, size, header) || header.raw_size != dst_size)
+	{
+		LOGE("Invalid chunked blob header.\n");
+		return false;
+	}
+
+	size_t table_end = sizeof(header) + size_t(header.num_chunks) * sizeof(uint32_t);
+	if (table_end > size)
+	{
+		LOGE("Chunked blob is truncated.\n");
+		return false;
+	}
+
+	// Chunk offsets are implied by the sizes before them.
+	std::vector<size_t> offsets(header.num_chunks);
+	std::vector<uint32_t> sizes(header.num_chunks);
+	memcpy(sizes.data(), blob + sizeof(header), sizes.size() * sizeof(uint32_t));
+
+	size_t offset = table_end;
+	for (uint32_t i = 0; i < header.num_chunks; i++)
+	{
+		offsets[i] = offset;
+		if (sizes[i] > size - offset)
+		{
+			LOGE("Chunked blob is truncated.\n");
+			return false;
+		}
+		offset += sizes[i];
+	}
+
+	bool success = parallel_for(header.num_chunks, num_threads, [&](uint32_t index) -> bool {
+		size_t raw_offset = size_t(index) * header.chunk_size;
+		size_t raw_size = std::min<size_t>(header.chunk_size, dst_size - raw_offset);
+		const uint8_t *src = blob + offsets[index];
+
+		if (sizes[index] == raw_size)
+		{
+			memcpy(dst + raw_offset, src, raw_size);
+			return true;
+		}
+
+		// dst is typically write-combined staging memory. Matches read back what was just decoded,
+		// byte by byte for overlapping ones, so decode into cached memory and stream the chunk out.
+		thread_local std::vector<uint8_t> chunk;
+		chunk.resize(raw_size);
+		if (!lz4_decompress_block(src, sizes[index], chunk.data(), raw_size))
+			return false;
+
+		memcpy(dst + raw_offset, chunk.data(), raw_size);
+		return true;
+	});
+
+	if (!success)
+		LOGE("Failed to decompress chunked blob.\n");
+	return success;
+}
+}
@@ -0,0 +1,44 @@
+/* Copyright (c) 2025 Hans-Kristian Arntzen for Valve Corporation
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace Util
+{
+// LZ4 block format, compatible with LZ4_compress_default and LZ4_decompress_safe.
+// Returns the compressed size, or 0 if it does not fit in capacity.
+size_t lz4_compress_block(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity);
+size_t lz4_compress_bound(size_t size);
+// Fails unless src decodes to exactly dst_size bytes.
+bool lz4_decompress_block(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size);
+
+// A blob split into independently compressed chunks, so they can be decompressed in parallel:
+//   ChunkedBlobHeader
+//   uint32_t stored size of every chunk
+//   Chunks back to back. A chunk stored at its raw size is not compressed.
+struct ChunkedBlobHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t chunk_size;
+	uint64_t raw_size;
+	uint32_t num_chunks;
+	uint32_t reserved;
+};
+
+enum { DefaultBlobChunkSize = 256 * 1024 };
+
+// Returns false if data does not start with a valid header.
+bool parse_chunked_blob_header(const uint8_t *data, size_t size, ChunkedBlobHeader &header);
+
+bool compress_chunked_blob(const uint8_t *data, size_t size, uint32_t chunk_size, unsigned num_threads,
+                           std::vector<uint8_t> &blob);
+// dst must hold exactly header.raw_size bytes and is only ever written, so it may be write-combined memory.
+// Chunks are spread over up to num_threads threads.
+bool decompress_chunked_blob(const uint8_t *blob, size_t size, uint8_t *dst, size_t dst_size, unsigned num_threads);
+}
@@ -0,0 +1,353 @@
+/* Copyright (c) 2025 Hans-Kristian Arntzen for Valve Corporation
+ * SPDX-License-Identifier: MIT
+ */
+
+#define NOMINMAX
+#include "blob_reader.hpp"
+#include "logging.hpp"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include "path_utils.hpp"
+#else
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#include <errno.h>
+#endif
+
+namespace Util
+{
+void IOGate::pause()
+{
+	std::lock_guard<std::mutex> holder{lock};
+	paused = true;
+}
+
+void IOGate::resume()
+{
+	std::lock_guard<std::mutex> holder{lock};
+	paused = false;
+	cond.notify_all();
+}
+
+bool IOGate::is_paused() const
+{
+	std::lock_guard<std::mutex> holder{lock};
+	return paused;
+}
+
+void IOGate::wait()
+{
+	std::unique_lock<std::mutex> holder{lock};
+	cond.wait(holder, [this]() { return !paused; });
+}
+
+bool query_file_size(const std::string &path, size_t &size)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA attr;
+	if (!GetFileAttributesExW(Granite::Path::to_utf16(path).c_str(), GetFileExInfoStandard, &attr))
+		return false;
+	size = (size_t(attr.nFileSizeHigh) << 32) | attr.nFileSizeLow;
+#else
+	struct stat s = {};
+	if (stat(path.c_str(), &s) < 0)
+		return false;
+	size = size_t(s.st_size);
+#endif
+	return true;
+}
+
+static bool matches_file_size(const BlobRead &req, size_t file_size)
+{
+	if (req.packed)
+		return req.offset <= file_size && req.size <= file_size - req.offset;
+	else
+		return file_size == req.size;
+}
+
+class ThreadPoolBlobReader : public BlobReader
+{
+public:
+	bool read(const std::vector<BlobRead> &reads, const BlobReadCallback &on_complete) override
+	{
+		std::atomic<size_t> next_index{0};
+		std::atomic<bool> success{true};
+
+		auto worker = [&]() {
+			size_t index;
+			while ((index = next_index.fetch_add(1, std::memory_order_relaxed)) < reads.size())
+			{
+				if (gate)
+					gate->wait();
+
+				bool ok = read_file(reads[index]);
+				if (!ok)
+				{
+					LOGE("Failed to read \"%s\".\n", reads[index].path.c_str());
+					success = false;
+				}
+
+				if (on_complete)
+					on_complete(index, ok);
+			}
+		};
+
+		unsigned num_threads = std::max(1u, std::min(std::thread::hardware_concurrency(), 16u));
+		num_threads = unsigned(std::min<size_t>(num_threads, reads.size()));
+
+		std::vector<std::thread> threads;
+		for (unsigned i = 1; i < num_threads; i++)
+			threads.emplace_back(worker);
+		worker();
+		for (auto &t : threads)
+			t.join();
+
+		return success.load();
+	}
+
+	const char *get_backend_name() const override
+	{
+		return "threads";
+	}
+
+private:
+	static bool read_file(const BlobRead &req)
+	{
+		FILE *f = fopen(req.path.c_str(), "rb");
+		if (!f)
+			return false;
+
+#ifdef _WIN32
+		_fseeki64(f, 0, SEEK_END);
+		size_t len = _ftelli64(f);
+		bool ok = matches_file_size(req, len) && _fseeki64(f, int64_t(req.offset), SEEK_SET) == 0;
+#else
+		fseek(f, 0, SEEK_END);
+		size_t len = ftell(f);
+		bool ok = matches_file_size(req, len) && fseeko(f, off_t(req.offset), SEEK_SET) == 0;
+#endif
+
+		ok = ok && fread(req.dst, 1, req.size, f) == req.size;
+		fclose(f);
+		return ok;
+	}
+};
+
+#ifdef HAVE_LIBURING
+class IoUringBlobReader : public BlobReader
+{
+public:
+	~IoUringBlobReader() override
+	{
+		if (initialized)
+			io_uring_queue_exit(&ring);
+	}
+
+	bool init()
+	{
+		initialized = io_uring_queue_init(QueueDepth, &ring, 0) == 0;
+		return initialized;
+	}
+
+	bool read(const std::vector<BlobRead> &reads, const BlobReadCallback &on_complete) override
+	{
+		std::vector<FileState> files(reads.size());
+		Chunk chunks[QueueDepth];
+		std::vector<Chunk *> free_chunks;
+		for (auto &chunk : chunks)
+			free_chunks.push_back(&chunk);
+
+		size_t next_file = 0;
+		size_t completed = 0;
+		bool success = true;
+
+		auto complete = [&](size_t index) {
+			auto &file = files[index];
+			if (file.fd >= 0)
+				close(file.fd);
+			file.fd = -1;
+			file.done = true;
+
+			if (file.failed)
+			{
+				LOGE("Failed to read \"%s\".\n", reads[index].path.c_str());
+				success = false;
+			}
+
+			if (on_complete)
+				on_complete(index, !file.failed);
+			completed++;
+		};
+
+		while (completed < reads.size())
+		{
+			// While paused, chunks in flight still land but nothing new is queued.
+			bool paused = gate && gate->is_paused();
+			if (paused && free_chunks.size() == QueueDepth)
+			{
+				gate->wait();
+				paused = false;
+			}
+
+			// Keep the queue full. Files are split into chunks so large blobs also use the queue depth.
+			while (!paused && !free_chunks.empty() && next_file < reads.size())
+			{
+				auto &req = reads[next_file];
+				auto &file = files[next_file];
+
+				if (file.done || file.failed)
+				{
+					// Stop feeding chunks for a failed file, it completes once nothing is in flight.
+					if (!file.done && file.inflight == 0)
+						complete(next_file);
+					next_file++;
+					continue;
+				}
+
+				if (file.fd < 0)
+				{
+					file.fd = open(req.path.c_str(), O_RDONLY | O_CLOEXEC);
+					struct stat s = {};
+					if (file.fd < 0 || fstat(file.fd, &s) < 0 || !matches_file_size(req, size_t(s.st_size)))
+					{
+						file.failed = true;
+						continue;
+					}
+
+					if (req.size == 0)
+					{
+						complete(next_file++);
+						continue;
+					}
+				}
+
+				auto *sqe = io_uring_get_sqe(&ring);
+				if (!sqe)
+					break;
+
+				auto *chunk = free_chunks.back();
+				free_chunks.pop_back();
+
+				chunk->index = next_file;
+				chunk->offset = file.submitted;
+				chunk->size = uint32_t(std::min<size_t>(ChunkSize, req.size - file.submitted));
+				file.submitted += chunk->size;
+				file.inflight++;
+
+				io_uring_prep_read(sqe, file.fd, req.dst + chunk->offset, chunk->size, req.offset + chunk->offset);
+				io_uring_sqe_set_data(sqe, chunk);
+
+				if (file.submitted == req.size)
+					next_file++;
+			}
+
+			if (completed == reads.size())
+				break;
+
+			io_uring_submit(&ring);
+
+			io_uring_cqe *cqe = nullptr;
+			int ret = io_uring_wait_cqe(&ring, &cqe);
+			if (ret < 0)
+			{
+				if (ret == -EINTR)
+					continue;
+				LOGE("io_uring_wait_cqe failed (%d).\n", ret);
+				return false;
+			}
+
+			unsigned head;
+			unsigned num_cqes = 0;
+			io_uring_for_each_cqe(&ring, head, cqe)
+			{
+				num_cqes++;
+				auto *chunk = static_cast<Chunk *>(io_uring_cqe_get_data(cqe));
+				auto &file = files[chunk->index];
+				auto &req = reads[chunk->index];
+
+				if (cqe->res > 0 && uint32_t(cqe->res) < chunk->size)
+				{
+					// Short read, requeue the remainder.
+					chunk->offset += uint32_t(cqe->res);
+					chunk->size -= uint32_t(cqe->res);
+					auto *sqe = io_uring_get_sqe(&ring);
+					if (sqe)
+					{
+						io_uring_prep_read(sqe, file.fd, req.dst + chunk->offset, chunk->size, req.offset + chunk->offset);
+						io_uring_sqe_set_data(sqe, chunk);
+						continue;
+					}
+					file.failed = true;
+				}
+				else if (cqe->res <= 0)
+					file.failed = true;
+
+				free_chunks.push_back(chunk);
+				file.inflight--;
+
+				if (file.inflight == 0 && !file.done && (file.submitted == req.size || file.failed))
+					complete(chunk->index);
+			}
+			io_uring_cq_advance(&ring, num_cqes);
+		}
+
+		return success;
+	}
+
+	const char *get_backend_name() const override
+	{
+		return "io_uring";
+	}
+
+private:
+	enum { QueueDepth = 64, ChunkSize = 4 * 1024 * 1024 };
+
+	struct FileState
+	{
+		int fd = -1;
+		size_t submitted = 0;
+		uint32_t inflight = 0;
+		bool failed = false;
+		bool done = false;
+	};
+
+	struct Chunk
+	{
+		size_t index;
+		size_t offset;
+		uint32_t size;
+	};
+
+	io_uring ring = {};
+	bool initialized = false;
+};
+#endif
+
+std::unique_ptr<BlobReader> BlobReader::create(Backend backend)
+{
+#ifdef HAVE_LIBURING
+	if (backend == Backend::Auto || backend == Backend::IoUring)
+	{
+		std::unique_ptr<IoUringBlobReader> reader(new IoUringBlobReader);
+		if (reader->init())
+			return std::unique_ptr<BlobReader>(reader.release());
+		LOGW("Failed to initialize io_uring, falling back to thread pool.\n");
+	}
+#else
+	if (backend == Backend::IoUring)
+		LOGW("io_uring support not built in, falling back to thread pool.\n");
+#endif
+
+	return std::unique_ptr<BlobReader>(new ThreadPoolBlobReader);
+}
+}
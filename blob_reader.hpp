@@ -0,0 +1,76 @@
+/* Copyright (c) 2025 Hans-Kristian Arntzen for Valve Corporation
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Util
+{
+struct BlobRead
+{
+	std::string path;
+	// Caller owned, must hold exactly size bytes. The file must be exactly size bytes large,
+	// unless the blob is packed into a larger file at offset.
+	uint8_t *dst = nullptr;
+	size_t size = 0;
+	size_t offset = 0;
+	bool packed = false;
+};
+
+// Lets heavy file IO be held back while something timing sensitive runs.
+class IOGate
+{
+public:
+	void pause();
+	void resume();
+	bool is_paused() const;
+
+	// Blocks while paused.
+	void wait();
+
+private:
+	mutable std::mutex lock;
+	std::condition_variable cond;
+	bool paused = false;
+};
+
+// Called once per request as it finishes, potentially from multiple threads concurrently.
+using BlobReadCallback = std::function<void (size_t index, bool success)>;
+
+class BlobReader
+{
+public:
+	enum class Backend
+	{
+		Auto,
+		IoUring,
+		Threads
+	};
+
+	virtual ~BlobReader() = default;
+
+	// Queues every read up front and blocks until all have completed.
+	// Returns false if any read failed.
+	virtual bool read(const std::vector<BlobRead> &reads, const BlobReadCallback &on_complete) = 0;
+	virtual const char *get_backend_name() const = 0;
+
+	// Optional. Reads are not started while the gate is paused, reads in flight still complete.
+	void set_gate(IOGate *gate_) { gate = gate_; }
+
+	static std::unique_ptr<BlobReader> create(Backend backend);
+
+protected:
+	IOGate *gate = nullptr;
+};
+
+bool query_file_size(const std::string &path, size_t &size);
+}
@@ -0,0 +1,252 @@
+/* Copyright (c) 2025 Hans-Kristian Arntzen for Valve Corporation
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "blob_store.hpp"
+#include "blob_reader.hpp"
+#include "path_utils.hpp"
+#include "logging.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace Util
+{
+static const uint64_t Prime1 = 0x9e3779b185ebca87ull;
+static const uint64_t Prime2 = 0xc2b2ae3d27d4eb4full;
+static const uint64_t Prime3 = 0x165667b19e3779f9ull;
+static const uint64_t Prime4 = 0x85ebca77c2b2ae63ull;
+static const uint64_t Prime5 = 0x27d4eb2f165667c5ull;
+
+static const char blob_name_prefix[] = "xxh64:";
+
+static inline uint64_t rotl(uint64_t v, int r)
+{
+	return (v << r) | (v >> (64 - r));
+}
+
+static inline uint64_t read_u64(const uint8_t *ptr)
+{
+	uint64_t v;
+	memcpy(&v, ptr, sizeof(v));
+	return v;
+}
+
+static inline uint32_t read_u32(const uint8_t *ptr)
+{
+	uint32_t v;
+	memcpy(&v, ptr, sizeof(v));
+	return v;
+}
+
+static inline uint64_t hash_round(uint64_t acc, uint64_t input)
+{
+	acc += input * Prime2;
+	return rotl(acc, 31) * Prime1;
+}
+
+static inline uint64_t merge_round(uint64_t acc, uint64_t v)
+{
+	acc ^= hash_round(0, v);
+	return acc * Prime1 + Prime4;
+}
+
+Hash hash_blob(const void *data_, size_t size, uint64_t seed)
+{
+	auto *ptr = static_cast<const uint8_t *>(data_);
+	const uint8_t *end = ptr + size;
+	uint64_t h;
+
+	if (size >= 32)
+	{
+		// Four independent lanes keep the multipliers busy.
+		uint64_t v1 = seed + Prime1 + Prime2;
+		uint64_t v2 = seed + Prime2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - Prime1;
+
+		const uint8_t *limit = end - 32;
+		do
+		{
+			v1 = hash_round(v1, read_u64(ptr + 0));
+			v2 = hash_round(v2, read_u64(ptr + 8));
+			v3 = hash_round(v3, read_u64(ptr + 16));
+			v4 = hash_round(v4, read_u64(ptr + 24));
+			ptr += 32;
+		} while (ptr <= limit);
+
+		h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+		h = merge_round(h, v1);
+		h = merge_round(h, v2);
+		h = merge_round(h, v3);
+		h = merge_round(h, v4);
+	}
+	else
+		h = seed + Prime5;
+
+	h += uint64_t(size);
+
+	for (; ptr + 8 <= end; ptr += 8)
+	{
+		h ^= hash_round(0, read_u64(ptr));
+		h = rotl(h, 27) * Prime1 + Prime4;
+	}
+
+	if (ptr + 4 <= end)
+	{
+		h ^= uint64_t(read_u32(ptr)) * Prime1;
+		h = rotl(h, 23) * Prime2 + Prime3;
+		ptr += 4;
+	}
+
+	for (; ptr < end; ptr++)
+	{
+		h ^= *ptr * Prime5;
+		h = rotl(h, 11) * Prime1;
+	}
+
+	h ^= h >> 33;
+	h *= Prime2;
+	h ^= h >> 29;
+	h *= Prime3;
+	h ^= h >> 32;
+	return h;
+}
+
+bool is_blob_name(const char *name)
+{
+	return strncmp(name, blob_name_prefix, sizeof(blob_name_prefix) - 1) == 0;
+}
+
+bool parse_blob_name(const char *name, Hash &hash)
+{
+	if (!is_blob_name(name))
+		return false;
+
+	const char *digits = name + sizeof(blob_name_prefix) - 1;
+	if (strlen(digits) != 16)
+		return false;
+
+	char *end = nullptr;
+	hash = strtoull(digits, &end, 16);
+	return end == digits + 16;
+}
+
+static std::string hash_to_hex(Hash hash)
+{
+	char str[17];
+	snprintf(str, sizeof(str), "%016llx", static_cast<unsigned long long>(hash));
+	return str;
+}
+
+std::string get_blob_name(Hash hash)
+{
+	return blob_name_prefix + hash_to_hex(hash);
+}
+
+std::string get_blob_store_path(const std::string &store, Hash hash)
+{
+	auto hex = hash_to_hex(hash);
+	return Granite::Path::join(Granite::Path::join(store, hex.substr(0, 2)), hex);
+}
+
+bool add_blob_to_store(const std::string &store, const std::vector<uint8_t> &data, Hash &hash, bool &added)
+{
+	hash = hash_blob(data.data(), data.size());
+	added = false;
+
+	auto path = get_blob_store_path(store, hash);
+	size_t size = 0;
+	if (query_file_size(path, size))
+	{
+		if (size != data.size())
+		{
+			LOGE("Blob %s in the store has a different size, hash collision or corrupt store.\n", path.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	if (!Granite::Path::make_directory(store) || !Granite::Path::make_directory(Granite::Path::basedir(path)))
+	{
+		LOGE("Failed to create blob store directory for %s.\n", path.c_str());
+		return false;
+	}
+
+	// Readers only ever see complete blobs.
+	auto tmp_path = path + ".tmp";
+	FILE *f = fopen(tmp_path.c_str(), "wb");
+	if (!f)
+	{
+		LOGE("Failed to open %s for writing.\n", tmp_path.c_str());
+		return false;
+	}
+
+	bool success = fwrite(data.data(), 1, data.size(), f) == data.size();
+	if (fclose(f) != 0)
+		success = false;
+
+	success = success && Granite::Path::replace_file(tmp_path, path);
+
+	if (!success)
+	{
+		LOGE("Failed to write %s.\n", path.c_str());
+		remove(tmp_path.c_str());
+		return false;
+	}
+
+	added = true;
+	return true;
+}
+
+BlobCache::BlobCache(uint64_t budget_)
+	: budget(budget_)
+{
+}
+
+BlobCache::Blob BlobCache::find(Hash hash)
+{
+	std::lock_guard<std::mutex> holder{lock};
+	auto itr = entries.find(hash);
+	if (itr == entries.end())
+	{
+		stats.misses++;
+		return {};
+	}
+
+	lru.splice(lru.begin(), lru, itr->second);
+	stats.hits++;
+	stats.hit_bytes += itr->second->blob->size();
+	return itr->second->blob;
+}
+
+void BlobCache::insert(Hash hash, std::vector<uint8_t> data)
+{
+	if (data.size() > budget)
+		return;
+
+	Blob blob = std::make_shared<const std::vector<uint8_t>>(std::move(data));
+
+	std::lock_guard<std::mutex> holder{lock};
+	if (entries.count(hash))
+		return;
+
+	// Evicted blobs stay alive for as long as a capture still holds on to them.
+	while (!lru.empty() && stats.resident_bytes + blob->size() > budget)
+	{
+		stats.resident_bytes -= lru.back().blob->size();
+		entries.erase(lru.back().hash);
+		lru.pop_back();
+	}
+
+	stats.resident_bytes += blob->size();
+	lru.push_front({ hash, std::move(blob) });
+	entries[hash] = lru.begin();
+}
+
+BlobCache::Stats BlobCache::get_stats() const
+{
+	std::lock_guard<std::mutex> holder{lock};
+	return stats;
+}
+}
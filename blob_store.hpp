@@ -0,0 +1,66 @@
+/* Copyright (c) 2025 Hans-Kristian Arntzen for Valve Corporation
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include "hash.hpp"
+#include <stddef.h>
+#include <stdint.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Util
+{
+// XXH64. Unlike Hasher, fast enough for resource blobs.
+Hash hash_blob(const void *data, size_t size, uint64_t seed = 0);
+
+// Content-addressed blobs are referenced as "xxh64:<16 hex digits>" and live in
+// <store>/<first two hex digits>/<16 hex digits>.
+bool parse_blob_name(const char *name, Hash &hash);
+bool is_blob_name(const char *name);
+std::string get_blob_name(Hash hash);
+std::string get_blob_store_path(const std::string &store, Hash hash);
+
+// Writes data to the store unless a blob with its hash is already there.
+bool add_blob_to_store(const std::string &store, const std::vector<uint8_t> &data, Hash &hash, bool &added);
+
+// Keeps content-addressed blobs in memory as they are stored on disk, so a blob shared by several
+// captures is only read once per process. The least recently used blobs are evicted past the budget.
+// Safe to use from multiple threads.
+class BlobCache
+{
+public:
+	explicit BlobCache(uint64_t budget);
+
+	using Blob = std::shared_ptr<const std::vector<uint8_t>>;
+	Blob find(Hash hash);
+	void insert(Hash hash, std::vector<uint8_t> data);
+
+	struct Stats
+	{
+		uint64_t hits = 0;
+		uint64_t hit_bytes = 0;
+		uint64_t misses = 0;
+		uint64_t resident_bytes = 0;
+	};
+	Stats get_stats() const;
+
+private:
+	struct Entry
+	{
+		Hash hash;
+		Blob blob;
+	};
+
+	mutable std::mutex lock;
+	uint64_t budget;
+	std::list<Entry> lru;
+	std::unordered_map<Hash, std::list<Entry>::iterator> entries;
+	Stats stats;
+};
+}
@@ -0,0 +1,692 @@
+/* Copyright (c) 2025 Hans-Kristian Arntzen for Valve Corporation
+ * SPDX-License-Identifier: MIT
+ */
+
+#define NOMINMAX
+#include "capture_format.hpp"
+#include "file_mapping.hpp"
+#include "blob_reader.hpp"
+#include "blob_compression.hpp"
+#include "logging.hpp"
+#include <algorithm>
+#include <unordered_map>
+#include <stdio.h>
+#include <string.h>
+
+// Layout of a container:
+//   ContainerHeader
+//   ContainerSection[num_sections]
+//   Section payloads, each aligned to SectionAlignment.
+//   Blobs from blob_offset on, each aligned to BlobAlignment.
+// Offsets are absolute file offsets. Nothing refers to the blob region but the Blobs section,
+// so a container can be rewritten with different blob placement without touching the tables.
+
+namespace Util
+{
+enum
+{
+	ContainerVersion = 1,
+	SectionAlignment = 16,
+	BlobAlignment = 4096
+};
+
+static const char container_magic[8] = { 'D', '3', 'D', '1', '2', 'C', 'A', 'P' };
+
+struct ContainerHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t num_sections;
+	uint64_t blob_offset;
+	uint64_t file_size;
+};
+
+enum class ContainerSectionType : uint32_t
+{
+	// Zero terminated strings, referenced by byte offset.
+	Strings,
+	// ContainerBlob[]
+	Blobs,
+	// ContainerResource[]
+	Resources,
+	// DXGI_FORMAT[], referenced by ContainerResource.
+	CastFormats,
+	// Blob indices, one per mip level, referenced by ContainerResource.
+	ResourceData,
+	CBVs,
+	SRVs,
+	UAVs,
+	Samplers,
+	// ContainerPass[]
+	Passes,
+	// CaptureRootParameterDesc[], referenced by ContainerPass.
+	RootParameters,
+	// uint32_t[] root constants, referenced by ContainerPass.
+	Constants,
+	Count
+};
+
+struct ContainerSection
+{
+	ContainerSectionType type;
+	uint32_t count;
+	uint64_t offset;
+	uint64_t size;
+};
+
+struct ContainerBlob
+{
+	uint64_t offset;
+	uint64_t size;
+};
+
+enum { ContainerNoString = ~0u };
+
+struct ContainerResource
+{
+	uint32_t name;
+	uint32_t restore;
+	uint32_t first_cast_format;
+	uint32_t num_cast_formats;
+	uint32_t first_data;
+	uint32_t num_data;
+	uint32_t src_pixel_size;
+	uint32_t src_pixel_offset;
+	uint32_t dst_pixel_size;
+	uint32_t reserved;
+	D3D12_RESOURCE_DESC1 desc;
+};
+
+struct ContainerPass
+{
+	uint32_t name;
+	uint32_t cs;
+	uint32_t root_signature;
+	uint32_t dimensions[3];
+	uint32_t first_parameter;
+	uint32_t num_parameters;
+	uint32_t first_constant;
+	uint32_t num_constants;
+};
+
+static uint64_t align_offset(uint64_t offset, uint64_t alignment)
+{
+	return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+bool load_blob(const BlobRef &blob, std::vector<uint8_t> &data)
+{
+	FILE *f = fopen(blob.path.c_str(), "rb");
+	if (!f)
+	{
+		LOGE("Failed to open blob: %s\n", blob.path.c_str());
+		return false;
+	}
+
+	uint64_t offset = blob.offset;
+	uint64_t size = blob.size;
+	if (!blob.packed)
+	{
+		size_t file_size = 0;
+		if (!query_file_size(blob.path, file_size))
+			file_size = 0;
+		offset = 0;
+		size = file_size;
+	}
+
+#ifdef _WIN32
+	bool success = _fseeki64(f, int64_t(offset), SEEK_SET) == 0;
+#else
+	bool success = fseeko(f, off_t(offset), SEEK_SET) == 0;
+#endif
+
+	data.resize(size);
+	success = success && fread(data.data(), 1, data.size(), f) == data.size();
+	fclose(f);
+
+	if (!success || data.empty())
+	{
+		LOGE("Failed to read blob: %s\n", blob.path.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool query_blob_size(const BlobRef &blob, uint64_t &size)
+{
+	if (blob.packed)
+	{
+		size = blob.size;
+		return true;
+	}
+
+	size_t file_size = 0;
+	if (!query_file_size(blob.path, file_size))
+		return false;
+	size = file_size;
+	return true;
+}
+
+bool is_capture_container(const std::string &path)
+{
+	FILE *f = fopen(path.c_str(), "rb");
+	if (!f)
+		return false;
+
+	char magic[sizeof(container_magic)];
+	bool match = fread(magic, 1, sizeof(magic), f) == sizeof(magic) &&
+	             memcmp(magic, container_magic, sizeof(magic)) == 0;
+	fclose(f);
+	return match;
+}
+
+namespace
+{
+struct ContainerReader
+{
+	const uint8_t *data = nullptr;
+	const ContainerSection *sections[size_t(ContainerSectionType::Count)] = {};
+
+	const char *strings = nullptr;
+	uint64_t strings_size = 0;
+
+	template <typename T>
+	bool get_table(ContainerSectionType type, const T *&table, uint32_t &count) const
+	{
+		table = nullptr;
+		count = 0;
+
+		auto *section = sections[size_t(type)];
+		if (!section)
+			return true;
+
+		if (section->size != uint64_t(section->count) * sizeof(T))
+		{
+			LOGE("Section %u has unexpected size.\n", unsigned(type));
+			return false;
+		}
+
+		table = reinterpret_cast<const T *>(data + section->offset);
+		count = section->count;
+		return true;
+	}
+
+	bool get_string(uint32_t offset, std::string &str) const
+	{
+		if (offset == ContainerNoString)
+		{
+			str.clear();
+			return true;
+		}
+
+		if (offset >= strings_size)
+			return false;
+
+		auto *end = static_cast<const char *>(memchr(strings + offset, '\0', size_t(strings_size - offset)));
+		if (!end)
+			return false;
+
+		str.assign(strings + offset, end);
+		return true;
+	}
+};
+}
+
+template <typename T>
+static bool copy_table(const ContainerReader &reader, ContainerSectionType type, std::vector<T> &table)
+{
+	const T *entries;
+	uint32_t count;
+	if (!reader.get_table(type, entries, count))
+		return false;
+	table.assign(entries, entries + count);
+	return true;
+}
+
+static bool in_range(uint32_t first, uint32_t count, uint32_t size)
+{
+	return first <= size && count <= size - first;
+}
+
+bool read_capture_container(const std::string &path, CaptureDesc &desc, uint64_t &metadata_size)
+{
+	// Only the tables are touched here, blob pages stay out of memory until uploads read them.
+	FileMapping mapping;
+	if (!mapping.map(path))
+	{
+		LOGE("Failed to map capture container %s.\n", path.c_str());
+		return false;
+	}
+
+	ContainerHeader header;
+	if (mapping.size() < sizeof(header))
+	{
+		LOGE("Capture container %s is truncated.\n", path.c_str());
+		return false;
+	}
+
+	memcpy(&header, mapping.data(), sizeof(header));
+	if (memcmp(header.magic, container_magic, sizeof(container_magic)) != 0 ||
+	    header.version != ContainerVersion)
+	{
+		LOGE("%s is not a version %u capture container.\n", path.c_str(), unsigned(ContainerVersion));
+		return false;
+	}
+
+	if (header.file_size != mapping.size() || header.blob_offset > header.file_size ||
+	    header.blob_offset < sizeof(header) ||
+	    uint64_t(header.num_sections) * sizeof(ContainerSection) > header.blob_offset - sizeof(header))
+	{
+		LOGE("Capture container %s is truncated.\n", path.c_str());
+		return false;
+	}
+
+	ContainerReader reader;
+	reader.data = mapping.data();
+
+	auto *sections = reinterpret_cast<const ContainerSection *>(mapping.data() + sizeof(header));
+	for (uint32_t i = 0; i < header.num_sections; i++)
+	{
+		auto &section = sections[i];
+		if (section.offset % SectionAlignment != 0 || section.offset > header.blob_offset ||
+		    section.size > header.blob_offset - section.offset)
+		{
+			LOGE("Section %u of %s is out of bounds.\n", i, path.c_str());
+			return false;
+		}
+
+		// Unknown sections are skipped, so later versions can add optional ones.
+		if (uint32_t(section.type) < uint32_t(ContainerSectionType::Count))
+			reader.sections[size_t(section.type)] = &section;
+	}
+
+	if (auto *strings = reader.sections[size_t(ContainerSectionType::Strings)])
+	{
+		reader.strings = reinterpret_cast<const char *>(mapping.data() + strings->offset);
+		reader.strings_size = strings->size;
+	}
+
+	const ContainerBlob *blobs;
+	const ContainerResource *resources;
+	const uint32_t *resource_data;
+	const ContainerPass *passes;
+	const CaptureRootParameterDesc *parameters;
+	const uint32_t *constants;
+	std::vector<DXGI_FORMAT> cast_formats;
+	uint32_t num_blobs, num_resources, num_resource_data, num_passes, num_parameters, num_constants;
+
+	desc = {};
+	if (!reader.get_table(ContainerSectionType::Blobs, blobs, num_blobs) ||
+	    !reader.get_table(ContainerSectionType::Resources, resources, num_resources) ||
+	    !reader.get_table(ContainerSectionType::ResourceData, resource_data, num_resource_data) ||
+	    !reader.get_table(ContainerSectionType::Passes, passes, num_passes) ||
+	    !reader.get_table(ContainerSectionType::RootParameters, parameters, num_parameters) ||
+	    !reader.get_table(ContainerSectionType::Constants, constants, num_constants) ||
+	    !copy_table(reader, ContainerSectionType::CastFormats, cast_formats) ||
+	    !copy_table(reader, ContainerSectionType::CBVs, desc.cbvs) ||
+	    !copy_table(reader, ContainerSectionType::SRVs, desc.srvs) ||
+	    !copy_table(reader, ContainerSectionType::UAVs, desc.uavs) ||
+	    !copy_table(reader, ContainerSectionType::Samplers, desc.samplers))
+	{
+		LOGE("Capture container %s is malformed.\n", path.c_str());
+		return false;
+	}
+
+	std::vector<BlobRef> blob_refs(num_blobs);
+	for (uint32_t i = 0; i < num_blobs; i++)
+	{
+		if (blobs[i].offset < header.blob_offset || blobs[i].offset > header.file_size ||
+		    blobs[i].size > header.file_size - blobs[i].offset)
+		{
+			LOGE("Blob %u of %s is out of bounds.\n", i, path.c_str());
+			return false;
+		}
+
+		blob_refs[i].path = path;
+		blob_refs[i].offset = blobs[i].offset;
+		blob_refs[i].size = blobs[i].size;
+		blob_refs[i].packed = true;
+	}
+
+	desc.resources.resize(num_resources);
+	for (uint32_t i = 0; i < num_resources; i++)
+	{
+		auto &src = resources[i];
+		auto &dst = desc.resources[i];
+
+		if (!reader.get_string(src.name, dst.name) || !reader.get_string(src.restore, dst.restore) ||
+		    !in_range(src.first_cast_format, src.num_cast_formats, uint32_t(cast_formats.size())) ||
+		    !in_range(src.first_data, src.num_data, num_resource_data))
+		{
+			LOGE("Resource %u of %s is malformed.\n", i, path.c_str());
+			return false;
+		}
+
+		dst.desc = src.desc;
+		dst.cast_formats.assign(cast_formats.begin() + src.first_cast_format,
+		                        cast_formats.begin() + src.first_cast_format + src.num_cast_formats);
+		dst.src_pixel_size = src.src_pixel_size;
+		dst.src_pixel_offset = src.src_pixel_offset;
+		dst.dst_pixel_size = src.dst_pixel_size;
+
+		for (uint32_t mip = 0; mip < src.num_data; mip++)
+		{
+			uint32_t blob = resource_data[src.first_data + mip];
+			if (blob >= num_blobs)
+			{
+				LOGE("Resource %u of %s refers to a missing blob.\n", i, path.c_str());
+				return false;
+			}
+			dst.data.push_back(blob_refs[blob]);
+		}
+	}
+
+	desc.passes.resize(num_passes);
+	for (uint32_t i = 0; i < num_passes; i++)
+	{
+		auto &src = passes[i];
+		auto &dst = desc.passes[i];
+
+		if (!reader.get_string(src.name, dst.name) || src.cs >= num_blobs || src.root_signature >= num_blobs ||
+		    !in_range(src.first_parameter, src.num_parameters, num_parameters) ||
+		    !in_range(src.first_constant, src.num_constants, num_constants))
+		{
+			LOGE("Pass %u of %s is malformed.\n", i, path.c_str());
+			return false;
+		}
+
+		dst.cs = blob_refs[src.cs];
+		dst.root_signature = blob_refs[src.root_signature];
+		memcpy(dst.dimensions, src.dimensions, sizeof(dst.dimensions));
+		dst.parameters.assign(parameters + src.first_parameter, parameters + src.first_parameter + src.num_parameters);
+		dst.constants.assign(constants + src.first_constant, constants + src.first_constant + src.num_constants);
+
+		for (auto &param : dst.parameters)
+		{
+			if (param.type == CaptureRootParameterType::Constant &&
+			    !in_range(param.constant_offset, param.constant_count, src.num_constants))
+			{
+				LOGE("Root constants of pass %u of %s are out of bounds.\n", i, path.c_str());
+				return false;
+			}
+		}
+	}
+
+	metadata_size = header.blob_offset;
+	return true;
+}
+
+namespace
+{
+struct ContainerWriter
+{
+	std::string strings;
+	std::unordered_map<std::string, uint32_t> string_offsets;
+
+	std::vector<BlobRef> blobs;
+	std::vector<bool> compressible;
+	std::unordered_map<std::string, uint32_t> blob_indices;
+
+	struct Section
+	{
+		ContainerSectionType type;
+		uint32_t count;
+		const void *data;
+		size_t size;
+	};
+	std::vector<Section> sections;
+
+	uint32_t add_string(const std::string &str)
+	{
+		auto itr = string_offsets.find(str);
+		if (itr != string_offsets.end())
+			return itr->second;
+
+		auto offset = uint32_t(strings.size());
+		strings.append(str.c_str(), str.size() + 1);
+		string_offsets[str] = offset;
+		return offset;
+	}
+
+	// Passes tend to share shaders, every distinct blob is stored once.
+	uint32_t add_blob(const BlobRef &blob, bool compress = false)
+	{
+		auto key = blob.path + '\n' + std::to_string(blob.offset) + '\n' + std::to_string(blob.size);
+		auto itr = blob_indices.find(key);
+		if (itr != blob_indices.end())
+		{
+			// Only compress blobs which nothing needs to read raw.
+			compressible[itr->second] = compressible[itr->second] && compress;
+			return itr->second;
+		}
+
+		auto index = uint32_t(blobs.size());
+		blobs.push_back(blob);
+		compressible.push_back(compress);
+		blob_indices[key] = index;
+		return index;
+	}
+
+	template <typename T>
+	void add_section(ContainerSectionType type, const std::vector<T> &table)
+	{
+		if (!table.empty())
+			sections.push_back({ type, uint32_t(table.size()), table.data(), table.size() * sizeof(T) });
+	}
+};
+}
+
+static bool write_padding(FILE *file, uint64_t &offset, uint64_t target)
+{
+	static const uint8_t zeroes[BlobAlignment] = {};
+	while (offset < target)
+	{
+		size_t size = size_t(std::min<uint64_t>(target - offset, sizeof(zeroes)));
+		if (fwrite(zeroes, 1, size, file) != size)
+			return false;
+		offset += size;
+	}
+
+	return true;
+}
+
+// Compressed blobs are kept in memory until they are written, since their size is needed for the layout.
+// Blobs which are already chunked or do not shrink are left alone.
+static bool compress_blobs(const ContainerWriter &writer, const ContainerWriteOptions &options,
+                           std::vector<ContainerBlob> &blobs, std::vector<std::vector<uint8_t>> &compressed)
+{
+	uint32_t chunk_size = options.chunk_size ? options.chunk_size : uint32_t(DefaultBlobChunkSize);
+	uint64_t raw_bytes = 0, stored_bytes = 0;
+	compressed.resize(blobs.size());
+
+	std::vector<uint8_t> data;
+	for (size_t i = 0; i < blobs.size(); i++)
+	{
+		if (!writer.compressible[i])
+			continue;
+
+		ChunkedBlobHeader header;
+		if (!load_blob(writer.blobs[i], data))
+			return false;
+		if (parse_chunked_blob_header(data.data(), data.size(), header))
+			continue;
+
+		if (!compress_chunked_blob(data.data(), data.size(), chunk_size, options.num_threads, compressed[i]))
+		{
+			LOGE("Failed to compress blob %s.\n", writer.blobs[i].path.c_str());
+			return false;
+		}
+
+		raw_bytes += data.size();
+		if (compressed[i].size() < data.size())
+			blobs[i].size = compressed[i].size();
+		else
+			compressed[i] = {};
+		stored_bytes += blobs[i].size;
+	}
+
+	LOGI("Compressed %.3f MiB of resource data to %.3f MiB.\n",
+	     double(raw_bytes) / (1024.0 * 1024.0), double(stored_bytes) / (1024.0 * 1024.0));
+	return true;
+}
+
+bool write_capture_container(const std::string &path, const CaptureDesc &desc, const ContainerWriteOptions &options)
+{
+	ContainerWriter writer;
+
+	std::vector<ContainerResource> resources;
+	std::vector<DXGI_FORMAT> cast_formats;
+	std::vector<uint32_t> resource_data;
+	for (auto &src : desc.resources)
+	{
+		ContainerResource dst = {};
+		dst.name = writer.add_string(src.name);
+		dst.restore = src.restore.empty() ? uint32_t(ContainerNoString) : writer.add_string(src.restore);
+		dst.first_cast_format = uint32_t(cast_formats.size());
+		dst.num_cast_formats = uint32_t(src.cast_formats.size());
+		dst.first_data = uint32_t(resource_data.size());
+		dst.num_data = uint32_t(src.data.size());
+		dst.src_pixel_size = src.src_pixel_size;
+		dst.src_pixel_offset = src.src_pixel_offset;
+		dst.dst_pixel_size = src.dst_pixel_size;
+		dst.desc = src.desc;
+		resources.push_back(dst);
+
+		cast_formats.insert(cast_formats.end(), src.cast_formats.begin(), src.cast_formats.end());
+		for (auto &blob : src.data)
+			resource_data.push_back(writer.add_blob(blob, options.compress_data));
+	}
+
+	std::vector<ContainerPass> passes;
+	std::vector<CaptureRootParameterDesc> parameters;
+	std::vector<uint32_t> constants;
+	for (auto &src : desc.passes)
+	{
+		ContainerPass dst = {};
+		dst.name = writer.add_string(src.name);
+		dst.cs = writer.add_blob(src.cs);
+		dst.root_signature = writer.add_blob(src.root_signature);
+		memcpy(dst.dimensions, src.dimensions, sizeof(dst.dimensions));
+		dst.first_parameter = uint32_t(parameters.size());
+		dst.num_parameters = uint32_t(src.parameters.size());
+		dst.first_constant = uint32_t(constants.size());
+		dst.num_constants = uint32_t(src.constants.size());
+		passes.push_back(dst);
+
+		parameters.insert(parameters.end(), src.parameters.begin(), src.parameters.end());
+		constants.insert(constants.end(), src.constants.begin(), src.constants.end());
+	}
+
+	std::vector<ContainerBlob> blobs(writer.blobs.size());
+	for (size_t i = 0; i < blobs.size(); i++)
+	{
+		if (!query_blob_size(writer.blobs[i], blobs[i].size))
+		{
+			LOGE("Failed to query size of blob %s.\n", writer.blobs[i].path.c_str());
+			return false;
+		}
+	}
+
+	std::vector<std::vector<uint8_t>> compressed;
+	if (options.compress_data && !compress_blobs(writer, options, blobs, compressed))
+		return false;
+
+	std::vector<char> strings(writer.strings.begin(), writer.strings.end());
+	writer.add_section(ContainerSectionType::Strings, strings);
+	writer.add_section(ContainerSectionType::Blobs, blobs);
+	writer.add_section(ContainerSectionType::Resources, resources);
+	writer.add_section(ContainerSectionType::CastFormats, cast_formats);
+	writer.add_section(ContainerSectionType::ResourceData, resource_data);
+	writer.add_section(ContainerSectionType::CBVs, desc.cbvs);
+	writer.add_section(ContainerSectionType::SRVs, desc.srvs);
+	writer.add_section(ContainerSectionType::UAVs, desc.uavs);
+	writer.add_section(ContainerSectionType::Samplers, desc.samplers);
+	writer.add_section(ContainerSectionType::Passes, passes);
+	writer.add_section(ContainerSectionType::RootParameters, parameters);
+	writer.add_section(ContainerSectionType::Constants, constants);
+
+	ContainerHeader header = {};
+	memcpy(header.magic, container_magic, sizeof(container_magic));
+	header.version = ContainerVersion;
+	header.num_sections = uint32_t(writer.sections.size());
+
+	// Blob offsets are part of the Blobs section, so the layout is settled before anything is written.
+	std::vector<ContainerSection> section_table;
+	uint64_t offset = sizeof(header) + writer.sections.size() * sizeof(ContainerSection);
+	for (auto &section : writer.sections)
+	{
+		offset = align_offset(offset, SectionAlignment);
+		section_table.push_back({ section.type, section.count, offset, section.size });
+		offset += section.size;
+	}
+
+	header.blob_offset = align_offset(offset, BlobAlignment);
+	offset = header.blob_offset;
+	for (auto &blob : blobs)
+	{
+		blob.offset = offset;
+		offset = align_offset(offset + blob.size, BlobAlignment);
+	}
+	header.file_size = blobs.empty() ? header.blob_offset : blobs.back().offset + blobs.back().size;
+
+	FILE *file = fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		LOGE("Failed to open %s for writing.\n", path.c_str());
+		return false;
+	}
+
+	offset = 0;
+	auto write_data = [&](const void *data, size_t size) -> bool {
+		offset += size;
+		return fwrite(data, 1, size, file) == size;
+	};
+
+	bool success = write_data(&header, sizeof(header)) &&
+	               write_data(section_table.data(), section_table.size() * sizeof(ContainerSection));
+
+	for (size_t i = 0; success && i < writer.sections.size(); i++)
+	{
+		success = write_padding(file, offset, section_table[i].offset) &&
+		          write_data(writer.sections[i].data, writer.sections[i].size);
+	}
+
+	std::vector<uint8_t> data;
+	for (size_t i = 0; success && i < blobs.size(); i++)
+	{
+		if (!compressed.empty() && !compressed[i].empty())
+		{
+			success = write_padding(file, offset, blobs[i].offset) &&
+			          write_data(compressed[i].data(), compressed[i].size());
+			compressed[i] = {};
+			continue;
+		}
+
+		success = write_padding(file, offset, blobs[i].offset) && load_blob(writer.blobs[i], data);
+		if (success && data.size() != blobs[i].size)
+		{
+			LOGE("Blob %s changed size while converting.\n", writer.blobs[i].path.c_str());
+			success = false;
+		}
+		success = success && write_data(data.data(), data.size());
+	}
+
+	success = success && write_padding(file, offset, header.file_size);
+
+	if (fclose(file) != 0)
+		success = false;
+
+	if (!success)
+	{
+		LOGE("Failed to write capture container %s.\n", path.c_str());
+		remove(path.c_str());
+		return false;
+	}
+
+	LOGI("Wrote capture container %s: %zu resources, %zu passes, %zu blobs, %llu bytes.\n",
+	     path.c_str(), desc.resources.size(), desc.passes.size(), blobs.size(),
+	     static_cast<unsigned long long>(header.file_size));
+	return true;
+}
+}
@@ -0,0 +1,153 @@
+/* Copyright (c) 2025 Hans-Kristian Arntzen for Valve Corporation
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include "vkd3d_windows.h"
+#include "vkd3d_d3d12.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace Util
+{
+// Bytes of a blob, either a file of its own or a range packed into a capture container.
+struct BlobRef
+{
+	std::string path;
+	uint64_t offset = 0;
+	// Only meaningful for packed blobs, standalone files are used whole.
+	uint64_t size = 0;
+	bool packed = false;
+	// Non-zero for blobs of a content-addressed store, see blob_store.hpp.
+	uint64_t content_hash = 0;
+
+	bool operator==(const BlobRef &other) const
+	{
+		return path == other.path && offset == other.offset && size == other.size && packed == other.packed;
+	}
+};
+
+bool load_blob(const BlobRef &blob, std::vector<uint8_t> &data);
+// Standalone files are stat'ed, packed blobs already know their size.
+bool query_blob_size(const BlobRef &blob, uint64_t &size);
+
+// Everything a capture describes, with no device objects created yet.
+// Views and root parameters refer to resources by their index in CaptureDesc::resources.
+enum { CaptureNoResource = ~0u };
+
+struct CaptureResourceDesc
+{
+	std::string name;
+	D3D12_RESOURCE_DESC1 desc = {};
+	// Sorted and without duplicates.
+	std::vector<DXGI_FORMAT> cast_formats;
+	// Empty unless the resource overrides the restore policy.
+	std::string restore;
+	// Texel layout of texture blobs, see write_blob_to_staging.
+	uint32_t src_pixel_size = 0;
+	uint32_t src_pixel_offset = 0;
+	uint32_t dst_pixel_size = 0;
+	// One per mip level, empty for resources without initial data.
+	std::vector<BlobRef> data;
+};
+
+// Views are plain old data, so the container stores them as is.
+struct CaptureCBVDesc
+{
+	uint32_t resource;
+	uint32_t heap_offset;
+	uint64_t buffer_offset;
+	uint32_t size_in_bytes;
+	uint32_t reserved;
+};
+
+struct CaptureSRVDesc
+{
+	uint32_t resource;
+	uint32_t heap_offset;
+	D3D12_SHADER_RESOURCE_VIEW_DESC desc;
+};
+
+struct CaptureUAVDesc
+{
+	uint32_t resource;
+	uint32_t counter_resource;
+	uint32_t heap_offset;
+	uint32_t reserved;
+	D3D12_UNORDERED_ACCESS_VIEW_DESC desc;
+};
+
+struct CaptureSamplerDesc
+{
+	uint32_t heap_offset;
+	D3D12_SAMPLER_DESC desc;
+};
+
+enum class CaptureRootParameterType : uint32_t
+{
+	ResourceTable,
+	SamplerTable,
+	Constant,
+	SRV,
+	UAV,
+	CBV
+};
+
+struct CaptureRootParameterDesc
+{
+	CaptureRootParameterType type;
+	uint32_t index;
+	// Heap slot for tables, byte offset into the resource for root descriptors.
+	uint64_t offset;
+	uint32_t resource;
+	// Range in CapturePassDesc::constants for root constants.
+	uint32_t constant_offset;
+	uint32_t constant_count;
+	uint32_t reserved;
+};
+
+struct CapturePassDesc
+{
+	std::string name;
+	BlobRef cs;
+	BlobRef root_signature;
+	uint32_t dimensions[3] = {};
+	std::vector<CaptureRootParameterDesc> parameters;
+	std::vector<uint32_t> constants;
+};
+
+struct CaptureDesc
+{
+	std::vector<CaptureResourceDesc> resources;
+	std::vector<CaptureCBVDesc> cbvs;
+	std::vector<CaptureSRVDesc> srvs;
+	std::vector<CaptureUAVDesc> uavs;
+	std::vector<CaptureSamplerDesc> samplers;
+	std::vector<CapturePassDesc> passes;
+};
+
+// Single file capture container: a header, typed tables holding the descs above in their native
+// little-endian layout, then every blob aligned to a page so it can be mapped or read with direct IO.
+// See capture_format.cpp for the layout.
+bool is_capture_container(const std::string &path);
+
+// Blobs of the returned desc refer to ranges of the container at path.
+// metadata_size receives the size of everything but the blobs.
+bool read_capture_container(const std::string &path, CaptureDesc &desc, uint64_t &metadata_size);
+
+struct ContainerWriteOptions
+{
+	// Resource data is stored as chunked LZ4 blobs where that makes it smaller.
+	// Shaders and root signatures are always stored raw.
+	bool compress_data = false;
+	uint32_t chunk_size = 0;
+	unsigned num_threads = 1;
+};
+
+// Copies every blob of desc into a single file.
+bool write_capture_container(const std::string &path, const CaptureDesc &desc,
+                             const ContainerWriteOptions &options = {});
+}
@@ -33,7 +33,7 @@ private:
 			ptr->Release();
 		ptr = nullptr;
 	}
-	ComPtr *self_addr() { return this; }
+	const ComPtr *self_addr() const { return this; }
 };
 
 template <typename T>
@@ -41,7 +41,8 @@ ComPtr<T> &ComPtr<T>::operator=(const ComPtr &other)
 {
 	if (this == other.self_addr())
 		return *this;
-	other.ptr->AddRef();
+	if (other.ptr)
+		other.ptr->AddRef();
 	release();
 	ptr = other.ptr;
 	return *this;
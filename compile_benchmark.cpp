@@ -0,0 +1,409 @@
+/* Copyright (c) 2025 Hans-Kristian Arntzen for Valve Corporation
+ * SPDX-License-Identifier: MIT
+ */
+
+#define NOMINMAX
+#include "compile_benchmark.hpp"
+#include "timing_stats.hpp"
+#include "hash.hpp"
+#include "logging.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string.h>
+
+#ifdef HAVE_VKD3D_SHADER
+#include "vulkan/vulkan.h"
+#include "vkd3d_windows.h"
+// A C header, which names a parameter after a C++ keyword.
+#define export export_name
+#include "vkd3d_shader.h"
+#undef export
+#endif
+
+namespace Util
+{
+bool run_scaling_benchmark(size_t count, unsigned max_threads,
+                           const std::function<bool (size_t)> &task,
+                           const std::function<void ()> &end_round,
+                           std::vector<uint64_t> &single_thread_ns)
+{
+	std::vector<unsigned> thread_counts;
+	for (unsigned num_threads = 1; num_threads < max_threads; num_threads *= 2)
+		thread_counts.push_back(num_threads);
+	thread_counts.push_back(std::max(max_threads, 1u));
+
+	double single_thread_throughput = 0.0;
+
+	for (auto num_threads : thread_counts)
+	{
+		std::vector<uint64_t> task_ns(count);
+		std::atomic<size_t> next_index{0};
+		std::atomic<bool> failed{false};
+
+		auto start_time = std::chrono::steady_clock::now();
+
+		std::vector<std::thread> threads;
+		for (unsigned i = 0; i < num_threads; i++)
+		{
+			threads.emplace_back([&]() {
+				size_t index;
+				while (!failed && (index = next_index.fetch_add(1, std::memory_order_relaxed)) < count)
+				{
+					auto task_start = std::chrono::steady_clock::now();
+					if (!task(index))
+						failed = true;
+					task_ns[index] = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+							std::chrono::steady_clock::now() - task_start).count());
+				}
+			});
+		}
+
+		for (auto &thread : threads)
+			thread.join();
+
+		double wall_ms = 1e-6 * double(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - start_time).count());
+
+		if (end_round)
+			end_round();
+
+		if (failed)
+			return false;
+
+		TimingStats latency;
+		for (auto ns : task_ns)
+			latency.add(ns);
+		auto summary = latency.summarize(false);
+
+		double throughput = 1e3 * double(count) / wall_ms;
+		if (num_threads == 1)
+		{
+			single_thread_throughput = throughput;
+			single_thread_ns = task_ns;
+		}
+
+		// Throughput relative to perfect linear scaling from one thread.
+		double efficiency = throughput / (single_thread_throughput * double(num_threads));
+
+		LOGI("%3u threads: %9.1f per second in %9.3f ms, scaling efficiency %5.1f %%, "
+		     "latency mean %.3f ms, p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms.\n",
+		     num_threads, throughput, wall_ms, 100.0 * efficiency,
+		     1e-6 * summary.mean, 1e-6 * summary.p50, 1e-6 * summary.p90, 1e-6 * summary.p99, 1e-6 * summary.max);
+	}
+
+	return true;
+}
+
+#ifdef HAVE_VKD3D_SHADER
+// Approximates the bindless layout vkd3d-proton builds for a root signature. The exact sets and bindings
+// depend on device features, but they do not change how much work the translation is.
+enum
+{
+	SamplerHeapSet = 0,
+	ResourceHeapSet = 1,
+	StaticSamplerSet = 2
+};
+
+enum
+{
+	SampledImageBinding = 0,
+	UniformTexelBufferBinding = 1,
+	StorageImageBinding = 2,
+	StorageTexelBufferBinding = 3,
+	UniformBufferBinding = 4,
+	CounterBufferBinding = 5
+};
+
+struct ShaderInterface
+{
+	std::vector<vkd3d_shader_resource_binding> bindings;
+	std::vector<vkd3d_shader_push_constant_buffer> push_constants;
+	vkd3d_shader_interface_info info = {};
+};
+
+static bool parse_root_signature_desc(const std::vector<uint8_t> &data, vkd3d_versioned_root_signature_desc &desc)
+{
+	vkd3d_shader_hash_t compatibility_hash = 0;
+	int ret;
+
+	if (data.size() >= 4 && memcmp(data.data(), "DXBC", 4) == 0)
+	{
+		vkd3d_shader_code code = {};
+		code.code = data.data();
+		code.size = data.size();
+		ret = vkd3d_shader_parse_root_signature(&code, &desc, &compatibility_hash);
+	}
+	else
+	{
+		ret = vkd3d_shader_parse_root_signature_raw(reinterpret_cast<const char *>(data.data()),
+		                                            unsigned(data.size()), &desc, &compatibility_hash);
+	}
+
+	if (ret != VKD3D_OK)
+		return false;
+
+	if (desc.version == VKD3D_ROOT_SIGNATURE_VERSION_1_2)
+		return true;
+
+	vkd3d_versioned_root_signature_desc converted = {};
+	ret = vkd3d_shader_convert_root_signature(&converted, VKD3D_ROOT_SIGNATURE_VERSION_1_2, &desc);
+	vkd3d_shader_free_root_signature(&desc);
+	if (ret != VKD3D_OK)
+		return false;
+
+	desc = converted;
+	return true;
+}
+
+static void add_binding(ShaderInterface &iface, vkd3d_shader_descriptor_type type,
+                        unsigned register_space, unsigned register_index, unsigned register_count,
+                        unsigned table, unsigned offset, unsigned flags, unsigned set, unsigned binding)
+{
+	vkd3d_shader_resource_binding b = {};
+	b.type = type;
+	b.register_space = register_space;
+	b.register_index = register_index;
+	b.register_count = register_count;
+	b.descriptor_table = table;
+	b.descriptor_offset = offset;
+	b.shader_visibility = VKD3D_SHADER_VISIBILITY_ALL;
+	b.flags = flags;
+	b.binding.set = set;
+	b.binding.binding = binding;
+	iface.bindings.push_back(b);
+}
+
+static void add_range_bindings(ShaderInterface &iface, const vkd3d_descriptor_range1 &range,
+                               unsigned table, unsigned offset)
+{
+	unsigned bindless = VKD3D_SHADER_BINDING_FLAG_BINDLESS;
+	unsigned space = range.register_space;
+	unsigned reg = range.base_shader_register;
+	unsigned count = range.descriptor_count;
+
+	switch (range.range_type)
+	{
+	case VKD3D_DESCRIPTOR_RANGE_TYPE_SRV:
+		add_binding(iface, VKD3D_SHADER_DESCRIPTOR_TYPE_SRV, space, reg, count, table, offset,
+		            bindless | VKD3D_SHADER_BINDING_FLAG_BUFFER, ResourceHeapSet, UniformTexelBufferBinding);
+		add_binding(iface, VKD3D_SHADER_DESCRIPTOR_TYPE_SRV, space, reg, count, table, offset,
+		            bindless | VKD3D_SHADER_BINDING_FLAG_IMAGE, ResourceHeapSet, SampledImageBinding);
+		break;
+
+	case VKD3D_DESCRIPTOR_RANGE_TYPE_UAV:
+		add_binding(iface, VKD3D_SHADER_DESCRIPTOR_TYPE_UAV, space, reg, count, table, offset,
+		            bindless | VKD3D_SHADER_BINDING_FLAG_BUFFER, ResourceHeapSet, StorageTexelBufferBinding);
+		add_binding(iface, VKD3D_SHADER_DESCRIPTOR_TYPE_UAV, space, reg, count, table, offset,
+		            bindless | VKD3D_SHADER_BINDING_FLAG_IMAGE, ResourceHeapSet, StorageImageBinding);
+		add_binding(iface, VKD3D_SHADER_DESCRIPTOR_TYPE_UAV, space, reg, count, table, offset,
+		            bindless | VKD3D_SHADER_BINDING_FLAG_AUX_BUFFER, ResourceHeapSet, CounterBufferBinding);
+		break;
+
+	case VKD3D_DESCRIPTOR_RANGE_TYPE_CBV:
+		add_binding(iface, VKD3D_SHADER_DESCRIPTOR_TYPE_CBV, space, reg, count, table, offset,
+		            bindless | VKD3D_SHADER_BINDING_FLAG_BUFFER, ResourceHeapSet, UniformBufferBinding);
+		break;
+
+	case VKD3D_DESCRIPTOR_RANGE_TYPE_SAMPLER:
+		add_binding(iface, VKD3D_SHADER_DESCRIPTOR_TYPE_SAMPLER, space, reg, count, table, offset,
+		            bindless | VKD3D_SHADER_BINDING_FLAG_IMAGE, SamplerHeapSet, 0);
+		break;
+
+	default:
+		break;
+	}
+}
+
+// Push constants hold root descriptor addresses first, then descriptor table offsets, then root constants.
+static bool build_shader_interface(const std::vector<uint8_t> &root_signature, ShaderInterface &iface)
+{
+	vkd3d_versioned_root_signature_desc desc = {};
+	if (!parse_root_signature_desc(root_signature, desc))
+		return false;
+
+	auto &rs = desc.v_1_2;
+	unsigned num_root_descriptors = 0;
+	unsigned num_tables = 0;
+
+	for (unsigned i = 0; i < rs.parameter_count; i++)
+	{
+		auto type = rs.parameters[i].parameter_type;
+		if (type == VKD3D_ROOT_PARAMETER_TYPE_CBV || type == VKD3D_ROOT_PARAMETER_TYPE_SRV ||
+		    type == VKD3D_ROOT_PARAMETER_TYPE_UAV)
+			num_root_descriptors++;
+		else if (type == VKD3D_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE)
+			num_tables++;
+	}
+
+	unsigned root_descriptor_index = 0;
+	unsigned table_index = 0;
+	unsigned constant_offset = 8 * num_root_descriptors + 4 * num_tables;
+
+	for (unsigned i = 0; i < rs.parameter_count; i++)
+	{
+		auto &param = rs.parameters[i];
+		switch (param.parameter_type)
+		{
+		case VKD3D_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+		{
+			unsigned offset = 0;
+			for (unsigned j = 0; j < param.descriptor_table.descriptor_range_count; j++)
+			{
+				auto &range = param.descriptor_table.descriptor_ranges[j];
+				if (range.descriptor_table_offset != D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND)
+					offset = range.descriptor_table_offset;
+				add_range_bindings(iface, range, table_index, offset);
+				if (range.descriptor_count != VKD3D_SHADER_DESCRIPTOR_RANGE_UNBOUNDED)
+					offset += range.descriptor_count;
+			}
+			table_index++;
+			break;
+		}
+
+		case VKD3D_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+		{
+			vkd3d_shader_push_constant_buffer constants = {};
+			constants.register_space = param.constants.register_space;
+			constants.register_index = param.constants.shader_register;
+			constants.shader_visibility = VKD3D_SHADER_VISIBILITY_ALL;
+			constants.offset = constant_offset;
+			constants.size = 4 * param.constants.value_count;
+			constant_offset += constants.size;
+			iface.push_constants.push_back(constants);
+			break;
+		}
+
+		default:
+		{
+			auto type = param.parameter_type == VKD3D_ROOT_PARAMETER_TYPE_CBV ? VKD3D_SHADER_DESCRIPTOR_TYPE_CBV :
+			            param.parameter_type == VKD3D_ROOT_PARAMETER_TYPE_SRV ? VKD3D_SHADER_DESCRIPTOR_TYPE_SRV :
+			            VKD3D_SHADER_DESCRIPTOR_TYPE_UAV;
+			add_binding(iface, type, param.descriptor.register_space, param.descriptor.shader_register, 1, 0, 0,
+			            VKD3D_SHADER_BINDING_FLAG_BUFFER | VKD3D_SHADER_BINDING_FLAG_RAW_VA,
+			            0, root_descriptor_index++);
+			break;
+		}
+		}
+	}
+
+	for (unsigned i = 0; i < rs.static_sampler_count; i++)
+	{
+		auto &sampler = rs.static_samplers[i];
+		add_binding(iface, VKD3D_SHADER_DESCRIPTOR_TYPE_SAMPLER, sampler.register_space, sampler.shader_register,
+		            1, 0, 0, VKD3D_SHADER_BINDING_FLAG_IMAGE, StaticSamplerSet, i);
+	}
+
+	vkd3d_shader_free_root_signature(&desc);
+
+	iface.info.min_ssbo_alignment = 16;
+	iface.info.descriptor_tables.offset = 8 * num_root_descriptors;
+	iface.info.descriptor_tables.count = num_tables;
+	iface.info.bindings = iface.bindings.data();
+	iface.info.binding_count = unsigned(iface.bindings.size());
+	iface.info.push_constant_buffers = iface.push_constants.data();
+	iface.info.push_constant_buffer_count = unsigned(iface.push_constants.size());
+	iface.info.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	return true;
+}
+
+bool run_shader_compile_benchmark(const std::vector<ShaderBlobs> &shaders, unsigned max_threads)
+{
+	std::vector<ShaderInterface> interfaces(shaders.size());
+	std::vector<vkd3d_shader_code> inputs(shaders.size());
+
+	for (size_t i = 0; i < shaders.size(); i++)
+	{
+		if (!build_shader_interface(shaders[i].root_signature, interfaces[i]))
+		{
+			LOGE("Failed to parse root signature of %s.\n", shaders[i].cs_path.c_str());
+			return false;
+		}
+
+		auto &input = inputs[i];
+		input = {};
+		input.code = shaders[i].cs.data();
+		input.size = shaders[i].cs.size();
+		input.meta.hash = vkd3d_shader_hash(&input);
+	}
+
+	vkd3d_shader_compile_arguments args = {};
+	args.target = VKD3D_SHADER_TARGET_SPIRV_VULKAN_1_0;
+
+	struct Output
+	{
+		vkd3d_shader_code spirv;
+		size_t size;
+		Hash hash;
+		bool nondeterministic;
+	};
+	std::vector<Output> outputs(shaders.size());
+	bool first_round = true;
+
+	auto task = [&](size_t index) -> bool {
+		auto &spirv = outputs[index].spirv;
+		spirv = {};
+		if (vkd3d_shader_compile_dxbc(&inputs[index], &spirv, nullptr, 0, &interfaces[index].info, &args) != VKD3D_OK)
+		{
+			LOGE("Failed to compile %s.\n", shaders[index].cs_path.c_str());
+			return false;
+		}
+		return true;
+	};
+
+	// Hashing and freeing the SPIR-V stays out of the timings.
+	auto end_round = [&]() {
+		for (auto &output : outputs)
+		{
+			if (!output.spirv.code)
+				continue;
+
+			Hasher hasher;
+			hasher.data(static_cast<const uint32_t *>(output.spirv.code), output.spirv.size);
+
+			if (first_round)
+			{
+				output.size = output.spirv.size;
+				output.hash = hasher.get();
+			}
+			else if (output.hash != hasher.get())
+				output.nondeterministic = true;
+
+			vkd3d_shader_free_shader_code(&output.spirv);
+			output.spirv = {};
+		}
+		first_round = false;
+	};
+
+	LOGI("Translating %zu distinct shaders with vkd3d-shader.\n", shaders.size());
+
+	std::vector<uint64_t> single_thread_ns;
+	if (!run_scaling_benchmark(shaders.size(), max_threads, task, end_round, single_thread_ns))
+		return false;
+
+	size_t total_size = 0;
+	LOGI("Per shader, on one thread:\n");
+	for (size_t i = 0; i < shaders.size(); i++)
+	{
+		auto &output = outputs[i];
+		total_size += output.size;
+		LOGI("  %10.3f ms  %8zu bytes  input %016llx  SPIR-V %016llx%s  %s\n",
+		     1e-6 * double(single_thread_ns[i]), output.size,
+		     static_cast<unsigned long long>(inputs[i].meta.hash),
+		     static_cast<unsigned long long>(output.hash),
+		     output.nondeterministic ? " (nondeterministic)" : "",
+		     shaders[i].cs_path.c_str());
+	}
+
+	LOGI("%zu bytes of SPIR-V in total.\n", total_size);
+	return true;
+}
+#else
+bool run_shader_compile_benchmark(const std::vector<ShaderBlobs> &, unsigned)
+{
+	LOGE("Built without vkd3d-shader, set VKD3D_SHADER_LIBRARIES when configuring.\n");
+	return false;
+}
+#endif
+}
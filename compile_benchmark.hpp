@@ -0,0 +1,34 @@
+/* Copyright (c) 2025 Hans-Kristian Arntzen for Valve Corporation
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Util
+{
+// Runs task(index) for every index below count on 1, 2, 4, ... up to max_threads threads and logs
+// throughput, latency percentiles and scaling efficiency of every round. end_round runs after each
+// round outside the timed region, e.g. to release results. single_thread_ns receives per-index latency
+// of the single-threaded round. Fails as soon as a task fails.
+bool run_scaling_benchmark(size_t count, unsigned max_threads,
+                           const std::function<bool (size_t)> &task,
+                           const std::function<void ()> &end_round,
+                           std::vector<uint64_t> &single_thread_ns);
+
+struct ShaderBlobs
+{
+	std::string cs_path;
+	std::vector<uint8_t> cs;
+	std::vector<uint8_t> root_signature;
+};
+
+// Translates every CS to SPIR-V with vkd3d-shader directly, using a binding layout derived from its
+// root signature. Needs no device. Fails if vkd3d-shader was not available at build time.
+bool run_shader_compile_benchmark(const std::vector<ShaderBlobs> &shaders, unsigned max_threads);
+}
@@ -30,14 +30,37 @@
 #include "vkd3d_dxgi1_5.h"
 #include "vkd3d_swapchain_factory.h"
 #include "vkd3d_core_interface.h"
+#include "vkd3d_device_vkd3d_ext.h"
 
 #include "cli_parser.hpp"
 #include "com_ptr.hpp"
 #include "logging.hpp"
 #include "path_utils.hpp"
+#include "file_mapping.hpp"
+#include "blob_reader.hpp"
+#include "blob_compression.hpp"
+#include "blob_store.hpp"
+#include "texel_repack.hpp"
+#include "timing_stats.hpp"
+#include "report.hpp"
+#include "root_signature.hpp"
+#include "compile_benchmark.hpp"
+#include "capture_format.hpp"
+#include "hash.hpp"
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <unordered_set>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <ctype.h>
+#include <math.h>
 #include <stdint.h>
 
 #include "SDL3/SDL.h"
@@ -74,6 +97,7 @@ DLLEXPORT const char *D3D12SDKPath = u8".\\D3D12\\";
 
 #include "rapidjson/document.h"
 #include "rapidjson/prettywriter.h"
+#include "rapidjson/stringbuffer.h"
 #include "rapidjson/writer.h"
 
 #define MAP(prefix, x) if (strcmp(str, #x) == 0) return prefix##_##x
@@ -377,21 +401,6 @@ static D3D12_FILTER convert_filter(const char *str)
 	return D3D12_FILTER_MIN_MAG_MIP_POINT;
 }
 
-static std::vector<uint8_t> slice_pixels(const uint8_t *data, size_t size, uint32_t output_size, uint32_t input_size)
-{
-	std::vector<uint8_t> pixels;
-	pixels.reserve((size / input_size) * output_size);
-
-	while (size >= input_size)
-	{
-		pixels.insert(pixels.end(), data, data + output_size);
-		size -= input_size;
-		data += input_size;
-	}
-
-	return pixels;
-}
-
 template <typename T = uint8_t>
 static std::vector<T> load_binary_file(const std::string &path)
 {
@@ -426,130 +435,62 @@ static std::vector<T> load_binary_file(const std::string &path)
 	return t;
 }
 
-struct PipelineState
-{
-	ComPtr<ID3D12PipelineState> pso;
-	ComPtr<ID3D12RootSignature> root_signature;
-};
-
-struct Resource
-{
-	ComPtr<ID3D12Resource> gpu_resource;
-	ComPtr<ID3D12Resource> staging_resource;
-	ComPtr<ID3D12Resource> gpu_staging_resource;
-	D3D12_RESOURCE_STATES current_state = D3D12_RESOURCE_STATE_COPY_DEST;
-	D3D12_RESOURCE_STATES execution_state = D3D12_RESOURCE_STATE_COMMON;
-	std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> placed_footprints;
-	bool dirty = false;
-	bool dirty_gpu_staging = true;
-};
+// Resources are referred to by name in the JSON and by index in the desc.
+using ResourceNameMap = std::unordered_map<std::string, uint32_t>;
 
-struct Device
+static bool find_resource_index(const ResourceNameMap &names, const char *name, uint32_t &index)
 {
-	ComPtr<ID3D12Device> device;
-	ComPtr<ID3D12CommandQueue> queue;
-	ComPtr<ID3D12Fence> fence;
-	ComPtr<ID3D12GraphicsCommandList> list;
-
-	enum { NumFrameContexts = 4 };
-	struct
-	{
-		ComPtr<ID3D12CommandAllocator> allocator;
-		ComPtr<ID3D12QueryHeap> timestamps;
-		ComPtr<ID3D12Resource> timestamp_readback;
-		uint64_t fence_value_for_iteration = 0;
-		uint32_t pending_timestamps = 0;
-	} frame_contexts[NumFrameContexts] = {};
-
-	uint32_t frame_index = 0;
-	uint64_t latest_fence_value = 0;
-
-	uint64_t total_ticks = 0;
-	uint64_t total_dispatches = 0;
-
-	Resource create_resource_from_desc(const std::string &base_path, const rapidjson::Value &value);
-
-	void wait_idle();
-	void teardown_swapchain();
-
-	PipelineState create_compute_shader(const std::string &cs_path, const std::string &rs_path);
-	PipelineState cs;
-
-	struct NamedResource
+	auto itr = names.find(name);
+	if (itr == names.end())
 	{
-		std::string name;
-		Resource resource;
-	};
-	std::vector<NamedResource> resources;
-
-	bool load_resources(const std::string &base_path, const rapidjson::Value &value);
-
-	ComPtr<ID3D12DescriptorHeap> resource_heap;
-	ComPtr<ID3D12DescriptorHeap> sampler_heap;
-	bool allocate_descriptor_heaps(const rapidjson::Value &doc);
-
-	bool create_descriptors(const rapidjson::Value &doc);
-	bool create_srv_descriptors(const rapidjson::Value &srvs);
-	bool create_uav_descriptors(const rapidjson::Value &uavs);
-	bool create_cbv_descriptors(const rapidjson::Value &cbvs);
-	bool create_sampler_descriptors(const rapidjson::Value &samplers);
-
-	Resource *find_resource(const char *name);
+		LOGE("Could not find resource named \"%s\".\n", name);
+		return false;
+	}
 
-	bool execute_iteration(const rapidjson::Value &doc, uint32_t dispatches_per_list);
-	void execute_sync_dirty();
-	void execute_sync_dirty_gpu_staging();
-	bool execute_dispatch(const rapidjson::Value &doc, uint32_t iteration);
+	index = itr->second;
+	return true;
+}
 
-#ifdef _WIN32
-	ComPtr<IDXGIFactory2> factory;
-#endif
-	ComPtr<IDXGISwapChain3> swapchain;
-	ComPtr<IDXGIVkSwapChain> vk_swapchain;
-	ComPtr<ID3D12Resource> backbuffers[2];
-	ComPtr<ID3D12DescriptorHeap> rtv;
+// Blobs are named by a path relative to the JSON, or by content hash if the JSON has a BlobStore.
+struct BlobLocator
+{
+	std::string base_path;
+	std::string store;
 
-	bool init_swapchain(SDL_Window *window);
+	bool resolve(const char *name, Util::BlobRef &blob) const;
 };
 
-PipelineState Device::create_compute_shader(const std::string &path, const std::string &rs_path)
+bool BlobLocator::resolve(const char *name, Util::BlobRef &blob) const
 {
-	auto cs_data = load_binary_file<>(path);
-	auto rs_data = load_binary_file<>(rs_path);
-	if (cs_data.empty() || rs_data.empty())
-		return {};
-
-	PipelineState pipe;
-
-	if (FAILED(device->CreateRootSignature(
-			0, rs_data.data(), rs_data.size(),
-			IID_ID3D12RootSignature, pipe.root_signature.ppv())))
+	blob = {};
+	if (!Util::is_blob_name(name))
 	{
-		LOGE("Failed to create root signature.\n");
-		return {};
+		blob.path = relpath(base_path, name);
+		return true;
 	}
 
-	D3D12_COMPUTE_PIPELINE_STATE_DESC desc = {};
-	desc.pRootSignature = pipe.root_signature.get();
-	desc.CS.pShaderBytecode = cs_data.data();
-	desc.CS.BytecodeLength = cs_data.size();
+	if (store.empty())
+	{
+		LOGE("Blob %s needs a BlobStore.\n", name);
+		return false;
+	}
 
-	if (FAILED(device->CreateComputePipelineState(&desc, IID_ID3D12PipelineState, pipe.pso.ppv())))
+	Util::Hash hash;
+	if (!Util::parse_blob_name(name, hash))
 	{
-		LOGE("Failed to create PSO.\n");
-		return {};
+		LOGE("Invalid blob name %s.\n", name);
+		return false;
 	}
 
-	return pipe;
+	blob.path = Util::get_blob_store_path(store, hash);
+	blob.content_hash = hash;
+	return true;
 }
 
-Resource Device::create_resource_from_desc(const std::string &base_path, const rapidjson::Value &value)
+static bool parse_resource_desc(const BlobLocator &locator, const rapidjson::Value &value,
+                                Util::CaptureResourceDesc &res)
 {
-	D3D12_HEAP_PROPERTIES heap_props = {};
-	D3D12_RESOURCE_DESC1 desc = {};
-	Resource res;
-
-	heap_props.Type = D3D12_HEAP_TYPE_DEFAULT;
+	auto &desc = res.desc;
 	desc.Width = 1;
 	desc.Height = 1;
 	desc.DepthOrArraySize = 1;
@@ -585,228 +526,70 @@ Resource Device::create_resource_from_desc(const std::string &base_path, const r
 	desc.Layout = desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER ?
 	              D3D12_TEXTURE_LAYOUT_ROW_MAJOR : D3D12_TEXTURE_LAYOUT_UNKNOWN;
 
-	if (desc.SampleDesc.Count > 1)
-	{
-		LOGW("MSAA not supported yet.\n");
-		return {};
-	}
-
-	ComPtr<ID3D12Device10> device10;
-	if (FAILED(device->QueryInterface(IID_ID3D12Device10, device10.ppv())))
-	{
-		LOGE("Failed to query ID3D12Device10. AgilitySDK dlls might not be present?\n");
-		return {};
-	}
-
-	D3D12_FEATURE_DATA_D3D12_OPTIONS12 options12;
-	if (FAILED(device10->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS12, &options12, sizeof(options12))))
-	{
-		LOGE("Failed to query OPTIONS12.\n");
-		return {};
-	}
-
-	if (!options12.RelaxedFormatCastingSupported)
-	{
-		LOGE("RelaxedFormatCasting not supported.\n");
-		return {};
-	}
-
-	// For simplicity, use legacy barriers. Resource has to be in COMMON layout to move in and out of the models.
-	// It's very unclear from D3D12 docs if initial layout has any meaning w.r.t this rule though ...
-	auto barrier_layout =
-			desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER ?
-			D3D12_BARRIER_LAYOUT_UNDEFINED : D3D12_BARRIER_LAYOUT_COMMON;
-
-	std::vector<DXGI_FORMAT> castable;
 	if (value.HasMember("CastFormats"))
 	{
 		auto &cast_formats = value["CastFormats"];
 		for (auto itr = cast_formats.Begin(); itr != cast_formats.End(); ++itr)
-			castable.push_back(convert_dxgi_format(itr->GetString()));
+			res.cast_formats.push_back(convert_dxgi_format(itr->GetString()));
 	}
 
-	std::sort(castable.begin(), castable.end());
-	castable.erase(std::unique(castable.begin(), castable.end()), castable.end());
+	std::sort(res.cast_formats.begin(), res.cast_formats.end());
+	res.cast_formats.erase(std::unique(res.cast_formats.begin(), res.cast_formats.end()), res.cast_formats.end());
 
-	if (FAILED(device10->CreateCommittedResource3(
-			&heap_props, D3D12_HEAP_FLAG_NONE, &desc, barrier_layout, nullptr, nullptr,
-			castable.size(), castable.data(),
-			IID_ID3D12Resource, res.gpu_resource.ppv())))
-	{
-		LOGE("Failed to create resource.\n");
-		return {};
-	}
+	if (value.HasMember("Restore"))
+		res.restore = value["Restore"].GetString();
 
-	// Keep the copy on GPU for fast refreshes of UAVs.
-	if (FAILED(device10->CreateCommittedResource3(
-			&heap_props, D3D12_HEAP_FLAG_NONE, &desc, barrier_layout, nullptr, nullptr,
-			castable.size(), castable.data(),
-			IID_ID3D12Resource, res.gpu_staging_resource.ppv())))
+	if (!value.HasMember("data"))
+		return true;
+
+	auto &data = value["data"];
+	if (!data.IsArray() || data.Size() < desc.MipLevels)
 	{
-		LOGE("Failed to create resource.\n");
-		return {};
+		LOGE("Need one data entry per mip level.\n");
+		return false;
 	}
 
-	heap_props.Type = D3D12_HEAP_TYPE_CUSTOM;
-	heap_props.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_WRITE_COMBINE;
-	heap_props.MemoryPoolPreference = D3D12_MEMORY_POOL_L0;
-	desc.Flags &= ~(D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS |
-	                D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET |
-	                D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
-
-	std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> placed_footprints;
 	if (desc.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER)
 	{
-		uint32_t num_subresources = desc.MipLevels;
-		if (desc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE3D)
-			num_subresources *= desc.DepthOrArraySize;
-
-		UINT64 total_bytes = 0;
-		placed_footprints.resize(num_subresources);
-
-		D3D12_RESOURCE_DESC desc0 = {};
-		desc0.Width = desc.Width;
-		desc0.Height = desc.Height;
-		desc0.DepthOrArraySize = desc.DepthOrArraySize;
-		desc0.MipLevels = desc.MipLevels;
-		desc0.SampleDesc = desc.SampleDesc;
-		desc0.Layout = desc.Layout;
-		desc0.Dimension = desc.Dimension;
-		desc0.Format = desc.Format;
-		desc0.Flags = desc.Flags;
-		device->GetCopyableFootprints(&desc0, 0, num_subresources, 0, placed_footprints.data(),
-		                              nullptr, nullptr, &total_bytes);
-		if (total_bytes == UINT64_MAX)
-			return {};
-
-		D3D12_RESOURCE_DESC1 upload_desc = {};
-		upload_desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-		upload_desc.Format = DXGI_FORMAT_UNKNOWN;
-		upload_desc.Width = total_bytes;
-		upload_desc.Height = 1;
-		upload_desc.DepthOrArraySize = 1;
-		upload_desc.MipLevels = 1;
-		upload_desc.SampleDesc.Count = 1;
-		upload_desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-
-		if (FAILED(device10->CreateCommittedResource3(
-				&heap_props, D3D12_HEAP_FLAG_NONE, &upload_desc,
-				D3D12_BARRIER_LAYOUT_UNDEFINED, nullptr, nullptr, 0, nullptr,
-				IID_ID3D12Resource, res.staging_resource.ppv())))
-		{
-			LOGE("Failed to create resource.\n");
-			return {};
-		}
-	}
-	else
-	{
-		if (FAILED(device10->CreateCommittedResource3(
-				&heap_props, D3D12_HEAP_FLAG_NONE, &desc,
-				D3D12_BARRIER_LAYOUT_UNDEFINED, nullptr, nullptr, 0, nullptr,
-				IID_ID3D12Resource, res.staging_resource.ppv())))
+		if (!value.HasMember("PixelSize"))
 		{
-			LOGE("Failed to create resource.\n");
-			return {};
+			LOGE("Need to set PixelSize (at least for now).\n");
+			return false;
 		}
-	}
 
-	heap_props = {};
-	heap_props.Type = D3D12_HEAP_TYPE_DEFAULT;
+		res.src_pixel_size = value["PixelSize"].GetUint();
+		res.dst_pixel_size = res.src_pixel_size;
 
-	if (value.HasMember("data"))
-	{
-		uint8_t *ptr = nullptr;
-		if (FAILED(res.staging_resource->Map(0, nullptr, reinterpret_cast<void **>(&ptr))))
-		{
-			LOGE("Failed to map staging resource.\n");
-			return {};
-		}
+		// Mostly used for depth stencil to extract only one aspect,
+		// e.g. PixelSlice 1 with PixelSliceOffset 3 for stencil in D24S8.
+		if (value.HasMember("PixelSlice"))
+			res.dst_pixel_size = value["PixelSlice"].GetUint();
+		if (value.HasMember("PixelSliceOffset"))
+			res.src_pixel_offset = value["PixelSliceOffset"].GetUint();
 
-		for (uint32_t i = 0; i < desc.MipLevels; i++)
+		if (res.dst_pixel_size == 0 || res.src_pixel_offset + res.dst_pixel_size > res.src_pixel_size)
 		{
-			auto path = relpath(base_path, value["data"][i].GetString());
-			auto data = load_binary_file<>(path);
-
-			if (data.empty())
-			{
-				LOGE("Failed to load init buffer \"%s\".\n", path.c_str());
-				return {};
-			}
-
-			if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
-			{
-				if (data.size() != desc.Width)
-				{
-					LOGE("Mismatch between desc Width and buffer. %zu != %zu\n",
-						 data.size(), size_t(desc.Width));
-					return {};
-				}
-
-				memcpy(ptr, data.data(), data.size());
-			}
-			else
-			{
-				if (!value.HasMember("PixelSize"))
-				{
-					LOGE("Need to set PixelSize (at least for now).\n");
-					return {};
-				}
-
-				uint32_t pixel_size = value["PixelSize"].GetUint();
-				uint32_t block_width, block_height;
-
-				get_block_dimensions(desc.Format, block_width, block_height);
-
-				// Mostly used for depth stencil to extract only depth aspect.
-				if (value.HasMember("PixelSlice"))
-				{
-					uint32_t slice_bytes = value["PixelSlice"].GetUint();
-					data = slice_pixels(data.data(), data.size(), slice_bytes, pixel_size);
-					pixel_size = slice_bytes;
-				}
-
-				size_t data_offset = 0;
-				uint32_t num_layers = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : desc.DepthOrArraySize;
-
-				for (uint32_t layer = 0; layer < num_layers; layer++)
-				{
-					auto &footprint = placed_footprints[i + desc.MipLevels * layer];
-					uint32_t blocks_x = (footprint.Footprint.Width + block_width - 1) / block_width;
-					uint32_t blocks_y = (footprint.Footprint.Height + block_height - 1) / block_height;
-					uint32_t blocks_z = footprint.Footprint.Depth;
-
-					for (uint32_t z = 0; z < blocks_z; z++)
-					{
-						for (uint32_t y = 0; y < blocks_y; y++)
-						{
-							if (data_offset + pixel_size * blocks_x > data.size())
-							{
-								LOGE("Data buffer is not large enough.\n");
-								return {};
-							}
-
-							memcpy(ptr + footprint.Offset +
-							       y * footprint.Footprint.RowPitch +
-							       z * footprint.Footprint.RowPitch * blocks_y,
-							       data.data() + data_offset,
-							       blocks_x * pixel_size);
-							data_offset += pixel_size * blocks_x;
-						}
-					}
-				}
-			}
+			LOGE("PixelSlice and PixelSliceOffset must fit within PixelSize.\n");
+			return false;
 		}
+	}
 
-		res.dirty = true;
-		res.staging_resource->Unmap(0, nullptr);
-		res.placed_footprints = std::move(placed_footprints);
+	for (uint32_t i = 0; i < desc.MipLevels; i++)
+	{
+		Util::BlobRef blob;
+		if (!locator.resolve(data[i].GetString(), blob))
+			return false;
+		res.data.push_back(std::move(blob));
 	}
 
-	return res;
+	return true;
 }
 
-bool Device::load_resources(const std::string &base_path, const rapidjson::Value &value)
+static bool parse_resources(const BlobLocator &locator, const rapidjson::Value &value,
+                            ResourceNameMap &names, Util::CaptureDesc &desc)
 {
+	desc.resources.reserve(value.Size());
+
 	for (auto itr = value.Begin(); itr != value.End(); ++itr)
 	{
 		auto &obj = *itr;
@@ -817,38 +600,29 @@ bool Device::load_resources(const std::string &base_path, const rapidjson::Value
 			return false;
 		}
 
-		Resource res = create_resource_from_desc(base_path, obj);
-		if (!res.gpu_resource)
+		Util::CaptureResourceDesc res;
+		res.name = obj["name"].GetString();
+		if (names.count(res.name))
+		{
+			LOGE("Duplicate resource name \"%s\".\n", res.name.c_str());
 			return false;
+		}
 
-		resources.push_back({ obj["name"].GetString(), std::move(res) });
-	}
-
-	return true;
-}
-
-Resource *Device::find_resource(const char *name)
-{
-	auto itr = std::find_if(resources.begin(), resources.end(), [name](const NamedResource &res) {
-		return res.name == name;
-	});
+		if (!parse_resource_desc(locator, obj, res))
+			return false;
 
-	if (itr == resources.end())
-	{
-		LOGE("Could not find resource named \"%s\".\n", name);
-		return nullptr;
+		names[res.name] = uint32_t(desc.resources.size());
+		desc.resources.push_back(std::move(res));
 	}
 
-	return &itr->resource;
+	return true;
 }
 
-bool Device::create_cbv_descriptors(const rapidjson::Value &cbvs)
+static bool parse_cbvs(const rapidjson::Value &cbvs, const ResourceNameMap &names, Util::CaptureDesc &desc)
 {
-	auto desc_size = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-
 	for (auto itr = cbvs.Begin(); itr != cbvs.End(); ++itr)
 	{
-		D3D12_CONSTANT_BUFFER_VIEW_DESC cbv_desc = {};
+		Util::CaptureCBVDesc view = {};
 		auto &cbv = *itr;
 
 		if (!cbv.HasMember("Resource"))
@@ -857,23 +631,11 @@ bool Device::create_cbv_descriptors(const rapidjson::Value &cbvs)
 			return false;
 		}
 
-		auto *resource = find_resource(cbv["Resource"].GetString());
-		if (!resource)
-			return false;
-
-		if (resource->execution_state != D3D12_RESOURCE_STATE_COMMON &&
-		    resource->execution_state != D3D12_RESOURCE_STATE_GENERIC_READ)
-		{
-			LOGE("Mismatch in resource state required.\n");
+		if (!find_resource_index(names, cbv["Resource"].GetString(), view.resource))
 			return false;
-		}
-
-		resource->execution_state = D3D12_RESOURCE_STATE_GENERIC_READ;
-
-		cbv_desc.BufferLocation = resource->gpu_resource->GetGPUVirtualAddress();
 
 		if (cbv.HasMember("BufferLocation"))
-			cbv_desc.BufferLocation += cbv["BufferLocation"].GetUint64();
+			view.buffer_offset = cbv["BufferLocation"].GetUint64();
 
 		if (!cbv.HasMember("SizeInBytes"))
 		{
@@ -881,7 +643,7 @@ bool Device::create_cbv_descriptors(const rapidjson::Value &cbvs)
 			return false;
 		}
 
-		cbv_desc.SizeInBytes = cbv["SizeInBytes"].GetUint();
+		view.size_in_bytes = cbv["SizeInBytes"].GetUint();
 
 		if (!cbv.HasMember("HeapOffset"))
 		{
@@ -889,21 +651,19 @@ bool Device::create_cbv_descriptors(const rapidjson::Value &cbvs)
 			return false;
 		}
 
-		auto handle = resource_heap->GetCPUDescriptorHandleForHeapStart();
-		handle.ptr += cbv["HeapOffset"].GetUint64() * desc_size;
-		device->CreateConstantBufferView(&cbv_desc, handle);
+		view.heap_offset = cbv["HeapOffset"].GetUint();
+		desc.cbvs.push_back(view);
 	}
 
 	return true;
 }
 
-bool Device::create_srv_descriptors(const rapidjson::Value &srvs)
+static bool parse_srvs(const rapidjson::Value &srvs, const ResourceNameMap &names, Util::CaptureDesc &desc)
 {
-	auto desc_size = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-
 	for (auto itr = srvs.Begin(); itr != srvs.End(); ++itr)
 	{
-		D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
+		Util::CaptureSRVDesc view = {};
+		auto &srv_desc = view.desc;
 		srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 
 		auto &srv = *itr;
@@ -914,11 +674,10 @@ bool Device::create_srv_descriptors(const rapidjson::Value &srvs)
 			return false;
 		}
 
-		auto *resource = find_resource(srv["Resource"].GetString());
-		if (!resource)
+		if (!find_resource_index(names, srv["Resource"].GetString(), view.resource))
 			return false;
 
-		srv_desc.Format = resource->gpu_resource->GetDesc().Format;
+		srv_desc.Format = desc.resources[view.resource].desc.Format;
 
 		if (srv.HasMember("ViewDimension"))
 			srv_desc.ViewDimension = convert_srv_dimension(srv["ViewDimension"].GetString());
@@ -1051,31 +810,20 @@ bool Device::create_srv_descriptors(const rapidjson::Value &srvs)
 			return false;
 		}
 
-		auto handle = resource_heap->GetCPUDescriptorHandleForHeapStart();
-		handle.ptr += srv["HeapOffset"].GetUint64() * desc_size;
-
-		if (resource->execution_state != D3D12_RESOURCE_STATE_COMMON &&
-		    resource->execution_state != D3D12_RESOURCE_STATE_GENERIC_READ)
-		{
-			LOGE("Mismatch in resource state required.\n");
-			return false;
-		}
-
-		resource->execution_state = D3D12_RESOURCE_STATE_GENERIC_READ;
-
-		device->CreateShaderResourceView(resource->gpu_resource.get(), &srv_desc, handle);
+		view.heap_offset = srv["HeapOffset"].GetUint();
+		desc.srvs.push_back(view);
 	}
 
 	return true;
 }
 
-bool Device::create_uav_descriptors(const rapidjson::Value &uavs)
+static bool parse_uavs(const rapidjson::Value &uavs, const ResourceNameMap &names, Util::CaptureDesc &desc)
 {
-	auto desc_size = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-
 	for (auto itr = uavs.Begin(); itr != uavs.End(); ++itr)
 	{
-		D3D12_UNORDERED_ACCESS_VIEW_DESC uav_desc = {};
+		Util::CaptureUAVDesc view = {};
+		view.counter_resource = Util::CaptureNoResource;
+		auto &uav_desc = view.desc;
 
 		auto &uav = *itr;
 
@@ -1085,12 +833,14 @@ bool Device::create_uav_descriptors(const rapidjson::Value &uavs)
 			return false;
 		}
 
-		Resource *resource = find_resource(uav["Resource"].GetString());
-		Resource *counter_resource = nullptr;
-		if (!resource)
+		if (!find_resource_index(names, uav["Resource"].GetString(), view.resource))
+			return false;
+
+		if (uav.HasMember("CounterResource") &&
+		    !find_resource_index(names, uav["CounterResource"].GetString(), view.counter_resource))
 			return false;
 
-		uav_desc.Format = resource->gpu_resource->GetDesc().Format;
+		uav_desc.Format = desc.resources[view.resource].desc.Format;
 
 		if (uav.HasMember("ViewDimension"))
 			uav_desc.ViewDimension = convert_uav_dimension(uav["ViewDimension"].GetString());
@@ -1178,54 +928,19 @@ bool Device::create_uav_descriptors(const rapidjson::Value &uavs)
 			return false;
 		}
 
-
-		auto handle = resource_heap->GetCPUDescriptorHandleForHeapStart();
-		handle.ptr += uav["HeapOffset"].GetUint64() * desc_size;
-
-		if (uav.HasMember("CounterResource"))
-		{
-			counter_resource = find_resource(uav["CounterResource"].GetString());
-			if (!counter_resource)
-				return false;
-		}
-
-		if (resource->execution_state != D3D12_RESOURCE_STATE_COMMON &&
-		    resource->execution_state != D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
-		{
-			LOGE("Mismatch in resource state required.\n");
-			return false;
-		}
-
-		resource->execution_state = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
-
-		if (counter_resource)
-		{
-			if (counter_resource->execution_state != D3D12_RESOURCE_STATE_COMMON &&
-			    counter_resource->execution_state != D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
-			{
-				LOGE("Mismatch in resource state required.\n");
-				return false;
-			}
-
-			counter_resource->execution_state = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
-		}
-
-		device->CreateUnorderedAccessView(
-				resource->gpu_resource.get(),
-				counter_resource ? counter_resource->gpu_resource.get() : nullptr,
-				&uav_desc, handle);
+		view.heap_offset = uav["HeapOffset"].GetUint();
+		desc.uavs.push_back(view);
 	}
 
 	return true;
 }
 
-bool Device::create_sampler_descriptors(const rapidjson::Value &samplers)
+static bool parse_samplers(const rapidjson::Value &samplers, Util::CaptureDesc &desc)
 {
-	auto desc_size = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER);
-
 	for (auto itr = samplers.Begin(); itr != samplers.End(); ++itr)
 	{
-		D3D12_SAMPLER_DESC sampler_desc = {};
+		Util::CaptureSamplerDesc view = {};
+		auto &sampler_desc = view.desc;
 
 		auto &sampler = *itr;
 
@@ -1259,206 +974,103 @@ bool Device::create_sampler_descriptors(const rapidjson::Value &samplers)
 			return false;
 		}
 
-		auto handle = sampler_heap->GetCPUDescriptorHandleForHeapStart();
-		handle.ptr += sampler["HeapOffset"].GetUint64() * desc_size;
-
-		device->CreateSampler(&sampler_desc, handle);
+		view.heap_offset = sampler["HeapOffset"].GetUint();
+		desc.samplers.push_back(view);
 	}
 
 	return true;
 }
 
-bool Device::create_descriptors(const rapidjson::Value &doc)
-{
-	if (doc.HasMember("SRV") && !create_srv_descriptors(doc["SRV"]))
-		return false;
-	if (doc.HasMember("UAV") && !create_uav_descriptors(doc["UAV"]))
-		return false;
-	if (doc.HasMember("CBV") && !create_cbv_descriptors(doc["CBV"]))
-		return false;
-	if (doc.HasMember("Sampler") && !create_sampler_descriptors(doc["Sampler"]))
-		return false;
-
-	return true;
-}
-
-bool Device::allocate_descriptor_heaps(const rapidjson::Value &doc)
+// Captures without a Dispatches array are a single pass described by the top level.
+static std::vector<const rapidjson::Value *> get_dispatch_passes(const rapidjson::Value &doc)
 {
-	uint32_t num_resources = 1;
-	uint32_t num_samplers = 1;
-
-	static const char *resource_types[] = { "SRV", "CBV", "UAV", "Sampler" };
-
-	for (auto *type : resource_types)
+	std::vector<const rapidjson::Value *> passes;
+	if (doc.HasMember("Dispatches"))
 	{
-		if (doc.HasMember(type))
-		{
-			auto &resource_list = doc[type];
-			for (auto itr = resource_list.Begin(); itr != resource_list.End(); ++itr)
-			{
-				auto &resource = *itr;
-				if (!resource.HasMember("HeapOffset"))
-				{
-					LOGE("Need HeapOffset\n");
-					return false;
-				}
-
-				if (strcmp(type, "Sampler") == 0)
-					num_samplers = std::max<uint32_t>(num_samplers, resource["HeapOffset"].GetUint() + 1);
-				else
-					num_resources = std::max<uint32_t>(num_resources, resource["HeapOffset"].GetUint() + 1);
-			}
-		}
+		auto &dispatches = doc["Dispatches"];
+		for (auto itr = dispatches.Begin(); itr != dispatches.End(); ++itr)
+			passes.push_back(&*itr);
 	}
+	else
+		passes.push_back(&doc);
 
-	D3D12_DESCRIPTOR_HEAP_DESC heap_desc = {};
-	heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-	heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-	heap_desc.NumDescriptors = num_resources;
-
-	if (FAILED(device->CreateDescriptorHeap(&heap_desc, IID_ID3D12DescriptorHeap, resource_heap.ppv())))
-		return false;
-
-	heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER;
-	heap_desc.NumDescriptors = num_samplers;
-
-	if (FAILED(device->CreateDescriptorHeap(&heap_desc, IID_ID3D12DescriptorHeap, sampler_heap.ppv())))
-		return false;
-
-	return true;
-}
-
-void Device::wait_idle()
-{
-	queue->Signal(fence.get(), ++latest_fence_value);
-	fence->SetEventOnCompletion(latest_fence_value, nullptr);
+	return passes;
 }
 
-void Device::teardown_swapchain()
+// Pass entries fall back to the top level for fields they do not override, e.g. a shared RootSignature.
+static const rapidjson::Value *get_pass_member(const rapidjson::Value &doc, const rapidjson::Value &pass,
+                                               const char *name)
 {
-	for (auto &img : backbuffers)
-		img = {};
-	swapchain = {};
-	vk_swapchain = {};
+	if (pass.HasMember(name))
+		return &pass[name];
+	if (doc.HasMember(name))
+		return &doc[name];
+	return nullptr;
 }
 
-void Device::execute_sync_dirty_gpu_staging()
+static bool parse_root_parameter_type(const char *str, Util::CaptureRootParameterType &type)
 {
-	std::vector<D3D12_RESOURCE_BARRIER> barriers;
-
-	for (auto &resource : resources)
+	if (strcmp(str, "ResourceTable") == 0)
+		type = Util::CaptureRootParameterType::ResourceTable;
+	else if (strcmp(str, "SamplerTable") == 0)
+		type = Util::CaptureRootParameterType::SamplerTable;
+	else if (strcmp(str, "Constant") == 0)
+		type = Util::CaptureRootParameterType::Constant;
+	else if (strcmp(str, "SRV") == 0)
+		type = Util::CaptureRootParameterType::SRV;
+	else if (strcmp(str, "UAV") == 0)
+		type = Util::CaptureRootParameterType::UAV;
+	else if (strcmp(str, "CBV") == 0)
+		type = Util::CaptureRootParameterType::CBV;
+	else
 	{
-		if (!resource.resource.dirty_gpu_staging)
-			continue;
-
-		D3D12_RESOURCE_BARRIER barrier = {};
-		barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-		barrier.Transition.pResource = resource.resource.gpu_staging_resource.get();
-		barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
-		barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
-		barrier.Transition.Subresource = UINT32_MAX;
-		barriers.push_back(barrier);
-
-		if (resource.resource.gpu_staging_resource->GetDesc().Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
-		{
-			list->CopyResource(
-					resource.resource.gpu_staging_resource.get(),
-					resource.resource.staging_resource.get());
-		}
-		else
-		{
-			for (size_t i = 0, n = resource.resource.placed_footprints.size(); i < n; i++)
-			{
-				D3D12_TEXTURE_COPY_LOCATION dst = {}, src = {};
-				dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
-				src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-				dst.pResource = resource.resource.gpu_staging_resource.get();
-				src.pResource = resource.resource.staging_resource.get();
-				dst.SubresourceIndex = i;
-				src.PlacedFootprint = resource.resource.placed_footprints[i];
-				list->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
-			}
-		}
-
-		resource.resource.dirty_gpu_staging = false;
+		LOGE("Invalid root parameter type \"%s\"\n", str);
+		return false;
 	}
 
-	if (!barriers.empty())
-		list->ResourceBarrier(barriers.size(), barriers.data());
+	return true;
 }
 
-void Device::execute_sync_dirty()
+static bool parse_pass(const BlobLocator &locator, const rapidjson::Value &doc, const rapidjson::Value &pass_desc,
+                       const ResourceNameMap &names, Util::CapturePassDesc &pass)
 {
-	std::vector<D3D12_RESOURCE_BARRIER> barriers;
-
-	for (auto &resource : resources)
+	auto *cs_value = get_pass_member(doc, pass_desc, "CS");
+	auto *rs_value = get_pass_member(doc, pass_desc, "RootSignature");
+	if (!cs_value || !rs_value)
 	{
-		if (!resource.resource.dirty)
-			continue;
-
-		if (resource.resource.current_state != D3D12_RESOURCE_STATE_COPY_DEST)
-		{
-			D3D12_RESOURCE_BARRIER barrier = {};
-			barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-			barrier.Transition.pResource = resource.resource.gpu_resource.get();
-			barrier.Transition.StateBefore = resource.resource.current_state;
-			barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
-			barrier.Transition.Subresource = UINT32_MAX;
-			resource.resource.current_state = D3D12_RESOURCE_STATE_COPY_DEST;
-			barriers.push_back(barrier);
-		}
+		LOGE("Must define \"CS\" and \"RootSignature\".\n");
+		return false;
 	}
 
-	if (!barriers.empty())
-		list->ResourceBarrier(barriers.size(), barriers.data());
-
-	barriers.clear();
+	if (!locator.resolve(cs_value->GetString(), pass.cs) ||
+	    !locator.resolve(rs_value->GetString(), pass.root_signature))
+		return false;
 
-	for (auto &resource : resources)
+	auto *dims_value = get_pass_member(doc, pass_desc, "Dispatch");
+	if (!dims_value)
 	{
-		if (!resource.resource.dirty)
-			continue;
-
-		if (resource.resource.current_state != resource.resource.execution_state)
-		{
-			D3D12_RESOURCE_BARRIER barrier = {};
-			barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-			barrier.Transition.pResource = resource.resource.gpu_resource.get();
-			barrier.Transition.StateBefore = resource.resource.current_state;
-			barrier.Transition.StateAfter = resource.resource.execution_state;
-			barrier.Transition.Subresource = UINT32_MAX;
-			resource.resource.current_state = resource.resource.execution_state;
-			barriers.push_back(barrier);
-		}
-
-		list->CopyResource(resource.resource.gpu_resource.get(), resource.resource.gpu_staging_resource.get());
-		resource.resource.dirty = false;
+		LOGE("Missing dispatch field.\n");
+		return false;
 	}
 
-	if (!barriers.empty())
-		list->ResourceBarrier(barriers.size(), barriers.data());
-}
-
-bool Device::execute_dispatch(const rapidjson::Value &doc, uint32_t iteration)
-{
-	auto &ctx = frame_contexts[frame_index];
-
-	if (!doc.HasMember("Dispatch"))
+	auto *params_value = get_pass_member(doc, pass_desc, "RootParameters");
+	if (!params_value)
 	{
-		LOGE("Missing dispatch field.\n");
+		LOGE("Missing RootParameters field.\n");
 		return false;
 	}
 
-	if (!doc.HasMember("RootParameters"))
+	auto &dims = *dims_value;
+	if (!dims.IsArray() || dims.Size() != 3)
 	{
-		LOGE("Missing RootParameters field.\n");
+		LOGE("Dispatch must be an array of 3 elements.\n");
 		return false;
 	}
 
-	list->SetComputeRootSignature(cs.root_signature.get());
-	list->SetPipelineState(cs.pso.get());
+	for (uint32_t i = 0; i < 3; i++)
+		pass.dimensions[i] = dims[i].GetUint();
 
-	auto &params = doc["RootParameters"];
+	auto &params = *params_value;
 	for (auto itr = params.Begin(); itr != params.End(); ++itr)
 	{
 		auto &param = *itr;
@@ -1474,29 +1086,24 @@ bool Device::execute_dispatch(const rapidjson::Value &doc, uint32_t iteration)
 			return false;
 		}
 
-		const char *type = param["type"].GetString();
-		uint32_t index = param["index"].GetUint();
+		Util::CaptureRootParameterDesc parameter = {};
+		if (!parse_root_parameter_type(param["type"].GetString(), parameter.type))
+			return false;
+
+		parameter.index = param["index"].GetUint();
+		parameter.resource = Util::CaptureNoResource;
 
-		uint64_t offset = 0;
 		if (param.HasMember("offset"))
-			offset = param["offset"].GetUint64();
+			parameter.offset = param["offset"].GetUint64();
 
-		if (strcmp(type, "ResourceTable") == 0)
-		{
-			D3D12_GPU_DESCRIPTOR_HANDLE desc = resource_heap->GetGPUDescriptorHandleForHeapStart();
-			desc.ptr += offset * device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-			list->SetComputeRootDescriptorTable(index, desc);
-		}
-		else if (strcmp(type, "SamplerTable") == 0)
+		switch (parameter.type)
 		{
-			D3D12_GPU_DESCRIPTOR_HANDLE desc = sampler_heap->GetGPUDescriptorHandleForHeapStart();
-			desc.ptr += offset * device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER);
-			list->SetComputeRootDescriptorTable(index, desc);
-		}
-		else if (strcmp(type, "Constant") == 0)
+		case Util::CaptureRootParameterType::ResourceTable:
+		case Util::CaptureRootParameterType::SamplerTable:
+			break;
+
+		case Util::CaptureRootParameterType::Constant:
 		{
-			uint32_t data[64];
-			uint32_t count = 0;
 			auto &pushdata = param["data"];
 			if (!pushdata.IsArray())
 			{
@@ -1504,448 +1111,4378 @@ bool Device::execute_dispatch(const rapidjson::Value &doc, uint32_t iteration)
 				return false;
 			}
 
-			for (auto dataitr = pushdata.Begin(); dataitr != pushdata.End(); ++dataitr)
+			if (pushdata.Size() > 64)
 			{
-				if (count >= 64)
-				{
-					LOGE("Too much data in root parameter block.\n");
-					return false;
-				}
-				data[count++] = dataitr->GetUint();
+				LOGE("Too much data in root parameter block.\n");
+				return false;
 			}
 
-			list->SetComputeRoot32BitConstants(index, count, data, 0);
+			parameter.constant_offset = uint32_t(pass.constants.size());
+			parameter.constant_count = pushdata.Size();
+
+			for (auto dataitr = pushdata.Begin(); dataitr != pushdata.End(); ++dataitr)
+				pass.constants.push_back(dataitr->GetUint());
+			break;
 		}
-		else
-		{
+
+		default:
 			if (!param.HasMember("Resource"))
 			{
 				LOGE("Missing Resource for root parameter.\n");
 				return false;
 			}
 
-			auto *resource = find_resource(param["Resource"].GetString());
-			if (!resource)
-				return false;
-
-			D3D12_GPU_VIRTUAL_ADDRESS va = resource->gpu_resource->GetGPUVirtualAddress();
-			if (!va)
-				return false;
-
-			va += param["offset"].GetUint64();
-
-			if (strcmp(type, "SRV") == 0)
-				list->SetComputeRootShaderResourceView(index, va);
-			else if (strcmp(type, "UAV") == 0)
-				list->SetComputeRootUnorderedAccessView(index, va);
-			else if (strcmp(type, "CBV") == 0)
-				list->SetComputeRootConstantBufferView(index, va);
-			else
-			{
-				LOGE("Invalid root parameter type \"%s\"\n", type);
+			if (!find_resource_index(names, param["Resource"].GetString(), parameter.resource))
 				return false;
-			}
+			break;
 		}
-	}
 
-	list->EndQuery(ctx.timestamps.get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * iteration + 0);
-	list->Dispatch(doc["Dispatch"][0].GetUint(), doc["Dispatch"][1].GetUint(), doc["Dispatch"][2].GetUint());
-	list->EndQuery(ctx.timestamps.get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * iteration + 1);
-
-	// UAVs can be modified, so refresh them every iteration.
-	for (auto &resource : resources)
-		if (resource.resource.execution_state == D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
-			resource.resource.dirty = true;
-
-	D3D12_RESOURCE_BARRIER uav_barrier = {};
-	uav_barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
-	list->ResourceBarrier(1, &uav_barrier);
+		pass.parameters.push_back(parameter);
+	}
 
 	return true;
 }
 
-bool Device::execute_iteration(const rapidjson::Value &doc, uint32_t dispatches_per_list)
+// Resolves everything the JSON describes up front, so loading never touches the document.
+static bool parse_capture_json(const std::string &path, const rapidjson::Value &doc, Util::CaptureDesc &desc)
 {
-	auto &ctx = frame_contexts[frame_index];
-	if (ctx.fence_value_for_iteration != 0)
+	if (!doc.HasMember("Resources"))
 	{
-		if (FAILED(fence->SetEventOnCompletion(ctx.fence_value_for_iteration, nullptr)))
-			return false;
-
-		// No need for the CPU copy now.
-		for (auto &resource : resources)
-			resource.resource.staging_resource = {};
+		LOGE("Must specify resources.\n");
+		return false;
 	}
 
-	if (ctx.pending_timestamps)
+	if (doc.HasMember("Dispatches") && (!doc["Dispatches"].IsArray() || doc["Dispatches"].Empty()))
 	{
-		const uint64_t *tses = nullptr;
-		if (SUCCEEDED(ctx.timestamp_readback->Map(0, nullptr, (void **)&tses)))
-		{
-			for (uint32_t i = 0; i < dispatches_per_list; i++)
-			{
-				total_ticks += tses[2 * i + 1] - tses[2 * i + 0];
-				total_dispatches++;
-			}
-			ctx.timestamp_readback->Unmap(0, nullptr);
-		}
+		LOGE("Dispatches must be a non-empty array.\n");
+		return false;
 	}
 
-	ctx.pending_timestamps = dispatches_per_list;
+	BlobLocator locator;
+	locator.base_path = path;
+	if (doc.HasMember("BlobStore"))
+		locator.store = relpath(path, doc["BlobStore"].GetString());
 
-	if (!ctx.timestamps || ctx.timestamp_readback->GetDesc().Width < dispatches_per_list * sizeof(uint64_t) * 2)
-	{
-		D3D12_QUERY_HEAP_DESC query_heap = {};
-		query_heap.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
-		query_heap.Count = dispatches_per_list * 2;
-		if (FAILED(device->CreateQueryHeap(&query_heap, IID_ID3D12QueryHeap, ctx.timestamps.ppv())))
-			return false;
+	ResourceNameMap names;
+	if (!parse_resources(locator, doc["Resources"], names, desc))
+		return false;
 
-		D3D12_HEAP_PROPERTIES heap_props = {};
-		heap_props.Type = D3D12_HEAP_TYPE_READBACK;
+	if (doc.HasMember("SRV") && !parse_srvs(doc["SRV"], names, desc))
+		return false;
+	if (doc.HasMember("UAV") && !parse_uavs(doc["UAV"], names, desc))
+		return false;
+	if (doc.HasMember("CBV") && !parse_cbvs(doc["CBV"], names, desc))
+		return false;
+	if (doc.HasMember("Sampler") && !parse_samplers(doc["Sampler"], desc))
+		return false;
 
-		D3D12_RESOURCE_DESC res = {};
-		res.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-		res.Width = dispatches_per_list * sizeof(uint64_t) * 2;
-		res.Height = 1;
-		res.DepthOrArraySize = 1;
-		res.MipLevels = 1;
-		res.SampleDesc.Count = 1;
-		res.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+	auto pass_descs = get_dispatch_passes(doc);
+	desc.passes.resize(pass_descs.size());
 
-		if (FAILED(device->CreateCommittedResource(
-				&heap_props, D3D12_HEAP_FLAG_NONE,
-				&res, D3D12_RESOURCE_STATE_COPY_DEST,
-				nullptr, IID_ID3D12Resource, ctx.timestamp_readback.ppv())))
+	for (size_t i = 0; i < pass_descs.size(); i++)
+	{
+		auto &pass = desc.passes[i];
+		if (pass_descs[i]->HasMember("Name"))
+			pass.name = (*pass_descs[i])["Name"].GetString();
+		else
+			pass.name = "pass" + std::to_string(i);
+
+		if (!parse_pass(locator, doc, *pass_descs[i], names, pass))
 		{
+			LOGE("Failed to parse dispatch \"%s\".\n", pass.name.c_str());
 			return false;
 		}
 	}
 
-	if (FAILED(list->Reset(ctx.allocator.get(), nullptr)))
-		return false;
+	return true;
+}
 
-	// Split submissions to allow better preemption while grinding the GPU.
-	ID3D12DescriptorHeap *heaps[] = { resource_heap.get(), sampler_heap.get() };
-	list->SetDescriptorHeaps(2, heaps);
+// Captures are either JSON with loose blobs, or a single capture container.
+// metadata receives the JSON or the container tables, which identify the capture along with its blobs.
+static bool load_capture_desc(const std::string &path, Util::CaptureDesc &desc, std::vector<uint8_t> &metadata)
+{
+	desc = {};
+
+	if (Util::is_capture_container(path))
+	{
+		Util::BlobRef tables;
+		tables.path = path;
+		tables.packed = true;
+		return Util::read_capture_container(path, desc, tables.size) && Util::load_blob(tables, metadata);
+	}
+
+	metadata = load_binary_file<>(path);
+	if (metadata.empty())
+		return false;
+
+	rapidjson::Document doc;
+	doc.Parse(reinterpret_cast<const char *>(metadata.data()), metadata.size());
+	if (doc.HasParseError())
+	{
+		LOGE("Parse error in %s: %d\n", path.c_str(), doc.GetParseError());
+		return false;
+	}
+
+	return parse_capture_json(path, doc, desc);
+}
+
+static uint64_t elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+	return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start).count());
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+	return 1e-6 * double(elapsed_ns(start));
+}
+
+struct PipelineState
+{
+	ComPtr<ID3D12PipelineState> pso;
+	ComPtr<ID3D12RootSignature> root_signature;
+
+	// Tells which descriptors each table reaches. Without it, tables are assumed to reach the end of the heap.
+	Util::RootSignatureLayout layout;
+	bool has_layout = false;
+
+	// Time spent in PSO creation, and whether a pipeline cache spared the compile.
+	double create_ms = 0.0;
+	bool cache_hit = false;
+
+	// Entry in the SharedObjectCache, pinned for as long as a pass uses it.
+	std::shared_ptr<const void> shared_entry;
+	// Reused from an earlier capture instead of being created.
+	bool shared_hit = false;
+};
+
+struct Resource;
+
+struct RootBinding
+{
+	enum class Type
+	{
+		ResourceTable,
+		SamplerTable,
+		Constant,
+		SRV,
+		UAV,
+		CBV
+	};
+
+	Type type;
+	uint32_t index;
+
+	// Descriptor table handle or root descriptor VA, depending on type.
+	uint64_t address;
+	// First heap slot of a descriptor table, or the resource behind a root descriptor.
+	uint32_t heap_offset;
+	Resource *resource;
+
+	// Range in DispatchPass::constants for root constants.
+	uint32_t constant_offset;
+	uint32_t constant_count;
+};
+
+// Places resources in a few large heaps instead of one committed allocation each.
+// Replay resources live until the capture is torn down, so a bump pointer per heap is enough.
+struct HeapAllocator
+{
+	enum : uint64_t
+	{
+		MinBlockSize = 16 * 1024 * 1024,
+		MaxBlockSize = 256 * 1024 * 1024
+	};
+
+	struct Block
+	{
+		ComPtr<ID3D12Heap> heap;
+		uint64_t size;
+		uint64_t offset;
+	};
+
+	D3D12_HEAP_PROPERTIES props = {};
+	D3D12_HEAP_FLAGS flags = D3D12_HEAP_FLAG_NONE;
+	std::vector<Block> blocks;
+	uint64_t requested_bytes = 0;
+	uint64_t committed_bytes = 0;
+
+	bool allocate(ID3D12Device *device, const D3D12_RESOURCE_ALLOCATION_INFO &info,
+	              ID3D12Heap **heap, uint64_t *offset);
+	void reset();
+};
+
+bool HeapAllocator::allocate(ID3D12Device *device, const D3D12_RESOURCE_ALLOCATION_INFO &info,
+                             ID3D12Heap **heap, uint64_t *offset)
+{
+	uint64_t alignment = std::max<uint64_t>(info.Alignment, D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT);
+
+	for (auto &block : blocks)
+	{
+		uint64_t aligned_offset = (block.offset + alignment - 1) & ~(alignment - 1);
+		if (aligned_offset + info.SizeInBytes <= block.size)
+		{
+			block.offset = aligned_offset + info.SizeInBytes;
+			requested_bytes += info.SizeInBytes;
+			*heap = block.heap.get();
+			*offset = aligned_offset;
+			return true;
+		}
+	}
+
+	// Grow geometrically so small captures do not pay for a full-sized heap.
+	// Anything larger than a block gets a dedicated heap.
+	uint64_t block_size = std::min<uint64_t>(std::max<uint64_t>(committed_bytes, MinBlockSize), MaxBlockSize);
+	block_size = std::max<uint64_t>(block_size, info.SizeInBytes);
+	block_size = (block_size + D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT - 1) &
+	             ~uint64_t(D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT - 1);
+
+	D3D12_HEAP_DESC desc = {};
+	desc.SizeInBytes = block_size;
+	desc.Properties = props;
+	desc.Alignment = std::max<uint64_t>(alignment, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+	desc.Flags = flags;
+
+	Block block = {};
+	if (FAILED(device->CreateHeap(&desc, IID_ID3D12Heap, block.heap.ppv())))
+	{
+		LOGE("Failed to create heap of %llu bytes.\n", static_cast<unsigned long long>(block_size));
+		return false;
+	}
+
+	block.size = block_size;
+	block.offset = info.SizeInBytes;
+	committed_bytes += block_size;
+	requested_bytes += info.SizeInBytes;
+	*heap = block.heap.get();
+	*offset = 0;
+	blocks.push_back(std::move(block));
+	return true;
+}
+
+void HeapAllocator::reset()
+{
+	blocks.clear();
+	requested_bytes = 0;
+	committed_bytes = 0;
+}
+
+// Persists compiled pipelines across runs, so PSO creation can be measured both cold and from a warm cache.
+// Uses a pipeline library where the device has one, otherwise the cached blob of every PSO in its own file.
+class PipelineCache
+{
+public:
+	bool init(ID3D12Device *device, const std::string &dir, Util::Hash identity);
+
+	// key identifies the shader and root signature. hit tells whether the driver got to skip compilation.
+	bool create_compute_pipeline(const D3D12_COMPUTE_PIPELINE_STATE_DESC &desc, Util::Hash key,
+	                             ComPtr<ID3D12PipelineState> &pso, bool &hit);
+
+	// Writes out the pipeline library if anything was added to it.
+	bool flush();
+
+private:
+	ID3D12Device *device = nullptr;
+	ComPtr<ID3D12Device1> device1;
+	// Declared ahead of the library, which reads from it for as long as it lives.
+	std::vector<uint8_t> library_data;
+	ComPtr<ID3D12PipelineLibrary> library;
+	std::string dir;
+	Util::Hash identity = 0;
+	std::mutex lock;
+	bool dirty = false;
+
+	std::string get_library_path() const;
+	std::string get_blob_path(Util::Hash key) const;
+	bool create_from_library(const D3D12_COMPUTE_PIPELINE_STATE_DESC &desc, Util::Hash key,
+	                         ComPtr<ID3D12PipelineState> &pso, bool &hit);
+	bool create_from_blob(const D3D12_COMPUTE_PIPELINE_STATE_DESC &desc, Util::Hash key,
+	                      ComPtr<ID3D12PipelineState> &pso, bool &hit);
+};
+
+static std::string hash_to_hex(Util::Hash hash)
+{
+	char str[17];
+	snprintf(str, sizeof(str), "%016llx", static_cast<unsigned long long>(hash));
+	return str;
+}
+
+// Unlike load_binary_file, a missing file is an expected cache miss.
+static bool read_cache_file(const std::string &path, std::vector<uint8_t> &data)
+{
+	data.clear();
+	FILE *f = fopen(path.c_str(), "rb");
+	if (!f)
+		return false;
+
+	fseek(f, 0, SEEK_END);
+	long len = ftell(f);
+	rewind(f);
+
+	bool success = len > 0;
+	if (success)
+	{
+		data.resize(size_t(len));
+		success = fread(data.data(), 1, data.size(), f) == data.size();
+	}
+	fclose(f);
+
+	if (!success)
+		data.clear();
+	return success;
+}
+
+// Written next to the target first, so an interrupted run never leaves a truncated cache file behind.
+static bool write_cache_file(const std::string &path, const void *data, size_t size)
+{
+	auto tmp_path = path + ".tmp";
+	FILE *f = fopen(tmp_path.c_str(), "wb");
+	if (!f)
+	{
+		LOGE("Failed to open %s for writing.\n", tmp_path.c_str());
+		return false;
+	}
+
+	bool success = fwrite(data, 1, size, f) == size;
+	if (fclose(f) != 0)
+		success = false;
+
+	success = success && Granite::Path::replace_file(tmp_path, path);
+	if (!success)
+	{
+		LOGE("Failed to write %s.\n", path.c_str());
+		remove(tmp_path.c_str());
+	}
+	return success;
+}
+
+std::string PipelineCache::get_library_path() const
+{
+	return Granite::Path::join(dir, "pipelines-" + hash_to_hex(identity) + ".plib");
+}
+
+std::string PipelineCache::get_blob_path(Util::Hash key) const
+{
+	return Granite::Path::join(dir, hash_to_hex(identity) + "-" + hash_to_hex(key) + ".pso");
+}
+
+bool PipelineCache::init(ID3D12Device *device_, const std::string &dir_, Util::Hash identity_)
+{
+	device = device_;
+	dir = dir_;
+	identity = identity_;
+
+	if (!Granite::Path::make_directory(dir))
+	{
+		LOGE("Failed to create pipeline cache directory %s.\n", dir.c_str());
+		return false;
+	}
+
+	if (FAILED(device->QueryInterface(IID_ID3D12Device1, device1.ppv())))
+	{
+		LOGI("No ID3D12Device1, caching PSO blobs individually.\n");
+		return true;
+	}
+
+	auto path = get_library_path();
+	if (read_cache_file(path, library_data))
+	{
+		HRESULT hr = device1->CreatePipelineLibrary(library_data.data(), library_data.size(),
+		                                            IID_ID3D12PipelineLibrary, library.ppv());
+		if (SUCCEEDED(hr))
+		{
+			LOGI("Loaded pipeline library %s, %zu bytes.\n", path.c_str(), library_data.size());
+			return true;
+		}
+
+		if (hr == D3D12_ERROR_DRIVER_VERSION_MISMATCH || hr == D3D12_ERROR_ADAPTER_NOT_FOUND)
+			LOGW("Pipeline library %s belongs to another driver or adapter, starting over.\n", path.c_str());
+		else
+			LOGW("Pipeline library %s could not be loaded (hr #%x), starting over.\n", path.c_str(), unsigned(hr));
+
+		library_data.clear();
+	}
+
+	if (FAILED(device1->CreatePipelineLibrary(nullptr, 0, IID_ID3D12PipelineLibrary, library.ppv())))
+	{
+		LOGI("Pipeline libraries are not supported, caching PSO blobs individually.\n");
+		library = {};
+	}
+
+	return true;
+}
+
+bool PipelineCache::create_from_library(const D3D12_COMPUTE_PIPELINE_STATE_DESC &desc, Util::Hash key,
+                                        ComPtr<ID3D12PipelineState> &pso, bool &hit)
+{
+	auto hex = hash_to_hex(key);
+	WCHAR name[17];
+	for (size_t i = 0; i < 16; i++)
+		name[i] = WCHAR(hex[i]);
+	name[16] = 0;
+
+	// Loads are free-threaded as long as no two threads load the same name,
+	// which cannot happen since captures compile every pipeline once.
+	if (SUCCEEDED(library->LoadComputePipeline(name, &desc, IID_ID3D12PipelineState, pso.ppv())))
+	{
+		hit = true;
+		return true;
+	}
+
+	if (FAILED(device->CreateComputePipelineState(&desc, IID_ID3D12PipelineState, pso.ppv())))
+		return false;
+
+	std::lock_guard<std::mutex> holder{lock};
+	// E_INVALIDARG means the name is taken already, which is fine.
+	HRESULT hr = library->StorePipeline(name, pso.get());
+	if (SUCCEEDED(hr))
+		dirty = true;
+	else if (hr != E_INVALIDARG)
+		LOGW("Failed to store pipeline %s in library (hr #%x).\n", hex.c_str(), unsigned(hr));
+
+	return true;
+}
+
+bool PipelineCache::create_from_blob(const D3D12_COMPUTE_PIPELINE_STATE_DESC &desc, Util::Hash key,
+                                     ComPtr<ID3D12PipelineState> &pso, bool &hit)
+{
+	auto path = get_blob_path(key);
+	std::vector<uint8_t> blob;
+
+	if (read_cache_file(path, blob))
+	{
+		auto cached_desc = desc;
+		cached_desc.CachedPSO.pCachedBlob = blob.data();
+		cached_desc.CachedPSO.CachedBlobSizeInBytes = blob.size();
+
+		// Blobs from another driver fail with D3D12_ERROR_DRIVER_VERSION_MISMATCH, compile from scratch then.
+		if (SUCCEEDED(device->CreateComputePipelineState(&cached_desc, IID_ID3D12PipelineState, pso.ppv())))
+		{
+			hit = true;
+			return true;
+		}
+	}
+
+	if (FAILED(device->CreateComputePipelineState(&desc, IID_ID3D12PipelineState, pso.ppv())))
+		return false;
+
+	ComPtr<ID3DBlob> cached;
+	if (SUCCEEDED(pso->GetCachedBlob(reinterpret_cast<ID3DBlob **>(cached.ppv()))) && cached->GetBufferSize())
+		write_cache_file(path, cached->GetBufferPointer(), cached->GetBufferSize());
+
+	return true;
+}
+
+bool PipelineCache::create_compute_pipeline(const D3D12_COMPUTE_PIPELINE_STATE_DESC &desc, Util::Hash key,
+                                            ComPtr<ID3D12PipelineState> &pso, bool &hit)
+{
+	hit = false;
+	if (library)
+		return create_from_library(desc, key, pso, hit);
+	else
+		return create_from_blob(desc, key, pso, hit);
+}
+
+bool PipelineCache::flush()
+{
+	std::lock_guard<std::mutex> holder{lock};
+	if (!library || !dirty)
+		return true;
+
+	std::vector<uint8_t> data(library->GetSerializedSize());
+	if (FAILED(library->Serialize(data.data(), data.size())))
+	{
+		LOGE("Failed to serialize pipeline library.\n");
+		return false;
+	}
+
+	auto path = get_library_path();
+	if (!write_cache_file(path, data.data(), data.size()))
+		return false;
+
+	dirty = false;
+	LOGI("Wrote pipeline library %s, %zu bytes.\n", path.c_str(), data.size());
+	return true;
+}
+
+// When writable resources are brought back to their initial contents.
+enum class RestorePolicy
+{
+	Default,
+	PerDispatch,
+	PerList,
+	InitialOnly,
+	Never
+};
+
+static bool parse_restore_policy(const char *str, RestorePolicy &policy)
+{
+	if (strcmp(str, "per-dispatch") == 0)
+		policy = RestorePolicy::PerDispatch;
+	else if (strcmp(str, "per-list") == 0)
+		policy = RestorePolicy::PerList;
+	else if (strcmp(str, "initial-only") == 0)
+		policy = RestorePolicy::InitialOnly;
+	else if (strcmp(str, "never") == 0)
+		policy = RestorePolicy::Never;
+	else
+	{
+		LOGE("Unrecognized restore policy \"%s\".\n", str);
+		return false;
+	}
+
+	return true;
+}
+
+static const char *restore_policy_to_string(RestorePolicy policy)
+{
+	switch (policy)
+	{
+	case RestorePolicy::PerDispatch:
+		return "per-dispatch";
+	case RestorePolicy::PerList:
+		return "per-list";
+	case RestorePolicy::InitialOnly:
+		return "initial-only";
+	case RestorePolicy::Never:
+		return "never";
+	default:
+		return "default";
+	}
+}
+
+// One compute pass with its RootParameters and Dispatch fields resolved once up front,
+// so recording a dispatch does not touch the JSON document.
+struct DispatchPass
+{
+	std::string name;
+	PipelineState pipeline;
+	std::vector<RootBinding> bindings;
+	std::vector<uint32_t> constants;
+	uint32_t dimensions[3] = {};
+
+	// Everything the pass can reach through its root parameters. Any UAV access counts as a write.
+	std::vector<Resource *> reads;
+	std::vector<Resource *> writes;
+	// Per-resource UAV barriers resolving hazards against earlier passes, used instead of a global barrier.
+	std::vector<D3D12_RESOURCE_BARRIER> barriers;
+};
+
+// Passes are recorded back to back with UAV barriers in between and share every resource.
+// Restores happen before the first pass, never in the middle of the chain.
+struct DispatchPlan
+{
+	std::vector<DispatchPass> passes;
+	std::vector<Resource *> restore_per_dispatch;
+	std::vector<Resource *> restore_per_list;
+};
+
+// A read-only resource shared by every capture of a suite which has an identical one.
+struct SharedResource
+{
+	ComPtr<ID3D12Resource> gpu_resource;
+	// Kept until the first capture to replay has uploaded it.
+	ComPtr<ID3D12Resource> staging_resource;
+	std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> placed_footprints;
+
+	// Only touched by the capture being replayed. See Device::set_capture and Device::release_capture.
+	D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_COPY_DEST;
+	bool uploaded = false;
+};
+
+// Resources, root signatures and PSOs shared across the captures of a suite, keyed by content hash.
+// Resource data outside a blob store is keyed by where it is stored instead, see hash_shared_resource.
+// Captures hold references to the entries they use. Entries nobody references are evicted,
+// least recently used first, once their total size exceeds the budget.
+class SharedObjectCache
+{
+public:
+	explicit SharedObjectCache(uint64_t budget);
+
+	enum class Kind
+	{
+		Resource,
+		RootSignature,
+		Pipeline
+	};
+
+	template <typename T>
+	std::shared_ptr<T> find(Kind kind, Util::Hash key)
+	{
+		return std::static_pointer_cast<T>(find_entry(kind, key));
+	}
+
+	// Returns the entry already cached under key if another capture got there first.
+	template <typename T>
+	std::shared_ptr<T> insert(Kind kind, Util::Hash key, std::shared_ptr<T> object, uint64_t size)
+	{
+		using Mutable = typename std::remove_const<T>::type;
+		return std::static_pointer_cast<T>(
+				insert_entry(kind, key, std::const_pointer_cast<Mutable>(std::move(object)), size));
+	}
+
+	void trim();
+	void log_stats() const;
+
+private:
+	struct Entry
+	{
+		Util::Hash key;
+		std::shared_ptr<void> object;
+		uint64_t size;
+	};
+
+	mutable std::mutex lock;
+	uint64_t budget;
+	uint64_t total_size = 0;
+	uint64_t evicted_count = 0;
+	uint64_t hit_count = 0;
+	uint64_t miss_count = 0;
+	std::list<Entry> lru;
+	std::unordered_map<Util::Hash, std::list<Entry>::iterator> entries;
+
+	static Util::Hash get_entry_key(Kind kind, Util::Hash key);
+	std::shared_ptr<void> find_entry(Kind kind, Util::Hash key);
+	std::shared_ptr<void> insert_entry(Kind kind, Util::Hash key, std::shared_ptr<void> object, uint64_t size);
+	void trim_locked();
+};
+
+SharedObjectCache::SharedObjectCache(uint64_t budget_)
+	: budget(budget_)
+{
+}
+
+Util::Hash SharedObjectCache::get_entry_key(Kind kind, Util::Hash key)
+{
+	Util::Hasher hasher(key);
+	hasher.u32(uint32_t(kind));
+	return hasher.get();
+}
+
+std::shared_ptr<void> SharedObjectCache::find_entry(Kind kind, Util::Hash key)
+{
+	std::lock_guard<std::mutex> holder{lock};
+	auto itr = entries.find(get_entry_key(kind, key));
+	if (itr == entries.end())
+	{
+		miss_count++;
+		return {};
+	}
+
+	hit_count++;
+	lru.splice(lru.begin(), lru, itr->second);
+	return itr->second->object;
+}
+
+std::shared_ptr<void> SharedObjectCache::insert_entry(Kind kind, Util::Hash key,
+                                                      std::shared_ptr<void> object, uint64_t size)
+{
+	std::lock_guard<std::mutex> holder{lock};
+	auto entry_key = get_entry_key(kind, key);
+	auto itr = entries.find(entry_key);
+	if (itr != entries.end())
+		return itr->second->object;
+
+	lru.push_front({ entry_key, object, size });
+	entries[entry_key] = lru.begin();
+	total_size += size;
+	trim_locked();
+	return object;
+}
+
+void SharedObjectCache::trim()
+{
+	std::lock_guard<std::mutex> holder{lock};
+	trim_locked();
+}
+
+void SharedObjectCache::trim_locked()
+{
+	// Entries still referenced by a capture stay, even if that leaves the cache over budget.
+	for (auto itr = lru.end(); itr != lru.begin() && total_size > budget; )
+	{
+		--itr;
+		if (itr->object.use_count() > 1)
+			continue;
+
+		total_size -= itr->size;
+		entries.erase(itr->key);
+		itr = lru.erase(itr);
+		evicted_count++;
+	}
+}
+
+void SharedObjectCache::log_stats() const
+{
+	std::lock_guard<std::mutex> holder{lock};
+	LOGI("Shared object cache: %zu entries, %.3f MiB of %.3f MiB budget, %llu hits, %llu misses, %llu evicted.\n",
+	     entries.size(), double(total_size) / (1024.0 * 1024.0), double(budget) / (1024.0 * 1024.0),
+	     static_cast<unsigned long long>(hit_count), static_cast<unsigned long long>(miss_count),
+	     static_cast<unsigned long long>(evicted_count));
+}
+
+struct Resource
+{
+	ComPtr<ID3D12Resource> gpu_resource;
+	ComPtr<ID3D12Resource> staging_resource;
+
+	// Pristine copy of the initial contents. Only writable resources with data have one,
+	// writable resources without data are restored from Capture::zero_buffer instead.
+	ComPtr<ID3D12Resource> gpu_staging_resource;
+
+	D3D12_RESOURCE_DESC1 desc = {};
+	std::vector<DXGI_FORMAT> castable_formats;
+	D3D12_RESOURCE_STATES current_state = D3D12_RESOURCE_STATE_COPY_DEST;
+	D3D12_RESOURCE_STATES execution_state = D3D12_RESOURCE_STATE_COMMON;
+
+	// Empty for buffers.
+	std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> placed_footprints;
+	uint64_t upload_size = 0;
+
+	bool has_data = false;
+	bool writable = false;
+	RestorePolicy restore = RestorePolicy::Default;
+
+	// gpu_resource needs to be restored to its initial contents.
+	bool dirty = false;
+	// Initial upload and transition to execution_state have not been recorded yet.
+	bool pending_upload = false;
+
+	// Set if gpu_resource is shared with other captures. Those are always read-only.
+	std::shared_ptr<SharedResource> shared;
+
+	// Only valid while loading, until staging memory has been filled.
+	struct
+	{
+		std::vector<Util::BlobRef> blobs;
+		uint8_t *mapped = nullptr;
+		uint32_t src_pixel_size = 0;
+		uint32_t src_pixel_offset = 0;
+		uint32_t dst_pixel_size = 0;
+	} upload;
+};
+
+// Accumulated from whichever thread finishes a blob.
+struct BlobUploadStats
+{
+	std::atomic<uint64_t> decompress_ns{0};
+	std::atomic<uint64_t> repack_ns{0};
+	std::atomic<uint64_t> compressed_bytes{0};
+	std::atomic<uint64_t> decompressed_bytes{0};
+};
+
+enum class AllocationStrategy
+{
+	Packed,
+	Committed
+};
+
+// Everything owned by one loaded capture. In suite mode it is torn down between captures,
+// while the Device keeps its queue, command lists and timing state.
+struct Capture
+{
+	ComPtr<ID3D12Device> device;
+	ComPtr<ID3D12Device10> device10;
+
+	// Declared ahead of resources so heaps outlive everything placed in them.
+	AllocationStrategy allocation_strategy = AllocationStrategy::Packed;
+	bool mixed_resource_heaps = false;
+	HeapAllocator buffer_heaps;
+	HeapAllocator texture_heaps;
+	HeapAllocator upload_heaps;
+	struct
+	{
+		uint64_t requested_bytes = 0;
+		uint64_t committed_bytes = 0;
+		uint32_t count = 0;
+	} committed_allocations;
+
+	void init_heaps();
+	// Dedicated resources are always committed, so they can outlive the heaps of the capture.
+	bool create_replay_resource(const D3D12_HEAP_PROPERTIES &heap_props, const D3D12_RESOURCE_DESC1 &desc,
+	                            D3D12_BARRIER_LAYOUT layout, const std::vector<DXGI_FORMAT> &castable,
+	                            ComPtr<ID3D12Resource> &resource, bool dedicated = false);
+	void log_allocation_stats() const;
+
+	Resource create_resource_from_desc(const Util::CaptureResourceDesc &resource_desc, bool dedicated = false);
+
+	// Owned by the Device. Null means every PSO is compiled from scratch.
+	PipelineCache *pipeline_cache = nullptr;
+	PipelineState create_compute_shader(const Util::BlobRef &cs, const Util::BlobRef &rs);
+
+	struct NamedResource
+	{
+		std::string name;
+		Resource resource;
+	};
+	std::vector<NamedResource> resources;
+	// Index into resources for every entry of CaptureDesc::resources, CaptureNoResource if it was skipped.
+	std::vector<uint32_t> resource_indices;
+
+	bool create_resources(const Util::CaptureDesc &desc);
+	Resource create_shared_resource(const Util::CaptureResourceDesc &resource_desc, Util::Hash key);
+	void publish_shared_resources();
+
+	// Created by this capture, only handed to the SharedObjectCache once their staging memory is complete.
+	struct PendingSharedResource
+	{
+		Util::Hash key;
+		std::shared_ptr<SharedResource> entry;
+		uint64_t size;
+	};
+	std::vector<PendingSharedResource> pending_shared_resources;
+
+	// Owned by the Device. Null means nothing is shared with other captures.
+	SharedObjectCache *shared_objects = nullptr;
+	bool upload_resources();
+	bool upload_resources_mapped(BlobUploadStats &stats);
+	bool upload_resources_async(BlobUploadStats &stats);
+	bool upload_cached_blob(Resource &res, uint32_t mip, const Util::BlobRef &blob, BlobUploadStats &stats,
+	                        bool &hit);
+
+	// Owned by the Device. Null means blobs are mapped and copied synchronously.
+	Util::BlobReader *blob_reader = nullptr;
+	Util::IOGate *io_gate = nullptr;
+	// Owned by the Device. Null means content-addressed blobs are read like any other.
+	Util::BlobCache *blob_cache = nullptr;
+	// Chunks of one compressed blob are spread over this many threads.
+	unsigned decompress_threads = 1;
+
+	// Stage durations of load_capture. Stages overlap, so they do not add up to wall_ms.
+	struct
+	{
+		double pso_ms = 0.0;
+		// Summed over pipelines compiled in parallel, split by whether they came from the pipeline cache.
+		double pso_cold_ms = 0.0;
+		double pso_warm_ms = 0.0;
+		uint32_t pso_cold_count = 0;
+		uint32_t pso_warm_count = 0;
+		double create_ms = 0.0;
+		double upload_ms = 0.0;
+		// Part of upload_ms, summed over the threads repacking blobs.
+		double repack_ms = 0.0;
+		double descriptor_ms = 0.0;
+		double wall_ms = 0.0;
+		// Summed over blobs decompressed in parallel.
+		double decompress_ms = 0.0;
+		// Bytes read from disk, compressed blobs count with their stored size.
+		uint64_t blob_bytes = 0;
+		uint64_t compressed_bytes = 0;
+		uint64_t decompressed_bytes = 0;
+		// Content-addressed blobs taken from the blob cache, not part of blob_bytes.
+		uint64_t cached_bytes = 0;
+		// Reused through the SharedObjectCache instead of being created.
+		uint32_t shared_resource_count = 0;
+		uint64_t shared_resource_bytes = 0;
+		uint32_t pso_shared_count = 0;
+		// Read-only resources with data outside a blob store, which only match the very same file range.
+		uint32_t shared_by_location_count = 0;
+		// Never bound by a view or root parameter, so neither created nor read.
+		uint32_t skipped_resource_count = 0;
+		uint64_t skipped_resource_bytes = 0;
+		uint64_t skipped_blob_bytes = 0;
+	} load_timings;
+
+	bool load_capture(const Util::CaptureDesc &desc);
+
+	ComPtr<ID3D12DescriptorHeap> resource_heap;
+	ComPtr<ID3D12DescriptorHeap> sampler_heap;
+	bool allocate_descriptor_heaps(const Util::CaptureDesc &desc);
+
+	// What each resource heap slot points to, for hazard tracking.
+	struct DescriptorAccess
+	{
+		Resource *resource = nullptr;
+		Resource *counter_resource = nullptr;
+		bool write = false;
+	};
+	std::vector<DescriptorAccess> heap_accesses;
+
+	bool create_descriptors(const Util::CaptureDesc &desc);
+	bool create_srv_descriptors(const std::vector<Util::CaptureSRVDesc> &srvs);
+	bool create_uav_descriptors(const std::vector<Util::CaptureUAVDesc> &uavs);
+	bool create_cbv_descriptors(const std::vector<Util::CaptureCBVDesc> &cbvs);
+	bool create_sampler_descriptors(const std::vector<Util::CaptureSamplerDesc> &samplers);
+
+	Resource *get_resource(uint32_t index);
+
+	DispatchPlan plan;
+	bool compile_dispatch_plan(const Util::CaptureDesc &desc);
+	bool compile_dispatch_pass(const Util::CapturePassDesc &pass_desc, DispatchPass &pass);
+	void collect_pass_accesses(DispatchPass &pass) const;
+	void infer_pass_barriers();
+
+	ComPtr<ID3D12Resource> zero_buffer;
+	RestorePolicy restore_policy = RestorePolicy::PerDispatch;
+	bool classify_resources();
+};
+
+struct Device
+{
+	ComPtr<ID3D12Device> device;
+	ComPtr<ID3D12CommandQueue> queue;
+	ComPtr<ID3D12Fence> fence;
+	ComPtr<ID3D12GraphicsCommandList> list;
+
+	enum { NumFrameContexts = 4 };
+	struct
+	{
+		ComPtr<ID3D12CommandAllocator> allocator;
+		ComPtr<ID3D12QueryHeap> timestamps;
+		ComPtr<ID3D12Resource> timestamp_readback;
+		uint64_t fence_value_for_iteration = 0;
+		uint64_t first_dispatch_sequence = 0;
+		uint32_t pending_timestamps = 0;
+		uint32_t timestamps_per_dispatch = 2;
+		bool collect_timings = false;
+	} frame_contexts[NumFrameContexts] = {};
+
+	uint32_t frame_index = 0;
+	uint64_t latest_fence_value = 0;
+
+	enum class CacheMode
+	{
+		Warm,
+		Cold,
+		Both
+	};
+
+	// Cold dispatches are preceded by a copy through a scratch buffer large enough to evict the GPU caches.
+	CacheMode cache_mode = CacheMode::Warm;
+	ComPtr<ID3D12Resource> flush_src;
+	ComPtr<ID3D12Resource> flush_dst;
+	uint64_t dispatch_sequence = 0;
+	bool init_cache_flush(uint64_t size);
+	bool is_cold_dispatch(uint64_t sequence) const;
+	void execute_cache_flush();
+
+	enum class BarrierMode
+	{
+		Full,
+		Inferred,
+		Compare
+	};
+
+	// Between passes of a multi-pass capture. Compare alternates dispatches between both,
+	// timing the full-barrier ones separately as the baseline.
+	BarrierMode barrier_mode = BarrierMode::Full;
+	bool uses_full_barriers(uint64_t sequence) const;
+
+	enum { TimingWarm, TimingCold, TimingCount };
+	// Whole pass chain per dispatch. Multi-pass captures also get one entry per pass.
+	Util::TimingStats timing_stats[TimingCount];
+	std::vector<Util::TimingStats> pass_timing_stats[TimingCount];
+	Util::TimingStats baseline_timing_stats[TimingCount];
+
+	// Cost of an empty EndQuery pair, subtracted from every sample.
+	uint64_t timestamp_overhead = 0;
+	bool calibrate_timestamp_overhead();
+
+	// Cleared during warmup. Applies to lists submitted while it is set.
+	bool collect_timings = true;
+	void read_timestamps(uint32_t context_index);
+	void drain_timestamps();
+
+	ComPtr<ID3D12Device10> device10;
+	AllocationStrategy allocation_strategy = AllocationStrategy::Packed;
+	bool mixed_resource_heaps = false;
+	bool init_allocators(AllocationStrategy strategy);
+
+	// Null means blobs are mapped and copied synchronously.
+	std::unique_ptr<Util::BlobReader> blob_reader;
+	unsigned decompress_threads = 1;
+	// Optional. Shared by every capture, so blobs common to several of them are read once.
+	std::unique_ptr<Util::BlobCache> blob_cache;
+	// Optional. Lets captures reuse identical read-only resources, root signatures and PSOs.
+	std::unique_ptr<SharedObjectCache> shared_objects;
+	// Optional. Paused while timings are collected, so captures loading in the background stay off the disk.
+	Util::IOGate *io_gate = nullptr;
+	RestorePolicy restore_policy = RestorePolicy::PerDispatch;
+	// Optional. Shared by every capture and written out when the suite is done.
+	std::unique_ptr<PipelineCache> pipeline_cache;
+
+	void wait_idle();
+	void teardown_swapchain();
+
+	// The capture being replayed. Replacing it waits for the GPU and resets the timing state.
+	// Captures can be created up front and loaded on any thread while another one replays.
+	std::unique_ptr<Capture> capture;
+	std::unique_ptr<Capture> create_capture();
+	void set_capture(std::unique_ptr<Capture> new_capture);
+	void release_capture();
+
+	void record_restore_copy(Resource &resource);
+
+	bool execute_iteration(uint32_t dispatches_per_list);
+	void execute_sync_dirty();
+	void execute_sync_uploads();
+	void execute_dispatch(uint32_t iteration);
+
+#ifdef _WIN32
+	ComPtr<IDXGIFactory2> factory;
+#endif
+	ComPtr<IDXGISwapChain3> swapchain;
+	ComPtr<IDXGIVkSwapChain> vk_swapchain;
+	ComPtr<ID3D12Resource> backbuffers[2];
+	ComPtr<ID3D12DescriptorHeap> rtv;
+
+	bool init_swapchain(SDL_Window *window);
+};
+
+PipelineState Capture::create_compute_shader(const Util::BlobRef &cs, const Util::BlobRef &rs)
+{
+	std::vector<uint8_t> cs_data, rs_data;
+	if (!Util::load_blob(cs, cs_data) || !Util::load_blob(rs, rs_data))
+		return {};
+
+	// Root signatures are shared by their bytecode, PSOs by that of both blobs.
+	auto rs_key = Util::hash_blob(rs_data.data(), rs_data.size());
+	auto pso_key = Util::hash_blob(cs_data.data(), cs_data.size(), rs_key);
+
+	if (shared_objects)
+	{
+		auto shared = shared_objects->find<const PipelineState>(SharedObjectCache::Kind::Pipeline, pso_key);
+		if (shared)
+		{
+			PipelineState pipe = *shared;
+			pipe.create_ms = 0.0;
+			pipe.cache_hit = false;
+			pipe.shared_hit = true;
+			pipe.shared_entry = std::move(shared);
+			return pipe;
+		}
+	}
+
+	PipelineState pipe;
+
+	std::shared_ptr<const PipelineState> shared_rs;
+	if (shared_objects)
+		shared_rs = shared_objects->find<const PipelineState>(SharedObjectCache::Kind::RootSignature, rs_key);
+
+	if (shared_rs)
+	{
+		pipe.root_signature = shared_rs->root_signature;
+		pipe.layout = shared_rs->layout;
+		pipe.has_layout = shared_rs->has_layout;
+	}
+	else
+	{
+		if (FAILED(device->CreateRootSignature(
+				0, rs_data.data(), rs_data.size(),
+				IID_ID3D12RootSignature, pipe.root_signature.ppv())))
+		{
+			LOGE("Failed to create root signature.\n");
+			return {};
+		}
+
+		pipe.has_layout = Util::parse_root_signature(rs_data.data(), rs_data.size(), pipe.layout);
+		if (!pipe.has_layout)
+		{
+			LOGW("Failed to parse root signature %s, descriptor tables are assumed to reach the end of the heap.\n",
+			     rs.path.c_str());
+		}
+
+		if (shared_objects)
+		{
+			auto entry = std::make_shared<PipelineState>();
+			entry->root_signature = pipe.root_signature;
+			entry->layout = pipe.layout;
+			entry->has_layout = pipe.has_layout;
+			shared_objects->insert<const PipelineState>(SharedObjectCache::Kind::RootSignature, rs_key,
+			                                            std::move(entry), rs_data.size());
+		}
+	}
+
+	D3D12_COMPUTE_PIPELINE_STATE_DESC desc = {};
+	desc.pRootSignature = pipe.root_signature.get();
+	desc.CS.pShaderBytecode = cs_data.data();
+	desc.CS.BytecodeLength = cs_data.size();
+
+	auto start_time = std::chrono::steady_clock::now();
+	bool success;
+
+	if (pipeline_cache)
+	{
+		Util::Hasher hasher;
+		hasher.data(cs_data.data(), cs_data.size());
+		hasher.u32(0xff);
+		hasher.data(rs_data.data(), rs_data.size());
+		success = pipeline_cache->create_compute_pipeline(desc, hasher.get(), pipe.pso, pipe.cache_hit);
+	}
+	else
+	{
+		success = SUCCEEDED(device->CreateComputePipelineState(&desc, IID_ID3D12PipelineState, pipe.pso.ppv()));
+	}
+
+	if (!success)
+	{
+		LOGE("Failed to create PSO.\n");
+		return {};
+	}
+
+	pipe.create_ms = elapsed_ms(start_time);
+
+	// Driver memory is not known, the bytecode size stands in for it.
+	if (shared_objects)
+	{
+		auto entry = std::make_shared<const PipelineState>(pipe);
+		pipe.shared_entry = shared_objects->insert<const PipelineState>(
+				SharedObjectCache::Kind::Pipeline, pso_key, entry, cs_data.size() + rs_data.size());
+	}
+
+	return pipe;
+}
+
+bool Device::init_allocators(AllocationStrategy strategy)
+{
+	if (FAILED(device->QueryInterface(IID_ID3D12Device10, device10.ppv())))
+	{
+		LOGE("Failed to query ID3D12Device10. AgilitySDK dlls might not be present?\n");
+		return false;
+	}
+
+	D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+	if (FAILED(device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options))))
+	{
+		LOGE("Failed to query OPTIONS.\n");
+		return false;
+	}
+
+	allocation_strategy = strategy;
+
+	// Tier 1 cannot mix buffers and textures in one heap.
+	mixed_resource_heaps = options.ResourceHeapTier >= D3D12_RESOURCE_HEAP_TIER_2;
+
+	return true;
+}
+
+void Capture::init_heaps()
+{
+	buffer_heaps.props.Type = D3D12_HEAP_TYPE_DEFAULT;
+	buffer_heaps.flags = mixed_resource_heaps ?
+	                     D3D12_HEAP_FLAG_ALLOW_ALL_BUFFERS_AND_TEXTURES : D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+	texture_heaps.props.Type = D3D12_HEAP_TYPE_DEFAULT;
+	texture_heaps.flags = D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+
+	// Must match the staging heap properties in create_resource_from_desc.
+	upload_heaps.props.Type = D3D12_HEAP_TYPE_CUSTOM;
+	upload_heaps.props.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_WRITE_COMBINE;
+	upload_heaps.props.MemoryPoolPreference = D3D12_MEMORY_POOL_L0;
+	upload_heaps.flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+}
+
+bool Capture::create_replay_resource(const D3D12_HEAP_PROPERTIES &heap_props, const D3D12_RESOURCE_DESC1 &desc,
+                                    D3D12_BARRIER_LAYOUT layout, const std::vector<DXGI_FORMAT> &castable,
+                                    ComPtr<ID3D12Resource> &resource, bool dedicated)
+{
+	bool is_buffer = desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER;
+	bool is_rt_ds = (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET |
+	                               D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)) != 0;
+
+	// Placed RT and DS textures must be cleared or discarded before the first copy into them,
+	// so those stay committed.
+	HeapAllocator *allocator = nullptr;
+	if (allocation_strategy == AllocationStrategy::Packed && !is_rt_ds && !dedicated)
+	{
+		if (heap_props.Type != D3D12_HEAP_TYPE_DEFAULT)
+			allocator = &upload_heaps;
+		else if (is_buffer || mixed_resource_heaps)
+			allocator = &buffer_heaps;
+		else
+			allocator = &texture_heaps;
+	}
+
+	auto placed_desc = desc;
+	D3D12_RESOURCE_ALLOCATION_INFO info = {};
+
+	// Small textures can be placed at 4 KiB if the device agrees.
+	// Buffers are always 64 KiB aligned.
+	if (allocator && !is_buffer)
+	{
+		placed_desc.Alignment = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+		info = device10->GetResourceAllocationInfo2(0, 1, &placed_desc, nullptr);
+		if (info.Alignment != D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT)
+			placed_desc.Alignment = 0;
+	}
+
+	if (placed_desc.Alignment == 0)
+		info = device10->GetResourceAllocationInfo2(0, 1, &placed_desc, nullptr);
+
+	if (info.SizeInBytes == UINT64_MAX)
+	{
+		LOGE("Failed to query resource allocation info.\n");
+		return false;
+	}
+
+	if (!allocator)
+	{
+		if (FAILED(device10->CreateCommittedResource3(
+				&heap_props, D3D12_HEAP_FLAG_NONE, &desc, layout, nullptr, nullptr,
+				castable.size(), castable.data(),
+				IID_ID3D12Resource, resource.ppv())))
+		{
+			LOGE("Failed to create resource.\n");
+			return false;
+		}
+
+		committed_allocations.requested_bytes += info.SizeInBytes;
+		committed_allocations.committed_bytes +=
+				(info.SizeInBytes + D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT - 1) &
+				~uint64_t(D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT - 1);
+		committed_allocations.count++;
+		return true;
+	}
+
+	ID3D12Heap *heap = nullptr;
+	uint64_t offset = 0;
+	if (!allocator->allocate(device.get(), info, &heap, &offset))
+		return false;
+
+	if (FAILED(device10->CreatePlacedResource2(
+			heap, offset, &placed_desc, layout, nullptr,
+			castable.size(), castable.data(),
+			IID_ID3D12Resource, resource.ppv())))
+	{
+		LOGE("Failed to create placed resource.\n");
+		return false;
+	}
+
+	return true;
+}
+
+void Capture::log_allocation_stats() const
+{
+	uint64_t requested_bytes = committed_allocations.requested_bytes;
+	uint64_t committed_bytes = committed_allocations.committed_bytes;
+	size_t num_heaps = 0;
+
+	for (auto *allocator : { &buffer_heaps, &texture_heaps, &upload_heaps })
+	{
+		requested_bytes += allocator->requested_bytes;
+		committed_bytes += allocator->committed_bytes;
+		num_heaps += allocator->blocks.size();
+	}
+
+	LOGI("Resource allocation (%s): %.3f MiB requested, %.3f MiB committed, %u heaps, "
+	     "%u committed resources, created in %.3f ms.\n",
+	     allocation_strategy == AllocationStrategy::Packed ? "packed" : "committed",
+	     double(requested_bytes) / (1024.0 * 1024.0), double(committed_bytes) / (1024.0 * 1024.0),
+	     unsigned(num_heaps), committed_allocations.count, load_timings.create_ms);
+}
+
+Resource Capture::create_resource_from_desc(const Util::CaptureResourceDesc &resource_desc, bool dedicated)
+{
+	D3D12_HEAP_PROPERTIES heap_props = {};
+	D3D12_RESOURCE_DESC1 desc = resource_desc.desc;
+	Resource res;
+
+	heap_props.Type = D3D12_HEAP_TYPE_DEFAULT;
+
+	if (desc.SampleDesc.Count > 1)
+	{
+		LOGW("MSAA not supported yet.\n");
+		return {};
+	}
+
+	// For simplicity, use legacy barriers. Resource has to be in COMMON layout to move in and out of the models.
+	// It's very unclear from D3D12 docs if initial layout has any meaning w.r.t this rule though ...
+	auto barrier_layout =
+			desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER ?
+			D3D12_BARRIER_LAYOUT_UNDEFINED : D3D12_BARRIER_LAYOUT_COMMON;
+
+	if (!create_replay_resource(heap_props, desc, barrier_layout, resource_desc.cast_formats,
+	                            res.gpu_resource, dedicated))
+		return {};
+
+	if (!resource_desc.restore.empty() && !parse_restore_policy(resource_desc.restore.c_str(), res.restore))
+		return {};
+
+	// Whether a restore copy is needed is only known once descriptors and root parameters are resolved.
+	res.desc = desc;
+	res.castable_formats = resource_desc.cast_formats;
+
+	heap_props.Type = D3D12_HEAP_TYPE_CUSTOM;
+	heap_props.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_WRITE_COMBINE;
+	heap_props.MemoryPoolPreference = D3D12_MEMORY_POOL_L0;
+	desc.Flags &= ~(D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS |
+	                D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET |
+	                D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
+
+	D3D12_RESOURCE_DESC1 upload_desc = desc;
+	if (desc.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER)
+	{
+		uint32_t num_subresources = desc.MipLevels;
+		if (desc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE3D)
+			num_subresources *= desc.DepthOrArraySize;
+
+		UINT64 total_bytes = 0;
+		res.placed_footprints.resize(num_subresources);
+
+		D3D12_RESOURCE_DESC desc0 = {};
+		desc0.Width = desc.Width;
+		desc0.Height = desc.Height;
+		desc0.DepthOrArraySize = desc.DepthOrArraySize;
+		desc0.MipLevels = desc.MipLevels;
+		desc0.SampleDesc = desc.SampleDesc;
+		desc0.Layout = desc.Layout;
+		desc0.Dimension = desc.Dimension;
+		desc0.Format = desc.Format;
+		desc0.Flags = desc.Flags;
+		device->GetCopyableFootprints(&desc0, 0, num_subresources, 0, res.placed_footprints.data(),
+		                              nullptr, nullptr, &total_bytes);
+		if (total_bytes == UINT64_MAX)
+			return {};
+
+		upload_desc = {};
+		upload_desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		upload_desc.Format = DXGI_FORMAT_UNKNOWN;
+		upload_desc.Width = total_bytes;
+		upload_desc.Height = 1;
+		upload_desc.DepthOrArraySize = 1;
+		upload_desc.MipLevels = 1;
+		upload_desc.SampleDesc.Count = 1;
+		upload_desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+	}
+
+	res.upload_size = upload_desc.Width;
+
+	// Resources without data never need staging memory.
+	if (!resource_desc.data.empty())
+	{
+		if (resource_desc.data.size() < desc.MipLevels)
+		{
+			LOGE("Need one data entry per mip level.\n");
+			return {};
+		}
+
+		if (desc.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER &&
+		    (resource_desc.dst_pixel_size == 0 ||
+		     resource_desc.src_pixel_offset + resource_desc.dst_pixel_size > resource_desc.src_pixel_size))
+		{
+			LOGE("PixelSlice and PixelSliceOffset must fit within PixelSize.\n");
+			return {};
+		}
+
+		if (!create_replay_resource(heap_props, upload_desc, D3D12_BARRIER_LAYOUT_UNDEFINED, {},
+		                            res.staging_resource, dedicated))
+			return {};
+
+		res.upload.src_pixel_size = resource_desc.src_pixel_size;
+		res.upload.src_pixel_offset = resource_desc.src_pixel_offset;
+		res.upload.dst_pixel_size = resource_desc.dst_pixel_size;
+		res.upload.blobs.assign(resource_desc.data.begin(), resource_desc.data.begin() + desc.MipLevels);
+
+		if (FAILED(res.staging_resource->Map(0, nullptr, reinterpret_cast<void **>(&res.upload.mapped))))
+		{
+			LOGE("Failed to map staging resource.\n");
+			return {};
+		}
+
+		res.has_data = true;
+	}
+
+	return res;
+}
+
+// Fills the staging memory of one mip level from its blob. Buffers are a straight copy,
+// textures are repacked into the placed footprints of every layer.
+static bool write_blob_to_staging(Resource &res, uint32_t mip, const uint8_t *data, size_t data_size)
+{
+	auto desc = res.gpu_resource->GetDesc();
+	uint8_t *ptr = res.upload.mapped;
+
+	if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+	{
+		if (data_size != desc.Width)
+		{
+			LOGE("Mismatch between desc Width and buffer. %zu != %zu\n",
+			     data_size, size_t(desc.Width));
+			return false;
+		}
+
+		// Async reads land in the staging memory directly.
+		if (data != ptr)
+			memcpy(ptr, data, data_size);
+		return true;
+	}
+
+	uint32_t src_pixel_size = res.upload.src_pixel_size;
+	uint32_t dst_pixel_size = res.upload.dst_pixel_size;
+	uint32_t block_width, block_height;
+
+	get_block_dimensions(desc.Format, block_width, block_height);
+
+	size_t data_offset = 0;
+	uint32_t num_layers = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : desc.DepthOrArraySize;
+
+	for (uint32_t layer = 0; layer < num_layers; layer++)
+	{
+		auto &footprint = res.placed_footprints[mip + desc.MipLevels * layer];
+		uint32_t blocks_x = (footprint.Footprint.Width + block_width - 1) / block_width;
+		uint32_t blocks_y = (footprint.Footprint.Height + block_height - 1) / block_height;
+		uint32_t blocks_z = footprint.Footprint.Depth;
+
+		for (uint32_t z = 0; z < blocks_z; z++)
+		{
+			for (uint32_t y = 0; y < blocks_y; y++)
+			{
+				if (data_offset + src_pixel_size * blocks_x > data_size)
+				{
+					LOGE("Data buffer is not large enough.\n");
+					return false;
+				}
+
+				Util::repack_texels(ptr + footprint.Offset +
+				                    y * footprint.Footprint.RowPitch +
+				                    z * footprint.Footprint.RowPitch * blocks_y,
+				                    data + data_offset, blocks_x,
+				                    src_pixel_size, res.upload.src_pixel_offset, dst_pixel_size);
+				data_offset += src_pixel_size * blocks_x;
+			}
+		}
+	}
+
+	return true;
+}
+
+// Bytes write_blob_to_staging consumes from a texture blob for one mip level.
+static size_t get_texture_blob_size(Resource &res, uint32_t mip)
+{
+	auto desc = res.gpu_resource->GetDesc();
+	uint32_t block_width, block_height;
+	get_block_dimensions(desc.Format, block_width, block_height);
+
+	size_t size = 0;
+	uint32_t num_layers = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : desc.DepthOrArraySize;
+	for (uint32_t layer = 0; layer < num_layers; layer++)
+	{
+		auto &footprint = res.placed_footprints[mip + desc.MipLevels * layer];
+		size_t blocks_x = (footprint.Footprint.Width + block_width - 1) / block_width;
+		size_t blocks_y = (footprint.Footprint.Height + block_height - 1) / block_height;
+		size += res.upload.src_pixel_size * blocks_x * blocks_y * footprint.Footprint.Depth;
+	}
+
+	return size;
+}
+
+// Buffers are decompressed straight into staging memory, textures go through scratch memory to be repacked.
+static bool write_chunked_blob_to_staging(Resource &res, uint32_t mip, const uint8_t *blob, size_t size,
+                                          const Util::ChunkedBlobHeader &header, unsigned num_threads,
+                                          BlobUploadStats &stats)
+{
+	auto raw_size = size_t(header.raw_size);
+	bool is_buffer = res.gpu_resource->GetDesc().Dimension == D3D12_RESOURCE_DIMENSION_BUFFER;
+	if (is_buffer && raw_size != res.gpu_resource->GetDesc().Width)
+	{
+		LOGE("Mismatch between desc Width and buffer. %zu != %zu\n",
+		     raw_size, size_t(res.gpu_resource->GetDesc().Width));
+		return false;
+	}
+
+	std::vector<uint8_t> scratch;
+	uint8_t *dst = res.upload.mapped;
+	if (!is_buffer)
+	{
+		// The header is not trusted with the scratch allocation. Like raw blobs, the texels may be followed
+		// by some slack, but never by more than the staging memory of the whole resource.
+		size_t expected_size = get_texture_blob_size(res, mip);
+		if (raw_size < expected_size || raw_size > std::max<size_t>(expected_size, res.upload_size))
+		{
+			LOGE("Compressed texture blob decodes to %zu bytes, expected %zu.\n", raw_size, expected_size);
+			return false;
+		}
+
+		scratch.resize(raw_size);
+		dst = scratch.data();
+	}
+
+	auto decompress_start = std::chrono::steady_clock::now();
+	if (!Util::decompress_chunked_blob(blob, size, dst, raw_size, num_threads))
+		return false;
+	stats.decompress_ns += elapsed_ns(decompress_start);
+	stats.compressed_bytes += size;
+	stats.decompressed_bytes += raw_size;
+
+	if (is_buffer)
+		return true;
+
+	auto repack_start = std::chrono::steady_clock::now();
+	bool success = write_blob_to_staging(res, mip, dst, raw_size);
+	stats.repack_ns += elapsed_ns(repack_start);
+	return success;
+}
+
+// Blobs are stored either raw or chunked, which is told apart by their header.
+static bool write_stored_blob_to_staging(Resource &res, uint32_t mip, const uint8_t *data, size_t size,
+                                         unsigned num_threads, BlobUploadStats &stats)
+{
+	Util::ChunkedBlobHeader header;
+	if (Util::parse_chunked_blob_header(data, size, header))
+		return write_chunked_blob_to_staging(res, mip, data, size, header, num_threads, stats);
+
+	auto repack_start = std::chrono::steady_clock::now();
+	bool success = write_blob_to_staging(res, mip, data, size);
+	stats.repack_ns += elapsed_ns(repack_start);
+	return success;
+}
+
+bool Capture::upload_cached_blob(Resource &res, uint32_t mip, const Util::BlobRef &blob, BlobUploadStats &stats,
+                                 bool &hit)
+{
+	hit = false;
+	if (!blob_cache || !blob.content_hash)
+		return true;
+
+	auto cached = blob_cache->find(blob.content_hash);
+	if (!cached)
+		return true;
+
+	hit = true;
+	load_timings.cached_bytes += cached->size();
+	if (!write_stored_blob_to_staging(res, mip, cached->data(), cached->size(), decompress_threads, stats))
+	{
+		LOGE("Failed to upload \"%s\".\n", blob.path.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool Capture::upload_resources_mapped(BlobUploadStats &stats)
+{
+	// Packed blobs share their container, which stays mapped across blobs.
+	Util::FileMapping mapping;
+	std::string mapped_path;
+
+	for (auto &resource : resources)
+	{
+		auto &res = resource.resource;
+		for (uint32_t mip = 0; mip < uint32_t(res.upload.blobs.size()); mip++)
+		{
+			auto &blob = res.upload.blobs[mip];
+
+			bool hit;
+			if (!upload_cached_blob(res, mip, blob, stats, hit))
+				return false;
+			if (hit)
+				continue;
+
+			if (io_gate)
+				io_gate->wait();
+
+			// Copy straight out of the page cache into the staging mapping.
+			if (!blob.packed || blob.path != mapped_path)
+			{
+				if (!mapping.map(blob.path))
+				{
+					LOGE("Failed to load init buffer \"%s\".\n", blob.path.c_str());
+					return false;
+				}
+				mapped_path = blob.path;
+			}
+
+			const uint8_t *data = mapping.data();
+			size_t size = mapping.size();
+			if (blob.packed)
+			{
+				if (blob.offset > size || blob.size > size - blob.offset)
+				{
+					LOGE("Blob at offset %llu is out of bounds of \"%s\".\n",
+					     static_cast<unsigned long long>(blob.offset), blob.path.c_str());
+					return false;
+				}
+
+				data += blob.offset;
+				size = size_t(blob.size);
+			}
+
+			if (!write_stored_blob_to_staging(res, mip, data, size, decompress_threads, stats))
+			{
+				LOGE("Failed to upload \"%s\".\n", blob.path.c_str());
+				return false;
+			}
+
+			load_timings.blob_bytes += size;
+			if (blob_cache && blob.content_hash)
+				blob_cache->insert(blob.content_hash, std::vector<uint8_t>(data, data + size));
+		}
+	}
+
+	return true;
+}
+
+bool Capture::upload_resources_async(BlobUploadStats &stats)
+{
+	struct Target
+	{
+		Resource *resource;
+		uint32_t mip;
+		// Otherwise read into scratch, which only exists while the blob is in flight.
+		bool direct;
+		std::vector<uint8_t> scratch;
+		// Non-zero if scratch goes to the blob cache once uploaded.
+		Util::Hash content_hash;
+	};
+
+	// Scratch memory in flight at once. Without a cap, a capture full of textures would hold every blob
+	// in memory before the first one is repacked.
+	const size_t scratch_budget = 256 * 1024 * 1024;
+
+	// Reads straight into staging memory come first, they need no scratch memory.
+	std::vector<Util::BlobRead> reads, scratch_reads;
+	std::vector<Target> targets, scratch_targets;
+
+	// Packed blobs take their size from the container, only loose files are stat'ed.
+	// That is the only IO before the reads are queued, so it goes through the gate as well.
+	if (io_gate)
+		io_gate->wait();
+
+	for (auto &resource : resources)
+	{
+		auto &res = resource.resource;
+		bool is_buffer = res.gpu_resource->GetDesc().Dimension == D3D12_RESOURCE_DIMENSION_BUFFER;
+
+		for (uint32_t mip = 0; mip < uint32_t(res.upload.blobs.size()); mip++)
+		{
+			auto &blob = res.upload.blobs[mip];
+
+			// Blobs already in memory are uploaded right away, only the rest is queued.
+			bool hit;
+			if (!upload_cached_blob(res, mip, blob, stats, hit))
+				return false;
+			if (hit)
+				continue;
+
+			uint64_t size = 0;
+			if (!Util::query_blob_size(blob, size) || size == 0)
+			{
+				LOGE("Failed to load init buffer \"%s\".\n", blob.path.c_str());
+				return false;
+			}
+
+			Util::BlobRead read;
+			read.path = blob.path;
+			read.size = size_t(size);
+			read.offset = size_t(blob.offset);
+			read.packed = blob.packed;
+
+			Target target = { &res, mip, false, {}, blob_cache ? blob.content_hash : 0 };
+			load_timings.blob_bytes += read.size;
+
+			// Buffers the size of the resource are read straight into staging memory. Everything else,
+			// compressed blobs included, is read into scratch memory and uploaded from there once it
+			// arrives. Blobs which are kept in the blob cache need a copy of their own anyway.
+			if (is_buffer && read.size == res.gpu_resource->GetDesc().Width && !target.content_hash)
+			{
+				read.dst = res.upload.mapped;
+				target.direct = true;
+				reads.push_back(std::move(read));
+				targets.push_back(std::move(target));
+			}
+			else
+			{
+				scratch_reads.push_back(std::move(read));
+				scratch_targets.push_back(std::move(target));
+			}
+		}
+	}
+
+	reads.insert(reads.end(), std::make_move_iterator(scratch_reads.begin()),
+	             std::make_move_iterator(scratch_reads.end()));
+	targets.insert(targets.end(), std::make_move_iterator(scratch_targets.begin()),
+	               std::make_move_iterator(scratch_targets.end()));
+
+	std::atomic<bool> success{true};
+
+	// Decompress and repack each blob as soon as it arrives, on whichever thread completed it.
+	// Compressed blobs are only told apart by their header, so that is checked on the data just read.
+	auto on_complete = [&](size_t index, bool ok) {
+		auto &target = targets[index];
+		Util::ChunkedBlobHeader header;
+		if (ok && target.direct && Util::parse_chunked_blob_header(reads[index].dst, reads[index].size, header))
+		{
+			// A compressed buffer which happens to be as large as the resource landed in staging memory.
+			// It cannot be decompressed in place.
+			target.scratch.assign(reads[index].dst, reads[index].dst + reads[index].size);
+		}
+
+		if (ok && !target.scratch.empty())
+		{
+			if (!write_stored_blob_to_staging(*target.resource, target.mip, target.scratch.data(),
+			                                  target.scratch.size(), decompress_threads, stats))
+			{
+				LOGE("Failed to upload \"%s\".\n", reads[index].path.c_str());
+				success = false;
+			}
+			else if (target.content_hash)
+				blob_cache->insert(target.content_hash, std::move(target.scratch));
+		}
+
+		// Released as soon as the blob is in staging memory.
+		target.scratch = {};
+	};
+
+	// Reads are queued in waves which fit the scratch budget. A blob larger than the budget gets a wave of its own.
+	bool read_success = true;
+	for (size_t begin = 0; begin < reads.size() && read_success && success; )
+	{
+		size_t end = begin;
+		size_t scratch_size = 0;
+		for (; end < reads.size(); end++)
+		{
+			auto &target = targets[end];
+			if (target.direct)
+				continue;
+
+			if (scratch_size && scratch_size + reads[end].size > scratch_budget)
+				break;
+
+			scratch_size += reads[end].size;
+			target.scratch.resize(reads[end].size);
+			reads[end].dst = target.scratch.data();
+		}
+
+		std::vector<Util::BlobRead> wave(reads.begin() + begin, reads.begin() + end);
+		read_success = blob_reader->read(wave, [&, begin](size_t index, bool ok) { on_complete(begin + index, ok); });
+		begin = end;
+	}
+
+	return read_success && success.load();
+}
+
+bool Capture::upload_resources()
+{
+	auto start_time = std::chrono::steady_clock::now();
+	BlobUploadStats stats;
+	bool success = blob_reader ? upload_resources_async(stats) : upload_resources_mapped(stats);
+
+	load_timings.repack_ms += 1e-6 * double(stats.repack_ns.load());
+	load_timings.decompress_ms += 1e-6 * double(stats.decompress_ns.load());
+	load_timings.compressed_bytes += stats.compressed_bytes.load();
+	load_timings.decompressed_bytes += stats.decompressed_bytes.load();
+
+	for (auto &resource : resources)
+	{
+		auto &res = resource.resource;
+		if (res.upload.mapped)
+			res.staging_resource->Unmap(0, nullptr);
+		res.upload = {};
+	}
+
+	if (!success)
+		return false;
+
+	load_timings.upload_ms = elapsed_ms(start_time);
+	double seconds = 1e-3 * load_timings.upload_ms;
+
+	LOGI("Read %.3f MiB of resource data in %.3f ms (%.3f MiB/s) using %s.\n",
+	     double(load_timings.blob_bytes) / (1024.0 * 1024.0), load_timings.upload_ms,
+	     seconds > 0.0 ? double(load_timings.blob_bytes) / (1024.0 * 1024.0 * seconds) : 0.0,
+	     blob_reader ? blob_reader->get_backend_name() : "mmap");
+
+	if (load_timings.cached_bytes)
+	{
+		LOGI("Took %.3f MiB of resource data from the blob cache instead of reading it.\n",
+		     double(load_timings.cached_bytes) / (1024.0 * 1024.0));
+	}
+
+	if (load_timings.compressed_bytes)
+	{
+		double decompress_seconds = 1e-3 * load_timings.decompress_ms;
+		LOGI("Decompressed %.3f MiB from %.3f MiB of compressed blobs (%.2fx) in %.3f ms (%.3f MiB/s) on up to %u threads.\n",
+		     double(load_timings.decompressed_bytes) / (1024.0 * 1024.0),
+		     double(load_timings.compressed_bytes) / (1024.0 * 1024.0),
+		     double(load_timings.decompressed_bytes) / double(load_timings.compressed_bytes),
+		     load_timings.decompress_ms,
+		     decompress_seconds > 0.0 ?
+		     double(load_timings.decompressed_bytes) / (1024.0 * 1024.0 * decompress_seconds) : 0.0,
+		     decompress_threads);
+	}
+
+	return true;
+}
+
+// Out of range indices are left for get_resource to report.
+static void mark_resource(std::vector<bool> &mask, uint32_t index)
+{
+	if (index < mask.size())
+		mask[index] = true;
+}
+
+// Resources reachable through views or root descriptors. Nothing else can be accessed by a dispatch.
+static std::vector<bool> find_bound_resources(const Util::CaptureDesc &desc)
+{
+	std::vector<bool> bound(desc.resources.size());
+
+	for (auto &cbv : desc.cbvs)
+		mark_resource(bound, cbv.resource);
+	for (auto &srv : desc.srvs)
+		mark_resource(bound, srv.resource);
+
+	for (auto &uav : desc.uavs)
+	{
+		mark_resource(bound, uav.resource);
+		mark_resource(bound, uav.counter_resource);
+	}
+
+	for (auto &pass : desc.passes)
+	{
+		for (auto &param : pass.parameters)
+		{
+			if (param.type == Util::CaptureRootParameterType::SRV ||
+			    param.type == Util::CaptureRootParameterType::UAV ||
+			    param.type == Util::CaptureRootParameterType::CBV)
+			{
+				mark_resource(bound, param.resource);
+			}
+		}
+	}
+
+	return bound;
+}
+
+// Resources a capture may write through UAVs. Everything else is read-only and can be shared between captures.
+static std::vector<bool> find_written_resources(const Util::CaptureDesc &desc)
+{
+	std::vector<bool> written(desc.resources.size());
+
+	for (auto &uav : desc.uavs)
+	{
+		mark_resource(written, uav.resource);
+		mark_resource(written, uav.counter_resource);
+	}
+
+	for (auto &pass : desc.passes)
+		for (auto &param : pass.parameters)
+			if (param.type == Util::CaptureRootParameterType::UAV)
+				mark_resource(written, param.resource);
+
+	return written;
+}
+
+// Resources match if their descs and data do. Data in a blob store is identified by its content hash,
+// anything else by where it is stored.
+static Util::Hash hash_shared_resource(const Util::CaptureResourceDesc &res)
+{
+	Util::Hasher hasher;
+	auto &desc = res.desc;
+	hasher.u32(desc.Dimension);
+	hasher.u64(desc.Alignment);
+	hasher.u64(desc.Width);
+	hasher.u32(desc.Height);
+	hasher.u32(desc.DepthOrArraySize);
+	hasher.u32(desc.MipLevels);
+	hasher.u32(desc.Format);
+	hasher.u32(desc.SampleDesc.Count);
+	hasher.u32(desc.SampleDesc.Quality);
+	hasher.u32(desc.Layout);
+	hasher.u32(desc.Flags);
+	hasher.u32(desc.SamplerFeedbackMipRegion.Width);
+	hasher.u32(desc.SamplerFeedbackMipRegion.Height);
+	hasher.u32(desc.SamplerFeedbackMipRegion.Depth);
+
+	hasher.u32(uint32_t(res.cast_formats.size()));
+	for (auto format : res.cast_formats)
+		hasher.u32(format);
+
+	hasher.u32(res.src_pixel_size);
+	hasher.u32(res.src_pixel_offset);
+	hasher.u32(res.dst_pixel_size);
+
+	hasher.u32(uint32_t(res.data.size()));
+	for (auto &blob : res.data)
+	{
+		if (blob.content_hash)
+		{
+			hasher.u32(1);
+			hasher.u64(blob.content_hash);
+		}
+		else
+		{
+			hasher.u32(2);
+			hasher.string(blob.path);
+			hasher.u64(blob.offset);
+			hasher.u64(blob.size);
+		}
+	}
+
+	return hasher.get();
+}
+
+Resource Capture::create_shared_resource(const Util::CaptureResourceDesc &resource_desc, Util::Hash key)
+{
+	auto entry = shared_objects->find<SharedResource>(SharedObjectCache::Kind::Resource, key);
+
+	if (entry)
+	{
+		Resource res;
+		res.gpu_resource = entry->gpu_resource;
+		res.desc = resource_desc.desc;
+		res.placed_footprints = entry->placed_footprints;
+		res.shared = std::move(entry);
+
+		auto info = device10->GetResourceAllocationInfo2(0, 1, &res.desc, nullptr);
+		load_timings.shared_resource_count++;
+		load_timings.shared_resource_bytes += info.SizeInBytes;
+		return res;
+	}
+
+	Resource res = create_resource_from_desc(resource_desc, true);
+	if (!res.gpu_resource)
+		return {};
+
+	res.shared = std::make_shared<SharedResource>();
+	res.shared->gpu_resource = res.gpu_resource;
+	res.shared->staging_resource = res.staging_resource;
+	res.shared->placed_footprints = res.placed_footprints;
+
+	// Only the GPU copy counts against the budget, staging memory is dropped once uploaded.
+	auto info = device10->GetResourceAllocationInfo2(0, 1, &res.desc, nullptr);
+	pending_shared_resources.push_back({ key, res.shared, info.SizeInBytes });
+	return res;
+}
+
+void Capture::publish_shared_resources()
+{
+	// If a capture loading concurrently got there first, ours simply stays private.
+	for (auto &pending : pending_shared_resources)
+		shared_objects->insert(SharedObjectCache::Kind::Resource, pending.key,
+		                       std::move(pending.entry), pending.size);
+	pending_shared_resources.clear();
+}
+
+bool Capture::create_resources(const Util::CaptureDesc &desc)
+{
+	auto bound = find_bound_resources(desc);
+	std::vector<bool> written;
+	if (shared_objects)
+		written = find_written_resources(desc);
+
+	resources.reserve(std::count(bound.begin(), bound.end(), true));
+	resource_indices.resize(desc.resources.size(), Util::CaptureNoResource);
+
+	// Identical read-only resources within the capture map to a single entry, so state is tracked once
+	// per ID3D12Resource.
+	std::unordered_map<Util::Hash, uint32_t> shared_indices;
+
+	for (size_t i = 0; i < desc.resources.size(); i++)
+	{
+		auto &resource_desc = desc.resources[i];
+
+		// Trimmed captures tend to carry plenty of these.
+		if (!bound[i])
+		{
+			auto info = device10->GetResourceAllocationInfo2(0, 1, &resource_desc.desc, nullptr);
+			load_timings.skipped_resource_count++;
+			load_timings.skipped_resource_bytes += info.SizeInBytes;
+
+			for (auto &blob : resource_desc.data)
+			{
+				uint64_t size = 0;
+				if (Util::query_blob_size(blob, size))
+					load_timings.skipped_blob_bytes += size;
+			}
+			continue;
+		}
+
+		Resource res;
+		if (shared_objects && !written[i])
+		{
+			if (std::any_of(resource_desc.data.begin(), resource_desc.data.end(),
+			                [](const Util::BlobRef &blob) { return blob.content_hash == 0; }))
+			{
+				load_timings.shared_by_location_count++;
+			}
+
+			auto key = hash_shared_resource(resource_desc);
+			auto itr = shared_indices.find(key);
+			if (itr != shared_indices.end())
+			{
+				resource_indices[i] = itr->second;
+				continue;
+			}
+
+			shared_indices[key] = uint32_t(resources.size());
+			res = create_shared_resource(resource_desc, key);
+		}
+		else
+			res = create_resource_from_desc(resource_desc);
+
+		if (!res.gpu_resource)
+			return false;
+
+		resource_indices[i] = uint32_t(resources.size());
+		resources.push_back({ resource_desc.name, std::move(res) });
+	}
+
+	return true;
+}
+
+Resource *Capture::get_resource(uint32_t index)
+{
+	if (index >= resource_indices.size())
+	{
+		LOGE("Resource index %u is out of range.\n", index);
+		return nullptr;
+	}
+
+	if (resource_indices[index] == Util::CaptureNoResource)
+	{
+		LOGE("Resource index %u is not bound and was never created.\n", index);
+		return nullptr;
+	}
+
+	return &resources[resource_indices[index]].resource;
+}
+
+static bool claim_execution_state(Resource &resource, D3D12_RESOURCE_STATES state)
+{
+	if (resource.execution_state != D3D12_RESOURCE_STATE_COMMON && resource.execution_state != state)
+	{
+		LOGE("Mismatch in resource state required.\n");
+		return false;
+	}
+
+	resource.execution_state = state;
+	return true;
+}
+
+bool Capture::create_cbv_descriptors(const std::vector<Util::CaptureCBVDesc> &cbvs)
+{
+	auto desc_size = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	for (auto &cbv : cbvs)
+	{
+		auto *resource = get_resource(cbv.resource);
+		if (!resource)
+			return false;
+
+		if (!claim_execution_state(*resource, D3D12_RESOURCE_STATE_GENERIC_READ))
+			return false;
+
+		D3D12_CONSTANT_BUFFER_VIEW_DESC cbv_desc = {};
+		cbv_desc.BufferLocation = resource->gpu_resource->GetGPUVirtualAddress() + cbv.buffer_offset;
+		cbv_desc.SizeInBytes = cbv.size_in_bytes;
+
+		auto handle = resource_heap->GetCPUDescriptorHandleForHeapStart();
+		handle.ptr += uint64_t(cbv.heap_offset) * desc_size;
+		device->CreateConstantBufferView(&cbv_desc, handle);
+		heap_accesses[cbv.heap_offset] = { resource, nullptr, false };
+	}
+
+	return true;
+}
+
+bool Capture::create_srv_descriptors(const std::vector<Util::CaptureSRVDesc> &srvs)
+{
+	auto desc_size = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	for (auto &srv : srvs)
+	{
+		auto *resource = get_resource(srv.resource);
+		if (!resource)
+			return false;
+
+		auto handle = resource_heap->GetCPUDescriptorHandleForHeapStart();
+		handle.ptr += uint64_t(srv.heap_offset) * desc_size;
+
+		if (!claim_execution_state(*resource, D3D12_RESOURCE_STATE_GENERIC_READ))
+			return false;
+
+		device->CreateShaderResourceView(resource->gpu_resource.get(), &srv.desc, handle);
+		heap_accesses[srv.heap_offset] = { resource, nullptr, false };
+	}
+
+	return true;
+}
+
+bool Capture::create_uav_descriptors(const std::vector<Util::CaptureUAVDesc> &uavs)
+{
+	auto desc_size = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	for (auto &uav : uavs)
+	{
+		Resource *resource = get_resource(uav.resource);
+		Resource *counter_resource = nullptr;
+		if (!resource)
+			return false;
+
+		if (uav.counter_resource != Util::CaptureNoResource)
+		{
+			counter_resource = get_resource(uav.counter_resource);
+			if (!counter_resource)
+				return false;
+		}
+
+		auto handle = resource_heap->GetCPUDescriptorHandleForHeapStart();
+		handle.ptr += uint64_t(uav.heap_offset) * desc_size;
+
+		if (!claim_execution_state(*resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS))
+			return false;
+
+		if (counter_resource && !claim_execution_state(*counter_resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS))
+			return false;
+
+		device->CreateUnorderedAccessView(
+				resource->gpu_resource.get(),
+				counter_resource ? counter_resource->gpu_resource.get() : nullptr,
+				&uav.desc, handle);
+		heap_accesses[uav.heap_offset] = { resource, counter_resource, true };
+	}
+
+	return true;
+}
+
+bool Capture::create_sampler_descriptors(const std::vector<Util::CaptureSamplerDesc> &samplers)
+{
+	auto desc_size = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER);
+
+	for (auto &sampler : samplers)
+	{
+		auto handle = sampler_heap->GetCPUDescriptorHandleForHeapStart();
+		handle.ptr += uint64_t(sampler.heap_offset) * desc_size;
+		device->CreateSampler(&sampler.desc, handle);
+	}
+
+	return true;
+}
+
+bool Capture::create_descriptors(const Util::CaptureDesc &desc)
+{
+	return create_srv_descriptors(desc.srvs) &&
+	       create_uav_descriptors(desc.uavs) &&
+	       create_cbv_descriptors(desc.cbvs) &&
+	       create_sampler_descriptors(desc.samplers);
+}
+
+bool Capture::allocate_descriptor_heaps(const Util::CaptureDesc &desc)
+{
+	uint32_t num_resources = 1;
+	uint32_t num_samplers = 1;
+
+	for (auto &srv : desc.srvs)
+		num_resources = std::max<uint32_t>(num_resources, srv.heap_offset + 1);
+	for (auto &cbv : desc.cbvs)
+		num_resources = std::max<uint32_t>(num_resources, cbv.heap_offset + 1);
+	for (auto &uav : desc.uavs)
+		num_resources = std::max<uint32_t>(num_resources, uav.heap_offset + 1);
+	for (auto &sampler : desc.samplers)
+		num_samplers = std::max<uint32_t>(num_samplers, sampler.heap_offset + 1);
+
+	D3D12_DESCRIPTOR_HEAP_DESC heap_desc = {};
+	heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	heap_desc.NumDescriptors = num_resources;
+
+	if (FAILED(device->CreateDescriptorHeap(&heap_desc, IID_ID3D12DescriptorHeap, resource_heap.ppv())))
+		return false;
+
+	heap_accesses.resize(num_resources);
+
+	heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER;
+	heap_desc.NumDescriptors = num_samplers;
+
+	if (FAILED(device->CreateDescriptorHeap(&heap_desc, IID_ID3D12DescriptorHeap, sampler_heap.ppv())))
+		return false;
+
+	return true;
+}
+
+bool Capture::load_capture(const Util::CaptureDesc &desc)
+{
+	std::vector<std::pair<Util::BlobRef, Util::BlobRef>> shader_blobs;
+	for (auto &pass : desc.passes)
+		shader_blobs.emplace_back(pass.cs, pass.root_signature);
+
+	load_timings = {};
+	auto start_time = std::chrono::steady_clock::now();
+
+	// Pipeline compilation only depends on the shader blobs, so it can run alongside everything else.
+	auto pso_task = std::async(std::launch::async, [this, shader_blobs]() {
+		auto pso_start = std::chrono::steady_clock::now();
+
+		// Passes tend to share shaders, compile each combination once and the distinct ones in parallel.
+		std::vector<size_t> unique_index(shader_blobs.size());
+		std::vector<std::future<PipelineState>> tasks;
+		for (size_t i = 0; i < shader_blobs.size(); i++)
+		{
+			auto itr = std::find(shader_blobs.begin(), shader_blobs.begin() + i, shader_blobs[i]);
+			if (itr != shader_blobs.begin() + i)
+			{
+				unique_index[i] = unique_index[itr - shader_blobs.begin()];
+				continue;
+			}
+
+			unique_index[i] = tasks.size();
+			tasks.push_back(std::async(std::launch::async, [this, &shader_blobs, i]() {
+				return create_compute_shader(shader_blobs[i].first, shader_blobs[i].second);
+			}));
+		}
+
+		std::vector<PipelineState> unique_pipes;
+		for (auto &task : tasks)
+		{
+			unique_pipes.push_back(task.get());
+			auto &pipe = unique_pipes.back();
+			if (!pipe.pso)
+				continue;
+
+			if (pipe.shared_hit)
+			{
+				load_timings.pso_shared_count++;
+			}
+			else if (pipe.cache_hit)
+			{
+				load_timings.pso_warm_ms += pipe.create_ms;
+				load_timings.pso_warm_count++;
+			}
+			else
+			{
+				load_timings.pso_cold_ms += pipe.create_ms;
+				load_timings.pso_cold_count++;
+			}
+		}
+
+		std::vector<PipelineState> pipes;
+		for (auto index : unique_index)
+			pipes.push_back(unique_pipes[index]);
+
+		load_timings.pso_ms = elapsed_ms(pso_start);
+		return pipes;
+	});
+
+	auto create_start = std::chrono::steady_clock::now();
+	bool success = create_resources(desc);
+	load_timings.create_ms = elapsed_ms(create_start);
+
+	// Blob contents are only needed by the GPU, descriptors just need the resource objects.
+	std::future<bool> upload_task;
+	if (success)
+		upload_task = std::async(std::launch::async, [this]() { return upload_resources(); });
+
+	auto descriptor_start = std::chrono::steady_clock::now();
+	if (success && !allocate_descriptor_heaps(desc))
+	{
+		LOGE("Failed to allocate descriptor heaps.\n");
+		success = false;
+	}
+
+	if (success && !create_descriptors(desc))
+	{
+		LOGE("Failed to create descriptors.\n");
+		success = false;
+	}
+	load_timings.descriptor_ms = elapsed_ms(descriptor_start);
+
+	if (upload_task.valid() && !upload_task.get())
+		success = false;
+
+	auto pipelines = pso_task.get();
+	for (auto &pipe : pipelines)
+	{
+		if (!pipe.pso)
+		{
+			LOGE("Failed to create CS.\n");
+			success = false;
+			break;
+		}
+	}
+
+	if (!success)
+		return false;
+
+	if (!compile_dispatch_plan(desc))
+	{
+		LOGE("Failed to compile dispatch.\n");
+		return false;
+	}
+
+	for (size_t i = 0; i < pipelines.size(); i++)
+		plan.passes[i].pipeline = std::move(pipelines[i]);
+
+	infer_pass_barriers();
+
+	if (!classify_resources())
+	{
+		LOGE("Failed to classify resources.\n");
+		return false;
+	}
+
+	// Nothing a failed load created is ever shared, so later captures cannot pick up partial uploads.
+	publish_shared_resources();
+
+	log_allocation_stats();
+
+	load_timings.wall_ms = elapsed_ms(start_time);
+
+	// Repacking happens inside the upload stage, so it is already part of upload_ms.
+	double serial_ms = load_timings.pso_ms + load_timings.create_ms + load_timings.upload_ms +
+	                   load_timings.descriptor_ms;
+
+	LOGI("Loading stages: PSO %.3f ms, resource creation %.3f ms, blob upload %.3f ms (repack %.3f ms), "
+	     "descriptors %.3f ms.\n",
+	     load_timings.pso_ms, load_timings.create_ms, load_timings.upload_ms,
+	     load_timings.repack_ms, load_timings.descriptor_ms);
+	LOGI("Loaded in %.3f ms, serial estimate %.3f ms, saved %.3f ms.\n",
+	     load_timings.wall_ms, serial_ms, serial_ms - load_timings.wall_ms);
+	LOGI("PSO creation: %u compiled in %.3f ms, %u from cache in %.3f ms.\n",
+	     load_timings.pso_cold_count, load_timings.pso_cold_ms,
+	     load_timings.pso_warm_count, load_timings.pso_warm_ms);
+
+	if (load_timings.skipped_resource_count)
+	{
+		LOGI("Skipped %u unbound resources, %.3f MiB of GPU memory and %.3f MiB of blob data.\n",
+		     load_timings.skipped_resource_count,
+		     double(load_timings.skipped_resource_bytes) / (1024.0 * 1024.0),
+		     double(load_timings.skipped_blob_bytes) / (1024.0 * 1024.0));
+	}
+
+	if (shared_objects)
+	{
+		LOGI("Reused %u resources (%.3f MiB) and %u PSOs from earlier captures.\n",
+		     load_timings.shared_resource_count, double(load_timings.shared_resource_bytes) / (1024.0 * 1024.0),
+		     load_timings.pso_shared_count);
+
+		if (load_timings.shared_by_location_count)
+		{
+			LOGI("%u read-only resources have data outside a blob store and are only shared with captures "
+			     "reading the same file range. Run --dedup to share them by content.\n",
+			     load_timings.shared_by_location_count);
+		}
+		shared_objects->log_stats();
+	}
+
+	return true;
+}
+
+void Device::wait_idle()
+{
+	queue->Signal(fence.get(), ++latest_fence_value);
+	fence->SetEventOnCompletion(latest_fence_value, nullptr);
+}
+
+void Device::teardown_swapchain()
+{
+	for (auto &img : backbuffers)
+		img = {};
+	swapchain = {};
+	vk_swapchain = {};
+}
+
+std::unique_ptr<Capture> Device::create_capture()
+{
+	std::unique_ptr<Capture> new_capture(new Capture);
+	new_capture->device = device;
+	new_capture->device10 = device10;
+	new_capture->allocation_strategy = allocation_strategy;
+	new_capture->mixed_resource_heaps = mixed_resource_heaps;
+	new_capture->restore_policy = restore_policy;
+	new_capture->blob_reader = blob_reader.get();
+	new_capture->io_gate = io_gate;
+	new_capture->decompress_threads = decompress_threads;
+	new_capture->blob_cache = blob_cache.get();
+	new_capture->shared_objects = shared_objects.get();
+	new_capture->pipeline_cache = pipeline_cache.get();
+	new_capture->init_heaps();
+	return new_capture;
+}
+
+void Device::release_capture()
+{
+	// Lists still in flight may reference anything the capture owns.
+	drain_timestamps();
+
+	// Hand shared resources over in the state this capture left them in.
+	if (capture)
+	{
+		for (auto &resource : capture->resources)
+		{
+			auto &res = resource.resource;
+			if (!res.shared)
+				continue;
+
+			res.shared->state = res.current_state;
+			if (res.shared->uploaded)
+				res.shared->staging_resource = {};
+		}
+	}
+
+	capture.reset();
+	if (shared_objects)
+		shared_objects->trim();
+
+	for (auto &ctx : frame_contexts)
+		ctx.fence_value_for_iteration = 0;
+	for (auto &stats : timing_stats)
+		stats.clear();
+	for (auto &stats : pass_timing_stats)
+		stats.clear();
+	for (auto &stats : baseline_timing_stats)
+		stats.clear();
+	dispatch_sequence = 0;
+}
+
+void Device::set_capture(std::unique_ptr<Capture> new_capture)
+{
+	release_capture();
+	capture = std::move(new_capture);
+
+	if (capture)
+		for (auto &resource : capture->resources)
+			if (resource.resource.shared)
+				resource.resource.current_state = resource.resource.shared->state;
+
+	if (capture && capture->plan.passes.size() > 1)
+		for (auto &stats : pass_timing_stats)
+			stats.resize(capture->plan.passes.size());
+}
+
+void Device::execute_sync_uploads()
+{
+	std::vector<D3D12_RESOURCE_BARRIER> barriers;
+
+	for (auto &resource : capture->resources)
+	{
+		auto &res = resource.resource;
+		if (!res.pending_upload)
+			continue;
+
+		// Resources without a restore copy are uploaded straight into place.
+		auto *dst_resource = res.gpu_staging_resource ? res.gpu_staging_resource.get() : res.gpu_resource.get();
+
+		// Shared resources are uploaded by whichever capture replays first.
+		auto *staging_resource = res.staging_resource.get();
+		if (res.shared)
+			staging_resource = res.shared->uploaded ? nullptr : res.shared->staging_resource.get();
+
+		if (!staging_resource)
+		{
+			// Nothing to upload, only the transition.
+		}
+		else if (res.placed_footprints.empty())
+		{
+			list->CopyResource(dst_resource, staging_resource);
+		}
+		else
+		{
+			for (size_t i = 0, n = res.placed_footprints.size(); i < n; i++)
+			{
+				D3D12_TEXTURE_COPY_LOCATION dst = {}, src = {};
+				dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+				src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+				dst.pResource = dst_resource;
+				src.pResource = staging_resource;
+				dst.SubresourceIndex = i;
+				src.PlacedFootprint = res.placed_footprints[i];
+				list->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+			}
+		}
+
+		if (res.shared)
+			res.shared->uploaded = true;
+
+		// Shared resources may have been left in another state by an earlier capture.
+		D3D12_RESOURCE_BARRIER barrier = {};
+		barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+		barrier.Transition.pResource = dst_resource;
+		barrier.Transition.StateBefore = res.gpu_staging_resource ? D3D12_RESOURCE_STATE_COPY_DEST : res.current_state;
+		barrier.Transition.Subresource = UINT32_MAX;
+
+		if (res.gpu_staging_resource)
+		{
+			barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
+			barriers.push_back(barrier);
+		}
+		else if (res.execution_state != res.current_state)
+		{
+			barrier.Transition.StateAfter = res.execution_state;
+			res.current_state = res.execution_state;
+			barriers.push_back(barrier);
+		}
+
+		res.pending_upload = false;
+	}
+
+	if (!barriers.empty())
+		list->ResourceBarrier(barriers.size(), barriers.data());
+}
+
+void Device::record_restore_copy(Resource &res)
+{
+	if (res.gpu_staging_resource)
+	{
+		list->CopyResource(res.gpu_resource.get(), res.gpu_staging_resource.get());
+	}
+	else if (res.placed_footprints.empty())
+	{
+		list->CopyBufferRegion(res.gpu_resource.get(), 0, capture->zero_buffer.get(), 0, res.desc.Width);
+	}
+	else
+	{
+		for (size_t i = 0, n = res.placed_footprints.size(); i < n; i++)
+		{
+			D3D12_TEXTURE_COPY_LOCATION dst = {}, src = {};
+			dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+			src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+			dst.pResource = res.gpu_resource.get();
+			src.pResource = capture->zero_buffer.get();
+			dst.SubresourceIndex = i;
+			src.PlacedFootprint = res.placed_footprints[i];
+			list->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+		}
+	}
+}
+
+void Device::execute_sync_dirty()
+{
+	std::vector<D3D12_RESOURCE_BARRIER> barriers;
+
+	for (auto &resource : capture->resources)
+	{
+		if (!resource.resource.dirty)
+			continue;
+
+		if (resource.resource.current_state != D3D12_RESOURCE_STATE_COPY_DEST)
+		{
+			D3D12_RESOURCE_BARRIER barrier = {};
+			barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+			barrier.Transition.pResource = resource.resource.gpu_resource.get();
+			barrier.Transition.StateBefore = resource.resource.current_state;
+			barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
+			barrier.Transition.Subresource = UINT32_MAX;
+			resource.resource.current_state = D3D12_RESOURCE_STATE_COPY_DEST;
+			barriers.push_back(barrier);
+		}
+	}
+
+	if (!barriers.empty())
+		list->ResourceBarrier(barriers.size(), barriers.data());
+
+	barriers.clear();
+
+	for (auto &resource : capture->resources)
+	{
+		if (!resource.resource.dirty)
+			continue;
+
+		if (resource.resource.current_state != resource.resource.execution_state)
+		{
+			D3D12_RESOURCE_BARRIER barrier = {};
+			barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+			barrier.Transition.pResource = resource.resource.gpu_resource.get();
+			barrier.Transition.StateBefore = resource.resource.current_state;
+			barrier.Transition.StateAfter = resource.resource.execution_state;
+			barrier.Transition.Subresource = UINT32_MAX;
+			resource.resource.current_state = resource.resource.execution_state;
+			barriers.push_back(barrier);
+		}
+
+		record_restore_copy(resource.resource);
+		resource.resource.dirty = false;
+	}
+
+	if (!barriers.empty())
+		list->ResourceBarrier(barriers.size(), barriers.data());
+}
+
+bool Capture::compile_dispatch_plan(const Util::CaptureDesc &desc)
+{
+	plan = {};
+	plan.passes.resize(desc.passes.size());
+
+	for (size_t i = 0; i < desc.passes.size(); i++)
+	{
+		auto &pass = plan.passes[i];
+		pass.name = desc.passes[i].name;
+
+		if (!compile_dispatch_pass(desc.passes[i], pass))
+		{
+			LOGE("Failed to compile dispatch \"%s\".\n", pass.name.c_str());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool Capture::compile_dispatch_pass(const Util::CapturePassDesc &pass_desc, DispatchPass &pass)
+{
+	memcpy(pass.dimensions, pass_desc.dimensions, sizeof(pass.dimensions));
+	pass.constants = pass_desc.constants;
+
+	auto resource_desc_size = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	auto sampler_desc_size = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER);
+
+	for (auto &param : pass_desc.parameters)
+	{
+		RootBinding binding = {};
+		binding.index = param.index;
+
+		if (param.type == Util::CaptureRootParameterType::ResourceTable)
+		{
+			binding.type = RootBinding::Type::ResourceTable;
+			binding.address = resource_heap->GetGPUDescriptorHandleForHeapStart().ptr + param.offset * resource_desc_size;
+			binding.heap_offset = uint32_t(param.offset);
+		}
+		else if (param.type == Util::CaptureRootParameterType::SamplerTable)
+		{
+			binding.type = RootBinding::Type::SamplerTable;
+			binding.address = sampler_heap->GetGPUDescriptorHandleForHeapStart().ptr + param.offset * sampler_desc_size;
+		}
+		else if (param.type == Util::CaptureRootParameterType::Constant)
+		{
+			if (param.constant_offset > pass.constants.size() ||
+			    param.constant_count > pass.constants.size() - param.constant_offset)
+			{
+				LOGE("Root constants are out of range.\n");
+				return false;
+			}
+
+			binding.type = RootBinding::Type::Constant;
+			binding.constant_offset = param.constant_offset;
+			binding.constant_count = param.constant_count;
+		}
+		else
+		{
+			auto *resource = get_resource(param.resource);
+			if (!resource)
+				return false;
+
+			D3D12_GPU_VIRTUAL_ADDRESS va = resource->gpu_resource->GetGPUVirtualAddress();
+			if (!va)
+				return false;
+
+			binding.address = va + param.offset;
+			binding.resource = resource;
+
+			D3D12_RESOURCE_STATES state;
+			if (param.type == Util::CaptureRootParameterType::SRV)
+			{
+				binding.type = RootBinding::Type::SRV;
+				state = D3D12_RESOURCE_STATE_GENERIC_READ;
+			}
+			else if (param.type == Util::CaptureRootParameterType::UAV)
+			{
+				binding.type = RootBinding::Type::UAV;
+				state = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+			}
+			else if (param.type == Util::CaptureRootParameterType::CBV)
+			{
+				binding.type = RootBinding::Type::CBV;
+				state = D3D12_RESOURCE_STATE_GENERIC_READ;
+			}
+			else
+			{
+				LOGE("Invalid root parameter type %u.\n", unsigned(param.type));
+				return false;
+			}
+
+			if (!claim_execution_state(*resource, state))
+				return false;
+		}
+
+		pass.bindings.push_back(binding);
+	}
+
+	return true;
+}
+
+void Capture::collect_pass_accesses(DispatchPass &pass) const
+{
+	auto add_descriptor = [&](uint32_t slot) {
+		auto &access = heap_accesses[slot];
+		if (access.resource)
+			(access.write ? pass.writes : pass.reads).push_back(access.resource);
+		if (access.counter_resource)
+			pass.writes.push_back(access.counter_resource);
+	};
+
+	auto num_slots = uint32_t(heap_accesses.size());
+
+	for (auto &binding : pass.bindings)
+	{
+		switch (binding.type)
+		{
+		case RootBinding::Type::SRV:
+		case RootBinding::Type::CBV:
+			pass.reads.push_back(binding.resource);
+			break;
+
+		case RootBinding::Type::UAV:
+			pass.writes.push_back(binding.resource);
+			break;
+
+		case RootBinding::Type::ResourceTable:
+		{
+			auto &layout = pass.pipeline.layout;
+			if (!pass.pipeline.has_layout || binding.index >= layout.parameters.size())
+			{
+				for (uint32_t slot = binding.heap_offset; slot < num_slots; slot++)
+					add_descriptor(slot);
+				break;
+			}
+
+			for (auto &range : layout.parameters[binding.index].ranges)
+			{
+				if (range.type == Util::RootDescriptorRange::Type::Sampler)
+					continue;
+
+				uint64_t begin = uint64_t(binding.heap_offset) + range.offset;
+				uint64_t end = range.num_descriptors == Util::RootDescriptorRange::Unbounded ?
+				               num_slots : std::min<uint64_t>(begin + range.num_descriptors, num_slots);
+				for (uint64_t slot = begin; slot < end; slot++)
+					add_descriptor(uint32_t(slot));
+			}
+			break;
+		}
+
+		default:
+			break;
+		}
+	}
+
+	for (auto *accesses : { &pass.reads, &pass.writes })
+	{
+		std::sort(accesses->begin(), accesses->end());
+		accesses->erase(std::unique(accesses->begin(), accesses->end()), accesses->end());
+	}
+}
+
+void Capture::infer_pass_barriers()
+{
+	// Resources accessed since their last barrier.
+	std::unordered_set<Resource *> pending_reads, pending_writes;
+	uint32_t num_barriers = 0, num_free_boundaries = 0;
+
+	for (size_t i = 0; i < plan.passes.size(); i++)
+	{
+		auto &pass = plan.passes[i];
+		collect_pass_accesses(pass);
+
+		std::vector<Resource *> hazards;
+		for (auto *resource : pass.reads)
+			if (pending_writes.count(resource))
+				hazards.push_back(resource);
+		for (auto *resource : pass.writes)
+			if (pending_writes.count(resource) || pending_reads.count(resource))
+				hazards.push_back(resource);
+
+		std::sort(hazards.begin(), hazards.end());
+		hazards.erase(std::unique(hazards.begin(), hazards.end()), hazards.end());
+
+		// Every resource that can be written lives in UNORDERED_ACCESS for the whole replay,
+		// so a UAV barrier covers RAW, WAW and WAR alike and no transitions are ever needed.
+		for (auto *resource : hazards)
+		{
+			D3D12_RESOURCE_BARRIER barrier = {};
+			barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+			barrier.UAV.pResource = resource->gpu_resource.get();
+			pass.barriers.push_back(barrier);
+
+			pending_reads.erase(resource);
+			pending_writes.erase(resource);
+		}
+
+		pending_reads.insert(pass.reads.begin(), pass.reads.end());
+		pending_writes.insert(pass.writes.begin(), pass.writes.end());
+
+		if (i != 0)
+		{
+			num_barriers += uint32_t(pass.barriers.size());
+			if (pass.barriers.empty())
+				num_free_boundaries++;
+		}
+	}
+
+	if (plan.passes.size() > 1)
+	{
+		LOGI("Inferred %u per-resource barriers between %zu passes, %u of %zu pass boundaries are hazard free.\n",
+		     num_barriers, plan.passes.size(), num_free_boundaries, plan.passes.size() - 1);
+	}
+}
+
+bool Capture::classify_resources()
+{
+	uint64_t zero_size = 0;
+	uint64_t restore_bytes = 0;
+	uint32_t num_restored = 0, num_cleared = 0, num_read_only = 0, num_overrides = 0;
+
+	for (auto &resource : resources)
+	{
+		auto &res = resource.resource;
+		res.writable = res.execution_state == D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+
+		// Every resource needs at least the transition out of COPY_DEST.
+		res.pending_upload = true;
+
+		if (!res.writable)
+		{
+			num_read_only++;
+			continue;
+		}
+
+		if (res.restore == RestorePolicy::Default)
+			res.restore = restore_policy;
+		else if (res.restore != restore_policy)
+			num_overrides++;
+
+		// Contents are left as they happen to be in memory.
+		if (res.restore == RestorePolicy::Never)
+		{
+			res.staging_resource = {};
+			res.castable_formats.clear();
+			continue;
+		}
+
+		if (res.restore == RestorePolicy::PerDispatch)
+			plan.restore_per_dispatch.push_back(&res);
+		else if (res.restore == RestorePolicy::PerList)
+			plan.restore_per_list.push_back(&res);
+
+		// Initial contents are uploaded straight into place when they never need restoring.
+		if (res.has_data && res.restore == RestorePolicy::InitialOnly)
+		{
+			res.castable_formats.clear();
+			continue;
+		}
+
+		if (res.has_data)
+		{
+			D3D12_HEAP_PROPERTIES heap_props = {};
+			heap_props.Type = D3D12_HEAP_TYPE_DEFAULT;
+
+			auto barrier_layout =
+					res.desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER ?
+					D3D12_BARRIER_LAYOUT_UNDEFINED : D3D12_BARRIER_LAYOUT_COMMON;
+
+			if (!create_replay_resource(heap_props, res.desc, barrier_layout,
+			                            res.castable_formats, res.gpu_staging_resource))
+				return false;
+
+			restore_bytes += res.upload_size;
+			num_restored++;
+		}
+		else
+		{
+			zero_size = std::max<uint64_t>(zero_size, res.upload_size);
+			num_cleared++;
+		}
+
+		res.castable_formats.clear();
+		res.dirty = true;
+	}
+
+	if (zero_size)
+	{
+		D3D12_HEAP_PROPERTIES heap_props = {};
+		heap_props.Type = D3D12_HEAP_TYPE_DEFAULT;
+
+		D3D12_RESOURCE_DESC desc = {};
+		desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		desc.Width = zero_size;
+		desc.Height = 1;
+		desc.DepthOrArraySize = 1;
+		desc.MipLevels = 1;
+		desc.SampleDesc.Count = 1;
+		desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+		// Committed resources are zero-initialized.
+		if (FAILED(device->CreateCommittedResource(
+				&heap_props, D3D12_HEAP_FLAG_NONE,
+				&desc, D3D12_RESOURCE_STATE_COPY_SOURCE,
+				nullptr, IID_ID3D12Resource, zero_buffer.ppv())))
+		{
+			LOGE("Failed to create zero buffer.\n");
+			return false;
+		}
+	}
+
+	LOGI("Resources: %u read-only, %u writable with restore copy (%.3f MiB), "
+	     "%u writable cleared from %.3f MiB zero buffer.\n",
+	     num_read_only, num_restored, double(restore_bytes) / (1024.0 * 1024.0),
+	     num_cleared, double(zero_size) / (1024.0 * 1024.0));
+	LOGI("Restore policy: %s, %u per-resource overrides.\n",
+	     restore_policy_to_string(restore_policy), num_overrides);
+
+	return true;
+}
+
+void Device::execute_dispatch(uint32_t iteration)
+{
+	auto &ctx = frame_contexts[frame_index];
+	auto &plan = capture->plan;
+	uint32_t query_base = iteration * ctx.timestamps_per_dispatch;
+	bool full_barriers = uses_full_barriers(dispatch_sequence + iteration);
+
+	D3D12_RESOURCE_BARRIER uav_barrier = {};
+	uav_barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+
+	for (uint32_t pass_index = 0; pass_index < uint32_t(plan.passes.size()); pass_index++)
+	{
+		auto &pass = plan.passes[pass_index];
+
+		// Later passes consume what earlier ones wrote, like in the frame the capture came from.
+		if (pass_index && full_barriers)
+			list->ResourceBarrier(1, &uav_barrier);
+		else if (pass_index && !pass.barriers.empty())
+			list->ResourceBarrier(uint32_t(pass.barriers.size()), pass.barriers.data());
+
+		list->SetComputeRootSignature(pass.pipeline.root_signature.get());
+		list->SetPipelineState(pass.pipeline.pso.get());
+
+		for (auto &binding : pass.bindings)
+		{
+			switch (binding.type)
+			{
+			case RootBinding::Type::ResourceTable:
+			case RootBinding::Type::SamplerTable:
+				list->SetComputeRootDescriptorTable(binding.index, { binding.address });
+				break;
+
+			case RootBinding::Type::Constant:
+				list->SetComputeRoot32BitConstants(binding.index, binding.constant_count,
+				                                   pass.constants.data() + binding.constant_offset, 0);
+				break;
+
+			case RootBinding::Type::SRV:
+				list->SetComputeRootShaderResourceView(binding.index, binding.address);
+				break;
+
+			case RootBinding::Type::UAV:
+				list->SetComputeRootUnorderedAccessView(binding.index, binding.address);
+				break;
+
+			case RootBinding::Type::CBV:
+				list->SetComputeRootConstantBufferView(binding.index, binding.address);
+				break;
+			}
+		}
+
+		if (pass_index == 0)
+			list->EndQuery(ctx.timestamps.get(), D3D12_QUERY_TYPE_TIMESTAMP, query_base);
+		list->Dispatch(pass.dimensions[0], pass.dimensions[1], pass.dimensions[2]);
+		list->EndQuery(ctx.timestamps.get(), D3D12_QUERY_TYPE_TIMESTAMP, query_base + pass_index + 1);
+	}
+
+	for (auto *resource : plan.restore_per_dispatch)
+		resource->dirty = true;
+
+	list->ResourceBarrier(1, &uav_barrier);
+}
+
+bool Device::init_cache_flush(uint64_t size)
+{
+	if (cache_mode == CacheMode::Warm)
+		return true;
+
+	D3D12_HEAP_PROPERTIES heap_props = {};
+	heap_props.Type = D3D12_HEAP_TYPE_DEFAULT;
+
+	D3D12_RESOURCE_DESC desc = {};
+	desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+	desc.Width = size / 2;
+	desc.Height = 1;
+	desc.DepthOrArraySize = 1;
+	desc.MipLevels = 1;
+	desc.SampleDesc.Count = 1;
+	desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+	// Source and destination stay in their copy states for the lifetime of the device.
+	if (FAILED(device->CreateCommittedResource(
+			&heap_props, D3D12_HEAP_FLAG_NONE, &desc, D3D12_RESOURCE_STATE_COPY_SOURCE,
+			nullptr, IID_ID3D12Resource, flush_src.ppv())) ||
+	    FAILED(device->CreateCommittedResource(
+			&heap_props, D3D12_HEAP_FLAG_NONE, &desc, D3D12_RESOURCE_STATE_COPY_DEST,
+			nullptr, IID_ID3D12Resource, flush_dst.ppv())))
+	{
+		LOGE("Failed to create cache flush buffers.\n");
+		return false;
+	}
+
+	LOGI("Flushing caches with a %.3f MiB copy before cold dispatches.\n",
+	     double(size) / (1024.0 * 1024.0));
+	return true;
+}
+
+bool Device::is_cold_dispatch(uint64_t sequence) const
+{
+	switch (cache_mode)
+	{
+	case CacheMode::Cold:
+		return true;
+	case CacheMode::Both:
+		return (sequence & 1) != 0;
+	default:
+		return false;
+	}
+}
+
+bool Device::uses_full_barriers(uint64_t sequence) const
+{
+	switch (barrier_mode)
+	{
+	case BarrierMode::Inferred:
+		return false;
+	case BarrierMode::Compare:
+		// Both cache states see both barrier modes when they alternate as well.
+		return ((cache_mode == CacheMode::Both ? sequence >> 1 : sequence) & 1) != 0;
+	default:
+		return true;
+	}
+}
+
+void Device::execute_cache_flush()
+{
+	list->CopyBufferRegion(flush_dst.get(), 0, flush_src.get(), 0, flush_dst->GetDesc().Width);
+
+	// The copy must have drained before the dispatch timestamp is written.
+	D3D12_RESOURCE_BARRIER barrier = {};
+	barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
+	list->ResourceBarrier(1, &barrier);
+}
+
+bool Device::calibrate_timestamp_overhead()
+{
+	constexpr uint32_t NumPairs = 256;
+
+	ComPtr<ID3D12QueryHeap> query_heap;
+	ComPtr<ID3D12Resource> readback;
+
+	D3D12_QUERY_HEAP_DESC query_heap_desc = {};
+	query_heap_desc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	query_heap_desc.Count = NumPairs * 2;
+	if (FAILED(device->CreateQueryHeap(&query_heap_desc, IID_ID3D12QueryHeap, query_heap.ppv())))
+		return false;
+
+	D3D12_HEAP_PROPERTIES heap_props = {};
+	heap_props.Type = D3D12_HEAP_TYPE_READBACK;
+
+	D3D12_RESOURCE_DESC desc = {};
+	desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+	desc.Width = NumPairs * 2 * sizeof(uint64_t);
+	desc.Height = 1;
+	desc.DepthOrArraySize = 1;
+	desc.MipLevels = 1;
+	desc.SampleDesc.Count = 1;
+	desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+	if (FAILED(device->CreateCommittedResource(
+			&heap_props, D3D12_HEAP_FLAG_NONE,
+			&desc, D3D12_RESOURCE_STATE_COPY_DEST,
+			nullptr, IID_ID3D12Resource, readback.ppv())))
+	{
+		return false;
+	}
+
+	if (FAILED(list->Reset(frame_contexts[0].allocator.get(), nullptr)))
+		return false;
+
+	for (uint32_t i = 0; i < NumPairs; i++)
+	{
+		list->EndQuery(query_heap.get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * i + 0);
+		list->EndQuery(query_heap.get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * i + 1);
+	}
+
+	list->ResolveQueryData(query_heap.get(), D3D12_QUERY_TYPE_TIMESTAMP, 0, NumPairs * 2, readback.get(), 0);
+
+	if (FAILED(list->Close()))
+		return false;
+
+	ID3D12CommandList *lists[] = { list.get() };
+	queue->ExecuteCommandLists(1, lists);
+	wait_idle();
+
+	const uint64_t *tses = nullptr;
+	if (FAILED(readback->Map(0, nullptr, (void **)&tses)))
+		return false;
+
+	Util::TimingStats stats;
+	for (uint32_t i = 0; i < NumPairs; i++)
+		stats.add(tses[2 * i + 1] - tses[2 * i + 0]);
+	readback->Unmap(0, nullptr);
+
+	timestamp_overhead = uint64_t(stats.summarize(false).p50);
+	return true;
+}
+
+void Device::read_timestamps(uint32_t context_index)
+{
+	auto &ctx = frame_contexts[context_index];
+	if (!ctx.pending_timestamps)
+		return;
+
+	const uint64_t *tses = nullptr;
+	if (ctx.collect_timings && SUCCEEDED(ctx.timestamp_readback->Map(0, nullptr, (void **)&tses)))
+	{
+		auto delta = [this](uint64_t begin, uint64_t end) {
+			return end - begin > timestamp_overhead ? end - begin - timestamp_overhead : 0;
+		};
+
+		uint32_t stride = ctx.timestamps_per_dispatch;
+		for (uint32_t i = 0; i < ctx.pending_timestamps; i++)
+		{
+			auto *ts = tses + i * stride;
+			uint64_t sequence = ctx.first_dispatch_sequence + i;
+			int state = is_cold_dispatch(sequence) ? TimingCold : TimingWarm;
+
+			if (barrier_mode == BarrierMode::Compare && uses_full_barriers(sequence))
+			{
+				baseline_timing_stats[state].add(delta(ts[0], ts[stride - 1]));
+				continue;
+			}
+
+			timing_stats[state].add(delta(ts[0], ts[stride - 1]));
+
+			auto &pass_stats = pass_timing_stats[state];
+			for (uint32_t pass = 0; pass < uint32_t(pass_stats.size()) && pass + 1 < stride; pass++)
+				pass_stats[pass].add(delta(ts[pass], ts[pass + 1]));
+		}
+		ctx.timestamp_readback->Unmap(0, nullptr);
+	}
+
+	ctx.pending_timestamps = 0;
+}
+
+void Device::drain_timestamps()
+{
+	wait_idle();
+
+	// Oldest submission first, to keep samples in submission order.
+	for (uint32_t i = 0; i < NumFrameContexts; i++)
+		read_timestamps((frame_index + i) % NumFrameContexts);
+}
+
+bool Device::execute_iteration(uint32_t dispatches_per_list)
+{
+	auto &ctx = frame_contexts[frame_index];
+	if (ctx.fence_value_for_iteration != 0)
+	{
+		if (FAILED(fence->SetEventOnCompletion(ctx.fence_value_for_iteration, nullptr)))
+			return false;
+
+		// No need for the CPU copy now.
+		for (auto &resource : capture->resources)
+			resource.resource.staging_resource = {};
+		capture->upload_heaps.reset();
+	}
+
+	read_timestamps(frame_index);
+
+	// One timestamp ahead of the first pass and one after each pass.
+	uint32_t num_timestamps = dispatches_per_list * uint32_t(capture->plan.passes.size() + 1);
+
+	ctx.pending_timestamps = dispatches_per_list;
+	ctx.timestamps_per_dispatch = uint32_t(capture->plan.passes.size() + 1);
+	ctx.first_dispatch_sequence = dispatch_sequence;
+	ctx.collect_timings = collect_timings;
+
+	if (!ctx.timestamps || ctx.timestamp_readback->GetDesc().Width < num_timestamps * sizeof(uint64_t))
+	{
+		D3D12_QUERY_HEAP_DESC query_heap = {};
+		query_heap.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+		query_heap.Count = num_timestamps;
+		if (FAILED(device->CreateQueryHeap(&query_heap, IID_ID3D12QueryHeap, ctx.timestamps.ppv())))
+			return false;
+
+		D3D12_HEAP_PROPERTIES heap_props = {};
+		heap_props.Type = D3D12_HEAP_TYPE_READBACK;
+
+		D3D12_RESOURCE_DESC res = {};
+		res.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		res.Width = num_timestamps * sizeof(uint64_t);
+		res.Height = 1;
+		res.DepthOrArraySize = 1;
+		res.MipLevels = 1;
+		res.SampleDesc.Count = 1;
+		res.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+		if (FAILED(device->CreateCommittedResource(
+				&heap_props, D3D12_HEAP_FLAG_NONE,
+				&res, D3D12_RESOURCE_STATE_COPY_DEST,
+				nullptr, IID_ID3D12Resource, ctx.timestamp_readback.ppv())))
+		{
+			return false;
+		}
+	}
+
+	if (FAILED(list->Reset(ctx.allocator.get(), nullptr)))
+		return false;
+
+	// Split submissions to allow better preemption while grinding the GPU.
+	ID3D12DescriptorHeap *heaps[] = { capture->resource_heap.get(), capture->sampler_heap.get() };
+	list->SetDescriptorHeaps(2, heaps);
+
+	for (auto *resource : capture->plan.restore_per_list)
+		resource->dirty = true;
 
 	for (uint32_t i = 0; i < dispatches_per_list; i++)
 	{
-		execute_sync_dirty_gpu_staging();
-		execute_sync_dirty();
-		if (!execute_dispatch(doc, i))
-			return false;
+		execute_sync_uploads();
+		execute_sync_dirty();
+		if (is_cold_dispatch(dispatch_sequence + i))
+			execute_cache_flush();
+		execute_dispatch(i);
+	}
+	dispatch_sequence += dispatches_per_list;
+
+	list->ResolveQueryData(ctx.timestamps.get(), D3D12_QUERY_TYPE_TIMESTAMP,
+	                       0, num_timestamps,
+	                       ctx.timestamp_readback.get(), 0);
+
+	if (rtv)
+	{
+		// Just clear something so it looks like it's working.
+		D3D12_CPU_DESCRIPTOR_HANDLE h = rtv->GetCPUDescriptorHandleForHeapStart();
+		size_t index = 0;
+
+		if (vk_swapchain)
+			index = vk_swapchain->GetImageIndex();
+		else if (swapchain)
+			index = swapchain->GetCurrentBackBufferIndex();
+
+		h.ptr += index * device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+
+		D3D12_RESOURCE_BARRIER barrier = {};
+		barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+		barrier.Transition.pResource = backbuffers[index].get();
+		barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_PRESENT;
+		barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_RENDER_TARGET;
+
+		const FLOAT color[] = { 0.1f, 0.2f, 0.3f };
+
+		list->ResourceBarrier(1, &barrier);
+		list->ClearRenderTargetView(h, color, 0, nullptr);
+
+		barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_RENDER_TARGET;
+		barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PRESENT;
+		list->ResourceBarrier(1, &barrier);
+	}
+
+	if (FAILED(list->Close()))
+		return false;
+
+	ID3D12CommandList *lists[] = { list.get() };
+	queue->ExecuteCommandLists(1, lists);
+
+	if (vk_swapchain)
+	{
+		if (FAILED(vk_swapchain->Present(0, 0, nullptr)))
+			return false;
+	}
+	else if (swapchain)
+	{
+		if (FAILED(swapchain->Present(0, 0)))
+			return false;
+	}
+
+	queue->Signal(fence.get(), ++latest_fence_value);
+	ctx.fence_value_for_iteration = latest_fence_value;
+	frame_index = (frame_index + 1) % NumFrameContexts;
+	return true;
+}
+
+static Device create_device(const std::string &path, bool validate, bool vkd3d_proton)
+{
+	Device device;
+
+#ifndef VKD3D_PROTON_SYSTEM
+	void *module = dlopen(path.c_str(), RTLD_NOW);
+	if (!module)
+	{
+		LOGE("Failed to load vkd3d-proton.\n");
+		return {};
+	}
+
+	// For convenience on Windows build, we just load d3d12core.dll directly and extract the private APIs.
+	if (vkd3d_proton)
+	{
+		auto get_interface = (PFN_D3D12_GET_INTERFACE) dlsym(module, "D3D12GetInterface");
+		if (!get_interface)
+			return {};
+
+		IVKD3DCoreInterface *iface;
+		if (FAILED(get_interface(CLSID_VKD3DCore, IID_IVKD3DCoreInterface, (void **)&iface)))
+		{
+			LOGE("%s does not look like a vkd3d-proton d3d12core.dll.\n", path.c_str());
+			return {};
+		}
+
+		if (FAILED(iface->CreateDevice(nullptr, D3D_FEATURE_LEVEL_12_0, IID_ID3D12Device, device.device.ppv())))
+		{
+			fprintf(stderr, "Failed to create device.\n");
+			return {};
+		}
+	}
+	else
+	{
+		if (validate)
+		{
+			auto get_debug_iface = (PFN_D3D12_GET_DEBUG_INTERFACE) dlsym(module, "D3D12GetDebugInterface");
+			ComPtr<ID3D12Debug> debug;
+			if (SUCCEEDED(get_debug_iface(IID_ID3D12Debug, debug.ppv())))
+			{
+				LOGI("Enabling validation.\n");
+				debug->EnableDebugLayer();
+			}
+		}
+
+		auto create = (PFN_D3D12_CREATE_DEVICE) dlsym(module, "D3D12CreateDevice");
+		if (!create)
+		{
+			LOGE("Failed to query symbol.\n");
+			return {};
+		}
+
+		if (FAILED(create(nullptr, D3D_FEATURE_LEVEL_12_0, IID_ID3D12Device, device.device.ppv())))
+		{
+			fprintf(stderr, "Failed to create device.\n");
+			return {};
+		}
+	}
+#else
+	(void)path;
+	(void)validate;
+	if (FAILED(D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_12_0, IID_ID3D12Device, device.device.ppv())))
+	{
+		fprintf(stderr, "Failed to create device.\n");
+		return {};
+	}
+#endif
+
+	auto *dev = device.device.get();
+
+	if (FAILED(dev->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_ID3D12Fence, device.fence.ppv())))
+		return {};
+
+	D3D12_COMMAND_QUEUE_DESC desc = {};
+	desc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
+	if (FAILED(dev->CreateCommandQueue(&desc, IID_ID3D12CommandQueue, device.queue.ppv())))
+		return {};
+
+	for (auto &ctx : device.frame_contexts)
+		if (FAILED(dev->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_ID3D12CommandAllocator, ctx.allocator.ppv())))
+			return {};
+
+	if (FAILED(dev->CreateCommandList(
+			0, D3D12_COMMAND_LIST_TYPE_DIRECT, device.frame_contexts[0].allocator.get(),
+			nullptr, IID_ID3D12CommandList, device.list.ppv())))
+	{
+		return {};
+	}
+
+	device.list->Close();
+
+	return device;
+}
+
+bool Device::init_swapchain(SDL_Window *window)
+{
+	struct SurfaceFactory : IDXGIVkSurfaceFactory
+	{
+		// Unused
+		HRESULT QueryInterface(const IID &, void **) override { return E_NOINTERFACE; }
+		ULONG AddRef() override { return 0; }
+		ULONG Release() override { return 0; }
+
+		VkResult CreateSurface(VkInstance instance, VkPhysicalDevice, VkSurfaceKHR *pSurface) override
+		{
+#ifdef _WIN32
+			void *module = dlopen("vulkan-1.dll", RTLD_NOW);
+#else
+			void *module = dlopen("libvulkan.so.1", RTLD_NOW);
+#endif
+
+			if (!module)
+				return VK_ERROR_INCOMPATIBLE_DRIVER;
+
+			auto gipa = (PFN_vkGetInstanceProcAddr)dlsym(module, "vkGetInstanceProcAddr");
+			if (!gipa)
+				return VK_ERROR_INCOMPATIBLE_DRIVER;
+
+			SDL_PropertiesID props = SDL_GetWindowProperties(window);
+			SDL_LockProperties(props);
+
+			VkResult vr = VK_ERROR_INCOMPATIBLE_DRIVER;
+
+#ifdef _WIN32
+			auto win32_create = (PFN_vkCreateWin32SurfaceKHR)gipa(instance, "vkCreateWin32SurfaceKHR");
+			auto hwnd = static_cast<HWND>(SDL_GetPointerProperty(props, SDL_PROP_WINDOW_WIN32_HWND_POINTER, nullptr));
+			auto hinstance = static_cast<HINSTANCE>(SDL_GetPointerProperty(props, SDL_PROP_WINDOW_WIN32_INSTANCE_POINTER, nullptr));
+
+			if (hwnd && win32_create)
+			{
+				VkWin32SurfaceCreateInfoKHR win32_info = { VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR };
+				win32_info.hwnd = hwnd;
+				win32_info.hinstance = hinstance;
+				vr = win32_create(instance, &win32_info, nullptr, pSurface);
+			}
+#else
+			auto x11_win = static_cast<Window>(SDL_GetNumberProperty(props, SDL_PROP_WINDOW_X11_WINDOW_NUMBER, 0));
+			auto x11_dpy = static_cast<Display *>(SDL_GetPointerProperty(props, SDL_PROP_WINDOW_X11_DISPLAY_POINTER, nullptr));
+			auto wl_dpy = static_cast<wl_display *>(SDL_GetPointerProperty(props, SDL_PROP_WINDOW_WAYLAND_DISPLAY_POINTER, nullptr));
+			auto wl_surf = static_cast<wl_surface *>(SDL_GetPointerProperty(props, SDL_PROP_WINDOW_WAYLAND_SURFACE_POINTER, nullptr));
+
+			auto x11_create = (PFN_vkCreateXlibSurfaceKHR)gipa(instance, "vkCreateXlibSurfaceKHR");
+			auto wl_create = (PFN_vkCreateWaylandSurfaceKHR)gipa(instance, "vkCreateWaylandSurfaceKHR");
+
+			if (x11_create && x11_dpy)
+			{
+				VkXlibSurfaceCreateInfoKHR xlib_info = { VK_STRUCTURE_TYPE_XLIB_SURFACE_CREATE_INFO_KHR };
+				xlib_info.dpy = x11_dpy;
+				xlib_info.window = x11_win;
+				vr = x11_create(instance, &xlib_info, nullptr, pSurface);
+			}
+			else if (wl_create && wl_dpy && wl_surf)
+			{
+				VkWaylandSurfaceCreateInfoKHR wl_info = { VK_STRUCTURE_TYPE_WAYLAND_SURFACE_CREATE_INFO_KHR };
+				wl_info.display = wl_dpy;
+				wl_info.surface = wl_surf;
+				vr = wl_create(instance, &wl_info, nullptr, pSurface);
+			}
+#endif
+
+			SDL_UnlockProperties(props);
+			return vr;
+		}
+
+		ID3D12Device *device = nullptr;
+		SDL_Window *window = nullptr;
+	} surface_factory;
+
+	surface_factory.device = device.get();
+	surface_factory.window = window;
+
+	DXGI_SWAP_CHAIN_DESC1 desc = {};
+	desc.Width = 512;
+	desc.Height = 512;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.BufferCount = 2;
+	desc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+	desc.SampleDesc.Count = 1;
+	desc.BufferCount = 2;
+	desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+	desc.SampleDesc.Count = 1;
+	desc.Scaling = DXGI_SCALING_STRETCH;
+	desc.AlphaMode = DXGI_ALPHA_MODE_IGNORE;
+
+	ComPtr<IDXGIVkSwapChainFactory> swapchain_factory;
+	if (SUCCEEDED(queue->QueryInterface(IID_IDXGIVkSwapChainFactory, swapchain_factory.ppv())))
+	{
+		if (FAILED(swapchain_factory->CreateSwapChain(&surface_factory, &desc, reinterpret_cast<IDXGIVkSwapChain **>(vk_swapchain.ppv()))))
+			return false;
+		for (int i = 0; i < 2; i++)
+			if (FAILED(vk_swapchain->GetImage(i, IID_ID3D12Resource, backbuffers[i].ppv())))
+				return false;
+	}
+
+	if (vk_swapchain)
+		return true;
+
+#ifdef _WIN32
+	SDL_PropertiesID props = SDL_GetWindowProperties(window);
+	SDL_LockProperties(props);
+	HWND hwnd = static_cast<HWND>(SDL_GetPointerProperty(props, "SDL.window.win32.hwnd", nullptr));
+	SDL_UnlockProperties(props);
+
+	void *dxgi = dlopen("dxgi.dll", RTLD_NOW);
+	if (!dxgi)
+		return false;
+
+	auto create_factory = (decltype(&CreateDXGIFactory1))dlsym(dxgi, "CreateDXGIFactory1");
+	if (!create_factory)
+		return false;
+
+	if (FAILED(create_factory(IID_IDXGIFactory2, factory.ppv())))
+		return false;
+
+	if (FAILED(factory->CreateSwapChainForHwnd(queue.get(), hwnd, &desc, nullptr, nullptr, reinterpret_cast<IDXGISwapChain1 **>(swapchain.ppv()))))
+		return false;
+
+	for (int i = 0; i < 2; i++)
+		if (FAILED(swapchain->GetBuffer(i, IID_ID3D12Resource, backbuffers[i].ppv())))
+			return false;
+#endif
+
+	return true;
+}
+
+static void print_help()
+{
+	LOGI("d3d12-replayer [--d3d12 <path>] [--vkd3d-proton] [--json <path to JSON, directory or manifest>] [--validate] [--iterations <count>] [--dispatches <count>]\n"
+	     "\t[--blob-io <auto|uring|threads|mmap>] [--repack-benchmark] [--allocation <packed|committed>]\n"
+	     "\t[--restore <per-dispatch|per-list|initial-only|never>]\n"
+	     "\t[--cache-mode <warm|cold|both>] [--cache-flush-size <MiB>] [--reject-outliers]\n"
+	     "\t[--report <path.json|path.csv|path.prom>]...\n"
+	     "\t[--warmup <count>] [--auto] [--target-error <percent>] [--time-budget <seconds>]\n"
+	     "\t[--no-prefetch] [--barriers <full|inferred|compare>] [--pipeline-cache <dir>]\n"
+	     "\t[--compile-benchmark] [--shader-benchmark] [--compile-threads <count>]\n"
+	     "\t[--convert <path.d3d12cap or directory>] [--compress] [--compression-threads <count>]\n"
+	     "\t[--dedup <blob store directory>] [--blob-cache-size <MiB>] [--shared-cache-size <MiB>]\n"
+	     "\tWith several captures, identical read-only resources are shared between them. Resource data is only\n"
+	     "\tcompared by content for captures rewritten by --dedup, otherwise by file, offset and size.\n");
+}
+
+// Only available through DXGI, which native builds do not have.
+static bool query_adapter_desc(ID3D12Device *device, DXGI_ADAPTER_DESC &desc)
+{
+#ifdef _WIN32
+	void *dxgi = dlopen("dxgi.dll", RTLD_NOW);
+	auto create_factory = dxgi ? (decltype(&CreateDXGIFactory1))dlsym(dxgi, "CreateDXGIFactory1") : nullptr;
+
+	ComPtr<IDXGIFactory4> factory;
+	ComPtr<IDXGIAdapter> adapter;
+
+	return create_factory && SUCCEEDED(create_factory(IID_IDXGIFactory4, factory.ppv())) &&
+	       SUCCEEDED(factory->EnumAdapterByLuid(device->GetAdapterLuid(), IID_IDXGIAdapter, adapter.ppv())) &&
+	       SUCCEEDED(adapter->GetDesc(&desc));
+#else
+	(void)device;
+	(void)desc;
+	return false;
+#endif
+}
+
+// Without DXGI, vkd3d-proton still hands out its Vulkan physical device. Native D3D12 has none.
+static PFN_vkVoidFunction get_vulkan_physical_device_proc(ID3D12Device *device, const char *name,
+                                                         VkPhysicalDevice &gpu)
+{
+	ComPtr<ID3D12DeviceExt> device_ext;
+	VkInstance instance = VK_NULL_HANDLE;
+	VkDevice vk_device = VK_NULL_HANDLE;
+	if (FAILED(device->QueryInterface(IID_ID3D12DeviceExt, device_ext.ppv())) ||
+	    FAILED(device_ext->GetVulkanHandles(&instance, &gpu, &vk_device)))
+		return nullptr;
+
+#ifdef _WIN32
+	void *module = dlopen("vulkan-1.dll", RTLD_NOW);
+#else
+	void *module = dlopen("libvulkan.so.1", RTLD_NOW);
+#endif
+
+	auto gipa = module ? (PFN_vkGetInstanceProcAddr)dlsym(module, "vkGetInstanceProcAddr") : nullptr;
+	return gipa ? gipa(instance, name) : nullptr;
+}
+
+// The largest device local heap is what DXGI reports as dedicated video memory.
+static uint64_t query_dedicated_video_memory(ID3D12Device *device)
+{
+	DXGI_ADAPTER_DESC desc;
+	if (query_adapter_desc(device, desc) && desc.DedicatedVideoMemory)
+		return desc.DedicatedVideoMemory;
+
+	VkPhysicalDevice gpu = VK_NULL_HANDLE;
+	auto get_memory_properties = (PFN_vkGetPhysicalDeviceMemoryProperties)get_vulkan_physical_device_proc(
+			device, "vkGetPhysicalDeviceMemoryProperties", gpu);
+	if (!get_memory_properties)
+		return 0;
+
+	VkPhysicalDeviceMemoryProperties props;
+	get_memory_properties(gpu, &props);
+
+	uint64_t size = 0;
+	for (uint32_t i = 0; i < props.memoryHeapCount; i++)
+		if (props.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+			size = std::max<uint64_t>(size, props.memoryHeaps[i].size);
+
+	return size;
+}
+
+// No API reports cache sizes. Default to twice the largest last level caches around,
+// but do not eat a meaningful fraction of VRAM on small adapters.
+static uint64_t get_default_cache_flush_size(ID3D12Device *device)
+{
+	uint64_t size = 256 * 1024 * 1024;
+
+	uint64_t vram = query_dedicated_video_memory(device);
+	if (vram)
+	{
+		size = std::min<uint64_t>(size, vram / 16);
+		size = std::max<uint64_t>(size, 32 * 1024 * 1024);
+	}
+
+	return size;
+}
+
+static std::string wchar_to_utf8(const WCHAR *str)
+{
+	std::string utf8;
+	for (; *str; str++)
+	{
+		uint32_t c = uint32_t(*str);
+
+		if (c >= 0xd800 && c < 0xdc00 && str[1] >= 0xdc00 && str[1] < 0xe000)
+		{
+			c = 0x10000 + ((c - 0xd800) << 10) + (uint32_t(str[1]) - 0xdc00);
+			str++;
+		}
+
+		if (c < 0x80)
+		{
+			utf8 += char(c);
+		}
+		else if (c < 0x800)
+		{
+			utf8 += char(0xc0 | (c >> 6));
+			utf8 += char(0x80 | (c & 0x3f));
+		}
+		else if (c < 0x10000)
+		{
+			utf8 += char(0xe0 | (c >> 12));
+			utf8 += char(0x80 | ((c >> 6) & 0x3f));
+			utf8 += char(0x80 | (c & 0x3f));
+		}
+		else
+		{
+			utf8 += char(0xf0 | (c >> 18));
+			utf8 += char(0x80 | ((c >> 12) & 0x3f));
+			utf8 += char(0x80 | ((c >> 6) & 0x3f));
+			utf8 += char(0x80 | (c & 0x3f));
+		}
+	}
+	return utf8;
+}
+
+static void fill_report_environment(Util::ReportEnvironment &env, ID3D12Device *device, ID3D12CommandQueue *queue)
+{
+	LUID luid = device->GetAdapterLuid();
+	env.adapter_luid = (uint64_t(uint32_t(luid.HighPart)) << 32) | luid.LowPart;
+
+	DXGI_ADAPTER_DESC desc;
+	if (query_adapter_desc(device, desc))
+	{
+		env.adapter_description = wchar_to_utf8(desc.Description);
+		env.adapter_vendor_id = desc.VendorId;
+		env.adapter_device_id = desc.DeviceId;
+	}
+
+	UINT64 freq = 0;
+	if (SUCCEEDED(queue->GetTimestampFrequency(&freq)))
+		env.timestamp_frequency = freq;
+}
+
+// Separates pipeline caches of different adapters and D3D12 implementations. Driver versions are left
+// to the runtime, which rejects stale libraries and blobs with D3D12_ERROR_DRIVER_VERSION_MISMATCH.
+static Util::Hash get_pipeline_cache_identity(ID3D12Device *device, const std::string &d3d12_module)
+{
+	Util::Hasher hasher;
+	hasher.string(d3d12_module);
+
+	DXGI_ADAPTER_DESC desc;
+	if (query_adapter_desc(device, desc))
+	{
+		hasher.string(wchar_to_utf8(desc.Description));
+		hasher.u32(desc.VendorId);
+		hasher.u32(desc.DeviceId);
+		hasher.u32(desc.SubSysId);
+		hasher.u32(desc.Revision);
+	}
+
+	// DXGI does not know the driver version, and native builds have no DXGI at all.
+	VkPhysicalDevice gpu = VK_NULL_HANDLE;
+	auto get_properties = (PFN_vkGetPhysicalDeviceProperties)get_vulkan_physical_device_proc(
+			device, "vkGetPhysicalDeviceProperties", gpu);
+	if (get_properties)
+	{
+		VkPhysicalDeviceProperties props;
+		get_properties(gpu, &props);
+		hasher.string(props.deviceName);
+		hasher.u32(props.vendorID);
+		hasher.u32(props.deviceID);
+		hasher.u32(props.driverVersion);
+		hasher.data(props.pipelineCacheUUID, sizeof(props.pipelineCacheUUID));
+	}
+
+	return hasher.get();
+}
+
+// Identifies the capture by its JSON or container tables, shader blobs and resource blob contents.
+// Resource blobs which are not content-addressed are read again, which runs after replay and mostly hits
+// the page cache. Fails if any blob cannot be read, rather than hashing it as empty.
+static bool hash_capture(const std::vector<uint8_t> &metadata, const Util::CaptureDesc &desc, Util::Hash &hash)
+{
+	Util::Hasher hasher;
+	hasher.data(metadata.data(), metadata.size());
+
+	for (auto &pass : desc.passes)
+	{
+		for (auto *ref : { &pass.cs, &pass.root_signature })
+		{
+			std::vector<uint8_t> blob;
+			if (!Util::load_blob(*ref, blob))
+				return false;
+			hasher.u64(blob.size());
+			hasher.data(blob.data(), blob.size());
+		}
+	}
+
+	// Content-addressed blobs already carry their XXH64, the rest is hashed the same way.
+	for (auto &resource : desc.resources)
+	{
+		for (auto &blob : resource.data)
+		{
+			if (blob.content_hash)
+			{
+				hasher.u64(blob.content_hash);
+				continue;
+			}
+
+			std::vector<uint8_t> data;
+			if (!Util::load_blob(blob, data))
+				return false;
+			hasher.u64(Util::hash_blob(data.data(), data.size()));
+		}
+	}
+
+	hash = hasher.get();
+	return true;
+}
+
+static Util::TimingStats::Summary summarize_us(const Util::TimingStats &stats, bool reject_outliers, double us_per_tick)
+{
+	auto s = stats.summarize(reject_outliers);
+	s.mean *= us_per_tick;
+	s.stddev *= us_per_tick;
+	s.min *= us_per_tick;
+	s.max *= us_per_tick;
+	s.p50 *= us_per_tick;
+	s.p90 *= us_per_tick;
+	s.p99 *= us_per_tick;
+	return s;
+}
+
+static Util::ReportTiming build_report_timing(const char *cache_state, const Util::TimingStats &stats,
+                                              const std::vector<Util::TimingStats> &pass_stats,
+                                              const DispatchPlan &plan, bool reject_outliers, double us_per_tick)
+{
+	Util::ReportTiming timing;
+	timing.cache_state = cache_state;
+	timing.summary = summarize_us(stats, reject_outliers, us_per_tick);
+
+	timing.samples.reserve(stats.get_samples().size());
+	for (auto sample : stats.get_samples())
+		timing.samples.push_back(double(sample) * us_per_tick);
+
+	for (size_t i = 0; i < pass_stats.size(); i++)
+		timing.passes.push_back({ plan.passes[i].name, summarize_us(pass_stats[i], reject_outliers, us_per_tick) });
+
+	return timing;
+}
+
+static bool check_agility_sdk_support(ID3D12Device *device)
+{
+	ComPtr<ID3D12Device10> device10;
+	if (FAILED(device->QueryInterface(IID_ID3D12Device10, device10.ppv())))
+	{
+		LOGE("Failed to query ID3D12Device10. AgilitySDK dlls might not be present?\n");
+		return false;
 	}
 
-	list->ResolveQueryData(ctx.timestamps.get(), D3D12_QUERY_TYPE_TIMESTAMP,
-	                       0, dispatches_per_list * 2,
-	                       ctx.timestamp_readback.get(), 0);
+	D3D12_FEATURE_DATA_D3D12_OPTIONS12 options12;
+	if (FAILED(device10->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS12, &options12, sizeof(options12))))
+	{
+		LOGE("Failed to query OPTIONS12.\n");
+		return false;
+	}
 
-	if (rtv)
+	if (!options12.RelaxedFormatCastingSupported)
 	{
-		// Just clear something so it looks like it's working.
-		D3D12_CPU_DESCRIPTOR_HANDLE h = rtv->GetCPUDescriptorHandleForHeapStart();
-		size_t index = 0;
+		LOGE("RelaxedFormatCasting not supported.\n");
+		return false;
+	}
 
-		if (vk_swapchain)
-			index = vk_swapchain->GetImageIndex();
-		else if (swapchain)
-			index = swapchain->GetCurrentBackBufferIndex();
+	return true;
+}
 
-		h.ptr += index * device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+static bool is_capture_extension(const std::string &path)
+{
+	auto ext = Granite::Path::ext(path);
+	return ext == "json" || ext == "d3d12cap";
+}
 
-		D3D12_RESOURCE_BARRIER barrier = {};
-		barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-		barrier.Transition.pResource = backbuffers[index].get();
-		barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_PRESENT;
-		barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_RENDER_TARGET;
+// Accepts a single capture JSON or container, a directory of them, or a manifest with one capture path per line.
+// Manifest paths are relative to the manifest, empty lines and lines starting with # are skipped.
+static bool collect_capture_paths(const std::string &path, std::vector<std::string> &paths)
+{
+	if (Granite::Path::is_directory(path))
+	{
+		std::vector<std::string> files;
+		if (!Granite::Path::list_directory_files(path, files))
+		{
+			LOGE("Failed to list captures in \"%s\".\n", path.c_str());
+			return false;
+		}
 
-		const FLOAT color[] = { 0.1f, 0.2f, 0.3f };
+		for (auto &file : files)
+			if (is_capture_extension(file))
+				paths.push_back(Granite::Path::join(path, file));
+	}
+	else if (is_capture_extension(path))
+	{
+		paths.push_back(path);
+	}
+	else
+	{
+		auto manifest = load_binary_file<char>(path);
+		size_t offset = 0;
+		while (offset < manifest.size())
+		{
+			auto *begin = manifest.data() + offset;
+			auto *end = std::find(begin, manifest.data() + manifest.size(), '\n');
+			offset = size_t(end - manifest.data()) + 1;
 
-		list->ResourceBarrier(1, &barrier);
-		list->ClearRenderTargetView(h, color, 0, nullptr);
+			while (begin < end && isspace(uint8_t(*begin)))
+				begin++;
+			while (end > begin && isspace(uint8_t(end[-1])))
+				end--;
 
-		barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_RENDER_TARGET;
-		barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PRESENT;
-		list->ResourceBarrier(1, &barrier);
+			if (begin != end && *begin != '#')
+				paths.push_back(relpath(path, std::string(begin, end)));
+		}
 	}
 
-	if (FAILED(list->Close()))
+	if (paths.empty())
+	{
+		LOGE("No captures found in \"%s\".\n", path.c_str());
 		return false;
+	}
 
-	ID3D12CommandList *lists[] = { list.get() };
-	queue->ExecuteCommandLists(1, lists);
+	return true;
+}
 
-	if (vk_swapchain)
+struct PreparedCapture
+{
+	std::string path;
+	std::vector<uint8_t> metadata;
+	Util::CaptureDesc desc;
+	// Null if loading failed.
+	std::unique_ptr<Capture> capture;
+};
+
+// Safe to run on a background thread while the device replays another capture.
+static std::unique_ptr<PreparedCapture> prepare_capture(std::unique_ptr<Capture> capture, const std::string &path)
+{
+	std::unique_ptr<PreparedCapture> prepared(new PreparedCapture);
+	prepared->path = path;
+	if (!load_capture_desc(path, prepared->desc, prepared->metadata))
+		return prepared;
+
+	if (capture->load_capture(prepared->desc))
+		prepared->capture = std::move(capture);
+	return prepared;
+}
+
+static bool load_shader_blobs(const std::vector<std::string> &captures, std::vector<Util::ShaderBlobs> &shaders)
+{
+	// Captures of one title share most of their shaders, only distinct combinations are compiled.
+	std::unordered_set<std::string> seen;
+
+	for (auto &path : captures)
 	{
-		if (FAILED(vk_swapchain->Present(0, 0, nullptr)))
+		Util::CaptureDesc desc;
+		std::vector<uint8_t> metadata;
+		if (!load_capture_desc(path, desc, metadata))
 			return false;
+
+		for (auto &pass : desc.passes)
+		{
+			auto key = pass.cs.path + '\n' + std::to_string(pass.cs.offset) + '\n' +
+			           pass.root_signature.path + '\n' + std::to_string(pass.root_signature.offset);
+			if (!seen.insert(key).second)
+				continue;
+
+			Util::ShaderBlobs blobs;
+			blobs.cs_path = pass.cs.packed ? path + ":" + pass.name : pass.cs.path;
+			if (!Util::load_blob(pass.cs, blobs.cs) || !Util::load_blob(pass.root_signature, blobs.root_signature))
+				return false;
+
+			shaders.push_back(std::move(blobs));
+		}
 	}
-	else if (swapchain)
+
+	if (shaders.empty())
 	{
-		if (FAILED(swapchain->Present(0, 0)))
-			return false;
+		LOGE("No shaders to compile.\n");
+		return false;
 	}
 
-	queue->Signal(fence.get(), ++latest_fence_value);
-	ctx.fence_value_for_iteration = latest_fence_value;
-	frame_index = (frame_index + 1) % NumFrameContexts;
 	return true;
 }
 
-static Device create_device(const std::string &path, bool validate, bool vkd3d_proton)
+// A single capture is written to output, several are written into output as a directory.
+static bool convert_captures(const std::vector<std::string> &captures, const std::string &output,
+                             const Util::ContainerWriteOptions &options)
 {
-	Device device;
-
-#ifndef VKD3D_PROTON_SYSTEM
-	void *module = dlopen(path.c_str(), RTLD_NOW);
-	if (!module)
+	if (captures.size() > 1 && !Granite::Path::make_directory(output))
 	{
-		LOGE("Failed to load vkd3d-proton.\n");
-		return {};
+		LOGE("Failed to create directory %s.\n", output.c_str());
+		return false;
 	}
 
-	// For convenience on Windows build, we just load d3d12core.dll directly and extract the private APIs.
-	if (vkd3d_proton)
+	for (auto &path : captures)
 	{
-		auto get_interface = (PFN_D3D12_GET_INTERFACE) dlsym(module, "D3D12GetInterface");
-		if (!get_interface)
-			return {};
+		Util::CaptureDesc desc;
+		std::vector<uint8_t> metadata;
+		if (!load_capture_desc(path, desc, metadata))
+			return false;
 
-		IVKD3DCoreInterface *iface;
-		if (FAILED(get_interface(CLSID_VKD3DCore, IID_IVKD3DCoreInterface, (void **)&iface)))
+		auto output_path = output;
+		if (captures.size() > 1)
 		{
-			LOGE("%s does not look like a vkd3d-proton d3d12core.dll.\n", path.c_str());
-			return {};
+			auto name = Granite::Path::basename(path);
+			name = name.substr(0, name.find_last_of('.')) + ".d3d12cap";
+			output_path = Granite::Path::join(output, name);
 		}
 
-		if (FAILED(iface->CreateDevice(nullptr, D3D_FEATURE_LEVEL_12_0, IID_ID3D12Device, device.device.ppv())))
+		if (output_path == path)
 		{
-			fprintf(stderr, "Failed to create device.\n");
-			return {};
+			LOGE("Refusing to convert %s onto itself.\n", path.c_str());
+			return false;
 		}
+
+		if (!Util::write_capture_container(output_path, desc, options))
+			return false;
 	}
-	else
+
+	return true;
+}
+
+// Copies a blob named in a JSON capture into the store and refers to it by content hash instead.
+// The original file is left in place. Names shared within the capture are only copied once.
+static bool dedup_blob(const BlobLocator &locator, const std::string &store, rapidjson::Value &name,
+                       rapidjson::Document::AllocatorType &allocator,
+                       std::unordered_map<std::string, std::string> &renames, uint64_t &stored_bytes)
+{
+	if (!name.IsString())
 	{
-		if (validate)
+		LOGE("Blob names must be strings.\n");
+		return false;
+	}
+
+	auto itr = renames.find(name.GetString());
+	if (itr == renames.end())
+	{
+		Util::BlobRef blob;
+		std::vector<uint8_t> data;
+		if (!locator.resolve(name.GetString(), blob) || !Util::load_blob(blob, data))
+			return false;
+
+		Util::Hash hash;
+		bool added;
+		if (!Util::add_blob_to_store(store, data, hash, added))
+			return false;
+
+		if (added)
+			stored_bytes += data.size();
+		itr = renames.insert({ name.GetString(), Util::get_blob_name(hash) }).first;
+	}
+
+	name.SetString(itr->second.c_str(), rapidjson::SizeType(itr->second.size()), allocator);
+	return true;
+}
+
+// Rewrites JSON captures in place to refer to their blobs by content hash in store.
+// The loose blobs are left alone, they can be removed once every capture has been rewritten.
+static bool dedup_captures(const std::vector<std::string> &captures, const std::string &store)
+{
+	if (!Granite::Path::make_directory(store))
+	{
+		LOGE("Failed to create blob store %s.\n", store.c_str());
+		return false;
+	}
+
+	uint64_t referenced_bytes = 0;
+	uint64_t stored_bytes = 0;
+
+	for (auto &path : captures)
+	{
+		if (Util::is_capture_container(path))
 		{
-			auto get_debug_iface = (PFN_D3D12_GET_DEBUG_INTERFACE) dlsym(module, "D3D12GetDebugInterface");
-			ComPtr<ID3D12Debug> debug;
-			if (SUCCEEDED(get_debug_iface(IID_ID3D12Debug, debug.ppv())))
-			{
-				LOGI("Enabling validation.\n");
-				debug->EnableDebugLayer();
-			}
+			LOGW("Skipping capture container %s, only JSON captures refer to blobs by name.\n", path.c_str());
+			continue;
 		}
 
-		auto create = (PFN_D3D12_CREATE_DEVICE) dlsym(module, "D3D12CreateDevice");
-		if (!create)
+		auto json = load_binary_file<char>(path);
+		rapidjson::Document doc;
+		doc.Parse(json.data(), json.size());
+		if (doc.HasParseError() || !doc.IsObject() || !doc.HasMember("Resources"))
 		{
-			LOGE("Failed to query symbol.\n");
-			return {};
+			LOGE("Failed to parse %s.\n", path.c_str());
+			return false;
 		}
 
-		if (FAILED(create(nullptr, D3D_FEATURE_LEVEL_12_0, IID_ID3D12Device, device.device.ppv())))
+		// Blobs are looked up with the old locator, the capture may already use a store.
+		BlobLocator locator;
+		locator.base_path = path;
+		if (doc.HasMember("BlobStore"))
+			locator.store = relpath(path, doc["BlobStore"].GetString());
+
+		auto &allocator = doc.GetAllocator();
+		std::unordered_map<std::string, std::string> renames;
+
+		auto &resources = doc["Resources"];
+		for (auto itr = resources.Begin(); itr != resources.End(); ++itr)
 		{
-			fprintf(stderr, "Failed to create device.\n");
-			return {};
+			if (!itr->HasMember("data"))
+				continue;
+
+			auto &data = (*itr)["data"];
+			if (!data.IsArray())
+			{
+				LOGE("Resource data must be an array.\n");
+				return false;
+			}
+
+			for (auto data_itr = data.Begin(); data_itr != data.End(); ++data_itr)
+				if (!dedup_blob(locator, store, *data_itr, allocator, renames, stored_bytes))
+					return false;
 		}
-	}
-#else
-	(void)path;
-	(void)validate;
-	if (FAILED(D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_12_0, IID_ID3D12Device, device.device.ppv())))
-	{
-		fprintf(stderr, "Failed to create device.\n");
-		return {};
-	}
-#endif
 
-	auto *dev = device.device.get();
+		std::vector<rapidjson::Value *> pass_values = { &doc };
+		if (doc.HasMember("Dispatches"))
+			for (auto itr = doc["Dispatches"].Begin(); itr != doc["Dispatches"].End(); ++itr)
+				pass_values.push_back(&*itr);
 
-	if (FAILED(dev->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_ID3D12Fence, device.fence.ppv())))
-		return {};
+		for (auto *pass : pass_values)
+		{
+			for (auto *member : { "CS", "RootSignature" })
+			{
+				if (pass->HasMember(member) &&
+				    !dedup_blob(locator, store, (*pass)[member], allocator, renames, stored_bytes))
+				{
+					return false;
+				}
+			}
+		}
 
-	D3D12_COMMAND_QUEUE_DESC desc = {};
-	desc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
-	if (FAILED(dev->CreateCommandQueue(&desc, IID_ID3D12CommandQueue, device.queue.ppv())))
-		return {};
+		for (auto &rename : renames)
+		{
+			Util::BlobRef blob;
+			uint64_t size = 0;
+			if (locator.resolve(rename.first.c_str(), blob) && Util::query_blob_size(blob, size))
+				referenced_bytes += size;
+		}
 
-	for (auto &ctx : device.frame_contexts)
-		if (FAILED(dev->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_ID3D12CommandAllocator, ctx.allocator.ppv())))
-			return {};
+		auto store_path = Granite::Path::make_relative(Granite::Path::basedir(path), store);
+		if (doc.HasMember("BlobStore"))
+			doc["BlobStore"].SetString(store_path.c_str(), rapidjson::SizeType(store_path.size()), allocator);
+		else
+			doc.AddMember("BlobStore", rapidjson::Value(store_path.c_str(), allocator), allocator);
+
+		rapidjson::StringBuffer buffer;
+		rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+		writer.SetIndent('\t', 1);
+		doc.Accept(writer);
+
+		// Written next to the capture first, so an interrupted run never leaves a truncated capture behind.
+		auto tmp_path = path + ".tmp";
+		FILE *file = fopen(tmp_path.c_str(), "wb");
+		bool success = file && fwrite(buffer.GetString(), 1, buffer.GetSize(), file) == buffer.GetSize();
+		if (file && fclose(file) != 0)
+			success = false;
+		success = success && Granite::Path::replace_file(tmp_path, path);
+
+		if (!success)
+		{
+			LOGE("Failed to rewrite %s.\n", path.c_str());
+			remove(tmp_path.c_str());
+			return false;
+		}
 
-	if (FAILED(dev->CreateCommandList(
-			0, D3D12_COMMAND_LIST_TYPE_DIRECT, device.frame_contexts[0].allocator.get(),
-			nullptr, IID_ID3D12CommandList, device.list.ppv())))
-	{
-		return {};
+		LOGI("Rewrote %s to use %zu blobs from %s.\n", path.c_str(), renames.size(), store.c_str());
 	}
 
-	device.list->Close();
-
-	return device;
+	LOGI("Captures refer to %.3f MiB of blobs, %.3f MiB of it was new to the store.\n",
+	     double(referenced_bytes) / (1024.0 * 1024.0), double(stored_bytes) / (1024.0 * 1024.0));
+	return true;
 }
 
-bool Device::init_swapchain(SDL_Window *window)
+// Creates every distinct PSO of the captures without dispatching anything.
+// Blobs and root signatures are loaded up front, so only CreateComputePipelineState is timed.
+static bool run_compile_benchmark(ID3D12Device *device, const std::vector<Util::ShaderBlobs> &shaders,
+                                  unsigned max_threads)
 {
-	struct SurfaceFactory : IDXGIVkSurfaceFactory
+	std::vector<ComPtr<ID3D12RootSignature>> root_signatures(shaders.size());
+	for (size_t i = 0; i < shaders.size(); i++)
 	{
-		// Unused
-		HRESULT QueryInterface(const IID &, void **) override { return E_NOINTERFACE; }
-		ULONG AddRef() override { return 0; }
-		ULONG Release() override { return 0; }
+		auto &rs = shaders[i].root_signature;
+		if (FAILED(device->CreateRootSignature(0, rs.data(), rs.size(),
+		                                       IID_ID3D12RootSignature, root_signatures[i].ppv())))
+		{
+			LOGE("Failed to create root signature for %s.\n", shaders[i].cs_path.c_str());
+			return false;
+		}
+	}
 
-		VkResult CreateSurface(VkInstance instance, VkPhysicalDevice, VkSurfaceKHR *pSurface) override
+	LOGI("Compiling %zu distinct pipelines.\n", shaders.size());
+	LOGI("Disable driver shader caches for meaningful numbers, e.g. VKD3D_SHADER_CACHE_PATH=0 for vkd3d-proton.\n");
+
+	std::vector<ComPtr<ID3D12PipelineState>> psos(shaders.size());
+
+	auto task = [&](size_t index) -> bool {
+		D3D12_COMPUTE_PIPELINE_STATE_DESC desc = {};
+		desc.pRootSignature = root_signatures[index].get();
+		desc.CS.pShaderBytecode = shaders[index].cs.data();
+		desc.CS.BytecodeLength = shaders[index].cs.size();
+
+		if (FAILED(device->CreateComputePipelineState(&desc, IID_ID3D12PipelineState, psos[index].ppv())))
 		{
-#ifdef _WIN32
-			void *module = dlopen("vulkan-1.dll", RTLD_NOW);
-#else
-			void *module = dlopen("libvulkan.so.1", RTLD_NOW);
-#endif
+			LOGE("Failed to create PSO for %s.\n", shaders[index].cs_path.c_str());
+			return false;
+		}
+		return true;
+	};
 
-			if (!module)
-				return VK_ERROR_INCOMPATIBLE_DRIVER;
+	// Pipelines are released between rounds, so destruction does not count towards creation.
+	auto end_round = [&]() {
+		for (auto &pso : psos)
+			pso = {};
+	};
 
-			auto gipa = (PFN_vkGetInstanceProcAddr)dlsym(module, "vkGetInstanceProcAddr");
-			if (!gipa)
-				return VK_ERROR_INCOMPATIBLE_DRIVER;
+	std::vector<uint64_t> single_thread_ns;
+	if (!Util::run_scaling_benchmark(shaders.size(), max_threads, task, end_round, single_thread_ns))
+		return false;
 
-			SDL_PropertiesID props = SDL_GetWindowProperties(window);
-			SDL_LockProperties(props);
+	// Per-shader latency without contention from other threads.
+	std::vector<size_t> order(shaders.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return single_thread_ns[a] > single_thread_ns[b];
+	});
 
-			VkResult vr = VK_ERROR_INCOMPATIBLE_DRIVER;
+	LOGI("Slowest pipelines on one thread:\n");
+	for (size_t i = 0; i < std::min<size_t>(order.size(), 10); i++)
+		LOGI("  %10.3f ms  %s\n", 1e-6 * double(single_thread_ns[order[i]]), shaders[order[i]].cs_path.c_str());
 
-#ifdef _WIN32
-			auto win32_create = (PFN_vkCreateWin32SurfaceKHR)gipa(instance, "vkCreateWin32SurfaceKHR");
-			auto hwnd = static_cast<HWND>(SDL_GetPointerProperty(props, SDL_PROP_WINDOW_WIN32_HWND_POINTER, nullptr));
-			auto hinstance = static_cast<HINSTANCE>(SDL_GetPointerProperty(props, SDL_PROP_WINDOW_WIN32_INSTANCE_POINTER, nullptr));
+	return true;
+}
+
+struct ReplaySettings
+{
+	unsigned iterations = 0;
+	unsigned dispatches_per_iteration = 1;
+	unsigned warmup = 0;
+	bool auto_iterations = false;
+	double target_error = 1.0;
+	double time_budget = 60.0;
+};
 
-			if (hwnd && win32_create)
+static bool run_timed_iterations(Device &device, const ReplaySettings &settings, SDL_Window *window, bool &alive)
+{
+	if (window)
+	{
+		// Space moves on to the next capture of a suite, closing the window stops the run.
+		bool next = false;
+		while (alive && !next)
+		{
+			SDL_Event e;
+			while (SDL_PollEvent(&e))
 			{
-				VkWin32SurfaceCreateInfoKHR win32_info = { VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR };
-				win32_info.hwnd = hwnd;
-				win32_info.hinstance = hinstance;
-				vr = win32_create(instance, &win32_info, nullptr, pSurface);
+				if (e.type == SDL_EVENT_QUIT)
+					alive = false;
+				else if (e.type == SDL_EVENT_KEY_DOWN && e.key.key == SDLK_SPACE && !e.key.repeat)
+					next = true;
 			}
-#else
-			auto x11_win = static_cast<Window>(SDL_GetNumberProperty(props, SDL_PROP_WINDOW_X11_WINDOW_NUMBER, 0));
-			auto x11_dpy = static_cast<Display *>(SDL_GetPointerProperty(props, SDL_PROP_WINDOW_X11_DISPLAY_POINTER, nullptr));
-			auto wl_dpy = static_cast<wl_display *>(SDL_GetPointerProperty(props, SDL_PROP_WINDOW_WAYLAND_DISPLAY_POINTER, nullptr));
-			auto wl_surf = static_cast<wl_surface *>(SDL_GetPointerProperty(props, SDL_PROP_WINDOW_WAYLAND_SURFACE_POINTER, nullptr));
-
-			auto x11_create = (PFN_vkCreateXlibSurfaceKHR)gipa(instance, "vkCreateXlibSurfaceKHR");
-			auto wl_create = (PFN_vkCreateWaylandSurfaceKHR)gipa(instance, "vkCreateWaylandSurfaceKHR");
 
-			if (x11_create && x11_dpy)
+			if (!device.execute_iteration(settings.dispatches_per_iteration))
 			{
-				VkXlibSurfaceCreateInfoKHR xlib_info = { VK_STRUCTURE_TYPE_XLIB_SURFACE_CREATE_INFO_KHR };
-				xlib_info.dpy = x11_dpy;
-				xlib_info.window = x11_win;
-				vr = x11_create(instance, &xlib_info, nullptr, pSurface);
+				LOGE("Failed to execute iteration.\n");
+				return false;
 			}
-			else if (wl_create && wl_dpy && wl_surf)
+		}
+	}
+	else if (settings.auto_iterations)
+	{
+		auto start_time = std::chrono::steady_clock::now();
+		double budget_ns = settings.time_budget * 1e9;
+		double relative_error = HUGE_VAL;
+		bool converged = false;
+		uint32_t iter = 0;
+
+		while (!settings.iterations || iter < settings.iterations)
+		{
+			if (!device.execute_iteration(settings.dispatches_per_iteration))
 			{
-				VkWaylandSurfaceCreateInfoKHR wl_info = { VK_STRUCTURE_TYPE_WAYLAND_SURFACE_CREATE_INFO_KHR };
-				wl_info.display = wl_dpy;
-				wl_info.surface = wl_surf;
-				vr = wl_create(instance, &wl_info, nullptr, pSurface);
+				LOGE("Failed to execute iteration.\n");
+				return false;
 			}
-#endif
+			iter++;
 
-			SDL_UnlockProperties(props);
-			return vr;
-		}
+			// Sorting every sample is not free, so only check now and then.
+			if (iter % 16 != 0)
+				continue;
 
-		ID3D12Device *device = nullptr;
-		SDL_Window *window = nullptr;
-	} surface_factory;
+			// Every cache state being measured has to converge.
+			relative_error = 0.0;
+			for (int i = 0; i < Device::TimingCount; i++)
+			{
+				bool active = device.cache_mode == Device::CacheMode::Both ||
+				              (i == Device::TimingCold) == (device.cache_mode == Device::CacheMode::Cold);
+				if (!active)
+					continue;
 
-	surface_factory.device = device.get();
-	surface_factory.window = window;
+				double err = device.timing_stats[i].get_median_relative_error();
+				relative_error = err < 0.0 ? HUGE_VAL : std::max(relative_error, err);
+			}
+			converged = relative_error <= settings.target_error * 0.01;
 
-	DXGI_SWAP_CHAIN_DESC1 desc = {};
-	desc.Width = 512;
-	desc.Height = 512;
-	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	desc.BufferCount = 2;
-	desc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-	desc.SampleDesc.Count = 1;
-	desc.BufferCount = 2;
-	desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
-	desc.SampleDesc.Count = 1;
-	desc.Scaling = DXGI_SCALING_STRETCH;
-	desc.AlphaMode = DXGI_ALPHA_MODE_IGNORE;
+			if (converged || double(elapsed_ns(start_time)) > budget_ns)
+				break;
+		}
 
-	ComPtr<IDXGIVkSwapChainFactory> swapchain_factory;
-	if (SUCCEEDED(queue->QueryInterface(IID_IDXGIVkSwapChainFactory, swapchain_factory.ppv())))
+		if (converged)
+		{
+			LOGI("Converged after %u iterations, median within +/- %.3f %%.\n", iter, relative_error * 100.0);
+		}
+		else
+		{
+			LOGW("Stopped after %u iterations without converging, median within +/- %.3f %% (target %.3f %%).\n",
+			     iter, relative_error * 100.0, settings.target_error);
+		}
+	}
+	else
 	{
-		if (FAILED(swapchain_factory->CreateSwapChain(&surface_factory, &desc, reinterpret_cast<IDXGIVkSwapChain **>(vk_swapchain.ppv()))))
-			return false;
-		for (int i = 0; i < 2; i++)
-			if (FAILED(vk_swapchain->GetImage(i, IID_ID3D12Resource, backbuffers[i].ppv())))
+		for (uint32_t iter = 0; iter < settings.iterations; iter++)
+		{
+			if (!device.execute_iteration(settings.dispatches_per_iteration))
+			{
+				LOGE("Failed to execute iteration.\n");
 				return false;
+			}
+		}
 	}
 
-	if (vk_swapchain)
-		return true;
+	return true;
+}
 
-#ifdef _WIN32
-	SDL_PropertiesID props = SDL_GetWindowProperties(window);
-	SDL_LockProperties(props);
-	HWND hwnd = static_cast<HWND>(SDL_GetPointerProperty(props, "SDL.window.win32.hwnd", nullptr));
-	SDL_UnlockProperties(props);
+// Runs the loaded capture until done and collects its timestamps.
+// Returns false if submission failed. alive is cleared once the window is closed.
+static bool replay_capture(Device &device, const ReplaySettings &settings, SDL_Window *window, bool &alive)
+{
+	// Lazy pipeline compilation, clock ramp-up and the initial uploads all land in the warmup.
+	device.collect_timings = false;
+	for (uint32_t iter = 0; iter < settings.warmup; iter++)
+	{
+		if (!device.execute_iteration(settings.dispatches_per_iteration))
+		{
+			LOGE("Failed to execute iteration.\n");
+			return false;
+		}
+	}
+	device.collect_timings = true;
 
-	void *dxgi = dlopen("dxgi.dll", RTLD_NOW);
-	if (!dxgi)
-		return false;
+	// Background loads only get to touch the disk outside the timed window.
+	if (device.io_gate)
+		device.io_gate->pause();
 
-	auto create_factory = (decltype(&CreateDXGIFactory1))dlsym(dxgi, "CreateDXGIFactory1");
-	if (!create_factory)
-		return false;
+	bool success = run_timed_iterations(device, settings, window, alive);
+	device.drain_timestamps();
 
-	if (FAILED(create_factory(IID_IDXGIFactory2, factory.ppv())))
-		return false;
+	if (device.io_gate)
+		device.io_gate->resume();
+	return success;
+}
 
-	if (FAILED(factory->CreateSwapChainForHwnd(queue.get(), hwnd, &desc, nullptr, nullptr, reinterpret_cast<IDXGISwapChain1 **>(swapchain.ppv()))))
-		return false;
+static const char *cache_state_names[Device::TimingCount] = { "warm", "cold" };
 
-	for (int i = 0; i < 2; i++)
-		if (FAILED(swapchain->GetBuffer(i, IID_ID3D12Resource, backbuffers[i].ppv())))
-			return false;
-#endif
+static void log_capture_stats(const Device &device, bool reject_outliers, double us_per_tick)
+{
+	for (int i = 0; i < Device::TimingCount; i++)
+	{
+		auto &stats = device.timing_stats[i];
+		if (!stats.get_count())
+			continue;
 
-	return true;
-}
+		auto summary = stats.summarize(reject_outliers);
+		LOGI("[%s] %llu dispatches%s, %llu outliers rejected (restore policy: %s)\n", cache_state_names[i],
+		     static_cast<unsigned long long>(summary.count),
+		     summary.exact ? "" : " (approximate quantiles)",
+		     static_cast<unsigned long long>(summary.rejected),
+		     restore_policy_to_string(device.restore_policy));
+		LOGI("[%s] Total time per dispatch: %.3f us, stddev %.3f us\n", cache_state_names[i],
+		     summary.mean * us_per_tick, summary.stddev * us_per_tick);
+		LOGI("[%s] min %.3f us, p50 %.3f us, p90 %.3f us, p99 %.3f us, max %.3f us\n", cache_state_names[i],
+		     summary.min * us_per_tick, summary.p50 * us_per_tick, summary.p90 * us_per_tick,
+		     summary.p99 * us_per_tick, summary.max * us_per_tick);
+		stats.log_histogram(reject_outliers, us_per_tick, "us");
+
+		auto &passes = device.capture->plan.passes;
+		auto &pass_stats = device.pass_timing_stats[i];
+		for (size_t pass = 0; pass < pass_stats.size(); pass++)
+		{
+			auto pass_summary = pass_stats[pass].summarize(reject_outliers);
+			LOGI("[%s]   %s: mean %.3f us (%.1f %%), p50 %.3f us, p99 %.3f us\n", cache_state_names[i],
+			     passes[pass].name.c_str(), pass_summary.mean * us_per_tick,
+			     summary.mean > 0.0 ? 100.0 * pass_summary.mean / summary.mean : 0.0,
+			     pass_summary.p50 * us_per_tick, pass_summary.p99 * us_per_tick);
+		}
 
-static void print_help()
-{
-	LOGI("d3d12-replayer [--d3d12 <path>] [--vkd3d-proton] [--json <path to JSON>] [--validate] [--iterations <count>] [--dispatches <count>]\n");
+		auto &baseline = device.baseline_timing_stats[i];
+		if (baseline.get_count())
+		{
+			auto baseline_summary = baseline.summarize(reject_outliers);
+			double saved = baseline_summary.p50 - summary.p50;
+			LOGI("[%s] Full barriers: %llu dispatches, mean %.3f us, p50 %.3f us. "
+			     "Inferred barriers save %.3f us (%.1f %%) at p50.\n", cache_state_names[i],
+			     static_cast<unsigned long long>(baseline_summary.count),
+			     baseline_summary.mean * us_per_tick, baseline_summary.p50 * us_per_tick, saved * us_per_tick,
+			     baseline_summary.p50 > 0.0 ? 100.0 * saved / baseline_summary.p50 : 0.0);
+		}
+	}
 }
 
-static bool check_agility_sdk_support(ID3D12Device *device)
+static Util::CaptureResult build_capture_result(const PreparedCapture &prepared, const Device &device,
+                                                bool reject_outliers, double us_per_tick)
 {
-	ComPtr<ID3D12Device10> device10;
-	if (FAILED(device->QueryInterface(IID_ID3D12Device10, device10.ppv())))
+	auto &load_timings = device.capture->load_timings;
+
+	Util::CaptureResult result;
+	result.path = prepared.path;
+	// Left at 0 rather than risking two different captures sharing a hash.
+	if (!hash_capture(prepared.metadata, prepared.desc, result.content_hash))
 	{
-		LOGE("Failed to query ID3D12Device10. AgilitySDK dlls might not be present?\n");
-		return false;
+		LOGW("Failed to read every blob of %s, it is reported without a content hash.\n", prepared.path.c_str());
+		result.content_hash = 0;
 	}
+	result.restore_policy = restore_policy_to_string(device.restore_policy);
+	result.blob_bytes = load_timings.blob_bytes;
+	result.compressed_blob_bytes = load_timings.compressed_bytes;
+	result.decompressed_blob_bytes = load_timings.decompressed_bytes;
+	result.cached_blob_bytes = load_timings.cached_bytes;
+	result.load_stages_ms = {
+		{ "pso", load_timings.pso_ms },
+		{ "pso_cold", load_timings.pso_cold_ms },
+		{ "pso_warm", load_timings.pso_warm_ms },
+		{ "create", load_timings.create_ms },
+		{ "upload", load_timings.upload_ms },
+		{ "repack", load_timings.repack_ms },
+		{ "decompress", load_timings.decompress_ms },
+		{ "descriptors", load_timings.descriptor_ms },
+		{ "wall", load_timings.wall_ms },
+	};
 
-	D3D12_FEATURE_DATA_D3D12_OPTIONS12 options12;
-	if (FAILED(device10->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS12, &options12, sizeof(options12))))
+	for (int i = 0; i < Device::TimingCount; i++)
 	{
-		LOGE("Failed to query OPTIONS12.\n");
-		return false;
+		if (device.timing_stats[i].get_count())
+		{
+			result.timings.push_back(build_report_timing(
+					cache_state_names[i], device.timing_stats[i], device.pass_timing_stats[i],
+					device.capture->plan, reject_outliers, us_per_tick));
+		}
 	}
 
-	if (!options12.RelaxedFormatCastingSupported)
+	for (int i = 0; i < Device::TimingCount; i++)
 	{
-		LOGE("RelaxedFormatCasting not supported.\n");
-		return false;
+		if (device.baseline_timing_stats[i].get_count())
+		{
+			auto name = std::string(cache_state_names[i]) + "-full-barriers";
+			result.timings.push_back(build_report_timing(
+					name.c_str(), device.baseline_timing_stats[i], {},
+					device.capture->plan, reject_outliers, us_per_tick));
+		}
 	}
 
-	return true;
+	return result;
 }
 
 int main(int argc, char **argv)
@@ -1955,6 +5492,30 @@ int main(int argc, char **argv)
 	bool validate = false;
 	bool vkd3d_proton = false;
 	unsigned iterations = 0;
+	std::string blob_io = "auto";
+	bool repack_benchmark = false;
+	std::string allocation = "packed";
+	std::string restore = "per-dispatch";
+	std::string cache_mode = "warm";
+	std::string barriers = "full";
+	unsigned cache_flush_size_mib = 0;
+	bool reject_outliers = false;
+	std::vector<std::string> reports;
+	unsigned warmup = 0;
+	bool auto_iterations = false;
+	double target_error = 1.0;
+	double time_budget = 60.0;
+	bool prefetch = true;
+	std::string pipeline_cache;
+	bool compile_benchmark = false;
+	bool shader_benchmark = false;
+	std::string convert;
+	unsigned compile_threads = std::thread::hardware_concurrency();
+	bool compress = false;
+	unsigned compression_threads = std::thread::hardware_concurrency();
+	std::string dedup;
+	unsigned blob_cache_size_mib = 1024;
+	unsigned shared_cache_size_mib = 2048;
 	Util::CLICallbacks cbs;
 
 	if (!SDL_Init(SDL_INIT_VIDEO))
@@ -1966,6 +5527,30 @@ int main(int argc, char **argv)
 	cbs.add("--validate", [&](Util::CLIParser &) { validate = true; });
 	cbs.add("--iterations", [&](Util::CLIParser &parser) { iterations = parser.next_uint(); });
 	cbs.add("--dispatches", [&](Util::CLIParser &parser) { dispatches_per_iteration = parser.next_uint(); });
+	cbs.add("--blob-io", [&](Util::CLIParser &parser) { blob_io = parser.next_string(); });
+	cbs.add("--repack-benchmark", [&](Util::CLIParser &) { repack_benchmark = true; });
+	cbs.add("--allocation", [&](Util::CLIParser &parser) { allocation = parser.next_string(); });
+	cbs.add("--restore", [&](Util::CLIParser &parser) { restore = parser.next_string(); });
+	cbs.add("--cache-mode", [&](Util::CLIParser &parser) { cache_mode = parser.next_string(); });
+	cbs.add("--barriers", [&](Util::CLIParser &parser) { barriers = parser.next_string(); });
+	cbs.add("--cache-flush-size", [&](Util::CLIParser &parser) { cache_flush_size_mib = parser.next_uint(); });
+	cbs.add("--reject-outliers", [&](Util::CLIParser &) { reject_outliers = true; });
+	cbs.add("--report", [&](Util::CLIParser &parser) { reports.push_back(parser.next_string()); });
+	cbs.add("--warmup", [&](Util::CLIParser &parser) { warmup = parser.next_uint(); });
+	cbs.add("--auto", [&](Util::CLIParser &) { auto_iterations = true; });
+	cbs.add("--target-error", [&](Util::CLIParser &parser) { target_error = parser.next_double(); });
+	cbs.add("--time-budget", [&](Util::CLIParser &parser) { time_budget = parser.next_double(); });
+	cbs.add("--no-prefetch", [&](Util::CLIParser &) { prefetch = false; });
+	cbs.add("--pipeline-cache", [&](Util::CLIParser &parser) { pipeline_cache = parser.next_string(); });
+	cbs.add("--compile-benchmark", [&](Util::CLIParser &) { compile_benchmark = true; });
+	cbs.add("--shader-benchmark", [&](Util::CLIParser &) { shader_benchmark = true; });
+	cbs.add("--compile-threads", [&](Util::CLIParser &parser) { compile_threads = parser.next_uint(); });
+	cbs.add("--convert", [&](Util::CLIParser &parser) { convert = parser.next_string(); });
+	cbs.add("--compress", [&](Util::CLIParser &) { compress = true; });
+	cbs.add("--dedup", [&](Util::CLIParser &parser) { dedup = parser.next_string(); });
+	cbs.add("--blob-cache-size", [&](Util::CLIParser &parser) { blob_cache_size_mib = parser.next_uint(); });
+	cbs.add("--shared-cache-size", [&](Util::CLIParser &parser) { shared_cache_size_mib = parser.next_uint(); });
+	cbs.add("--compression-threads", [&](Util::CLIParser &parser) { compression_threads = parser.next_uint(); });
 	cbs.add("--help", [&](Util::CLIParser &parser) { parser.end(); });
 
 	Util::CLIParser parser(std::move(cbs), argc - 1, argv + 1);
@@ -1976,16 +5561,101 @@ int main(int argc, char **argv)
 		return EXIT_FAILURE;
 	}
 
+	if (repack_benchmark)
+		return Util::run_repack_benchmark() ? EXIT_SUCCESS : EXIT_FAILURE;
+
 	if (json.empty())
 	{
-		LOGE("Need to provide path to JSON.\n");
+		LOGE("Need to provide path to JSON, a directory of captures or a manifest.\n");
 		print_help();
 		return EXIT_FAILURE;
 	}
 
+	std::vector<std::string> captures;
+	if (!collect_capture_paths(json, captures))
+		return EXIT_FAILURE;
+
+	compression_threads = std::max(1u, compression_threads);
+
+	if (!dedup.empty())
+		return dedup_captures(captures, dedup) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	if (!convert.empty())
+	{
+		Util::ContainerWriteOptions options;
+		options.compress_data = compress;
+		options.num_threads = compression_threads;
+		return convert_captures(captures, convert, options) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Only needs the shader blobs, not a device.
+	if (shader_benchmark)
+	{
+		std::vector<Util::ShaderBlobs> shaders;
+		if (!load_shader_blobs(captures, shaders) ||
+		    !Util::run_shader_compile_benchmark(shaders, compile_threads))
+			return EXIT_FAILURE;
+		return EXIT_SUCCESS;
+	}
+
 	if (d3d12.empty())
 		d3d12 = vkd3d_proton ? "d3d12core.dll" : "d3d12.dll";
 
+	auto blob_backend = Util::BlobReader::Backend::Auto;
+	if (blob_io == "auto")
+		blob_backend = Util::BlobReader::Backend::Auto;
+	else if (blob_io == "uring")
+		blob_backend = Util::BlobReader::Backend::IoUring;
+	else if (blob_io == "threads")
+		blob_backend = Util::BlobReader::Backend::Threads;
+	else if (blob_io != "mmap")
+	{
+		LOGE("Unrecognized blob IO backend \"%s\".\n", blob_io.c_str());
+		print_help();
+		return EXIT_FAILURE;
+	}
+
+	auto allocation_strategy = AllocationStrategy::Packed;
+	if (allocation == "committed")
+		allocation_strategy = AllocationStrategy::Committed;
+	else if (allocation != "packed")
+	{
+		LOGE("Unrecognized allocation strategy \"%s\".\n", allocation.c_str());
+		print_help();
+		return EXIT_FAILURE;
+	}
+
+	auto restore_policy = RestorePolicy::PerDispatch;
+	if (!parse_restore_policy(restore.c_str(), restore_policy))
+	{
+		print_help();
+		return EXIT_FAILURE;
+	}
+
+	auto device_cache_mode = Device::CacheMode::Warm;
+	if (cache_mode == "cold")
+		device_cache_mode = Device::CacheMode::Cold;
+	else if (cache_mode == "both")
+		device_cache_mode = Device::CacheMode::Both;
+	else if (cache_mode != "warm")
+	{
+		LOGE("Unrecognized cache mode \"%s\".\n", cache_mode.c_str());
+		print_help();
+		return EXIT_FAILURE;
+	}
+
+	auto barrier_mode = Device::BarrierMode::Full;
+	if (barriers == "inferred")
+		barrier_mode = Device::BarrierMode::Inferred;
+	else if (barriers == "compare")
+		barrier_mode = Device::BarrierMode::Compare;
+	else if (barriers != "full")
+	{
+		LOGE("Unrecognized barrier mode \"%s\".\n", barriers.c_str());
+		print_help();
+		return EXIT_FAILURE;
+	}
+
 	auto device = create_device(d3d12, validate, vkd3d_proton);
 	if (!device.device)
 	{
@@ -1999,8 +5669,56 @@ int main(int argc, char **argv)
 		return EXIT_FAILURE;
 	}
 
+	if (compile_benchmark)
+	{
+		std::vector<Util::ShaderBlobs> shaders;
+		if (!load_shader_blobs(captures, shaders) ||
+		    !run_compile_benchmark(device.device.get(), shaders, compile_threads))
+			return EXIT_FAILURE;
+		return EXIT_SUCCESS;
+	}
+
+	if (!device.init_allocators(allocation_strategy))
+	{
+		LOGE("Failed to initialize resource allocators.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (blob_io != "mmap")
+		device.blob_reader = Util::BlobReader::create(blob_backend);
+	device.decompress_threads = compression_threads;
+	// Only captures replayed later can hit the cache. With a single capture, blobs go straight into staging memory.
+	if (captures.size() < 2)
+		blob_cache_size_mib = 0;
+	if (blob_cache_size_mib)
+		device.blob_cache.reset(new Util::BlobCache(uint64_t(blob_cache_size_mib) * 1024 * 1024));
+	// Sharing only pays off when a later capture can reuse what an earlier one created.
+	// Shared resources are committed allocations, so a single capture keeps its heap placement.
+	if (captures.size() < 2)
+		shared_cache_size_mib = 0;
+	if (shared_cache_size_mib)
+		device.shared_objects.reset(new SharedObjectCache(uint64_t(shared_cache_size_mib) * 1024 * 1024));
+	device.restore_policy = restore_policy;
+
+	if (!pipeline_cache.empty())
+	{
+		device.pipeline_cache.reset(new PipelineCache);
+		if (!device.pipeline_cache->init(device.device.get(), pipeline_cache,
+		                                 get_pipeline_cache_identity(device.device.get(), d3d12)))
+			return EXIT_FAILURE;
+	}
+
+	device.cache_mode = device_cache_mode;
+	device.barrier_mode = barrier_mode;
+	uint64_t cache_flush_size = cache_flush_size_mib ?
+	                            uint64_t(cache_flush_size_mib) * 1024 * 1024 :
+	                            get_default_cache_flush_size(device.device.get());
+	if (!device.init_cache_flush(cache_flush_size))
+		return EXIT_FAILURE;
+
+	// Only an open-ended interactive run gets a window, --auto decides the iteration count on its own.
 	SDL_Window *window = nullptr;
-	if (iterations == 0)
+	if (iterations == 0 && !auto_iterations)
 		window = SDL_CreateWindow("d3d12-replayer", 512, 512, 0);
 
 	if (window)
@@ -2022,96 +5740,144 @@ int main(int argc, char **argv)
 		}
 	}
 
-	rapidjson::Document doc;
-	auto json_data = load_binary_file<char>(json);
-	if (json_data.empty())
-		return EXIT_FAILURE;
-
-	doc.Parse(json_data.data(), json_data.size());
-	if (doc.HasParseError())
+	if (!device.calibrate_timestamp_overhead())
 	{
-		LOGE("Parse error: %d\n", doc.GetParseError());
+		LOGE("Failed to calibrate timestamp overhead.\n");
 		return EXIT_FAILURE;
 	}
 
-	if (!doc.HasMember("CS") || !doc.HasMember("RootSignature"))
+	UINT64 freq = 0;
+	if (FAILED(device.queue->GetTimestampFrequency(&freq)) || !freq)
 	{
-		LOGE("Must define \"CS\" and \"RootSignature\".\n");
+		LOGE("Failed to query timestamp frequency.\n");
 		return EXIT_FAILURE;
 	}
 
-	device.cs = device.create_compute_shader(
-			relpath(json, doc["CS"].GetString()),
-			relpath(json, doc["RootSignature"].GetString()));
+	double us_per_tick = 1e6 / double(freq);
+	LOGI("Timestamp overhead: %.3f us, subtracted from every sample.\n",
+	     double(device.timestamp_overhead) * us_per_tick);
 
-	if (!device.cs.pso)
-	{
-		LOGE("Failed to create CS.\n");
-		return EXIT_FAILURE;
-	}
+	ReplaySettings settings;
+	settings.iterations = iterations;
+	settings.dispatches_per_iteration = dispatches_per_iteration;
+	settings.warmup = warmup;
+	settings.auto_iterations = auto_iterations;
+	settings.target_error = target_error;
+	settings.time_budget = time_budget;
 
-	if (!doc.HasMember("Resources"))
+	Util::IOGate io_gate;
+	if (prefetch && captures.size() > 1)
 	{
-		LOGE("Must specify resources.\n");
-		return EXIT_FAILURE;
+		device.io_gate = &io_gate;
+		if (device.blob_reader)
+			device.blob_reader->set_gate(&io_gate);
 	}
 
-	if (!device.load_resources(json, doc["Resources"]))
-		return EXIT_FAILURE;
+	// Captures failing to load are skipped, the rest of the suite still runs.
+	std::vector<Util::CaptureResult> results;
+	uint32_t num_failed = 0;
+	bool alive = true;
 
-	if (!device.allocate_descriptor_heaps(doc))
-	{
-		LOGE("Failed to allocate descriptor heaps.\n");
-		return EXIT_FAILURE;
-	}
+	auto start_prepare = [&](size_t index) {
+		return std::async(prefetch ? std::launch::async : std::launch::deferred,
+		                  prepare_capture, device.create_capture(), captures[index]);
+	};
 
-	if (!device.create_descriptors(doc))
-	{
-		LOGE("Failed to create descriptors.\n");
-		return EXIT_FAILURE;
-	}
+	auto next_capture = start_prepare(0);
 
-	if (window)
+	for (size_t i = 0; i < captures.size() && alive; i++)
 	{
-		bool alive = true;
-		while (alive)
+		auto prepared = next_capture.get();
+
+		// The next capture loads while this one replays.
+		if (i + 1 < captures.size())
+			next_capture = start_prepare(i + 1);
+
+		auto &path = prepared->path;
+		if (captures.size() > 1)
 		{
-			SDL_Event e;
-			while (SDL_PollEvent(&e))
-				if (e.type == SDL_EVENT_QUIT)
-					alive = false;
+			LOGI("Replaying capture %zu / %zu: %s\n", i + 1, captures.size(), path.c_str());
+			if (window)
+				LOGI("Press space to move on to the next capture.\n");
+		}
 
-			if (!device.execute_iteration(doc, dispatches_per_iteration))
-			{
-				LOGE("Failed to execute iteration.\n");
-				return EXIT_FAILURE;
-			}
+		if (!prepared->capture)
+		{
+			LOGE("Failed to load capture \"%s\".\n", path.c_str());
+			num_failed++;
+			continue;
 		}
-	}
-	else
-	{
-		for (uint32_t iter = 0; iter < iterations; iter++)
+
+		device.set_capture(std::move(prepared->capture));
+
+		if (!replay_capture(device, settings, window, alive))
+			return EXIT_FAILURE;
+
+		log_capture_stats(device, reject_outliers, us_per_tick);
+
+		if (!reports.empty())
 		{
-			if (!device.execute_iteration(doc, dispatches_per_iteration))
-			{
-				LOGE("Failed to execute iteration.\n");
-				return EXIT_FAILURE;
-			}
+			results.push_back(build_capture_result(*prepared, device, reject_outliers, us_per_tick));
 		}
 	}
 
-	UINT64 freq = 0;
-	if (SUCCEEDED(device.queue->GetTimestampFrequency(&freq)))
+	// A prefetch abandoned by closing the window still has to finish before the device goes away.
+	if (prefetch && next_capture.valid())
+		next_capture.wait();
+	device.release_capture();
+
+	if (device.pipeline_cache)
+		device.pipeline_cache->flush();
+
+	if (captures.size() > 1)
 	{
-		LOGI("Total ticks: %llu, total timestamps: %llu\n",
-		     static_cast<unsigned long long>(device.total_ticks),
-		     static_cast<unsigned long long>(device.total_dispatches));
-		LOGI("Total time per dispatch: %.3f us\n",
-		     1e6 * double(device.total_ticks) / (double(device.total_dispatches) * double(freq)));
+		LOGI("Replayed %zu of %zu captures, %u failed to load.\n",
+		     captures.size() - num_failed, captures.size(), num_failed);
+	}
+
+	if (!results.empty())
+	{
+		Util::ReportEnvironment env;
+		fill_report_environment(env, device.device.get(), device.queue.get());
+		env.d3d12_module = d3d12;
+
+		for (int i = 0; i < argc; i++)
+		{
+			if (i)
+				env.command_line += ' ';
+			env.command_line += argv[i];
+		}
+
+		env.settings = {
+			{ "Iterations", std::to_string(iterations) },
+			{ "Dispatches", std::to_string(dispatches_per_iteration) },
+			{ "BlobIO", blob_io },
+			{ "Allocation", allocation },
+			{ "Restore", restore },
+			{ "CacheMode", cache_mode },
+			{ "Barriers", barriers },
+			{ "CacheFlushSize", std::to_string(cache_flush_size) },
+			{ "RejectOutliers", reject_outliers ? "true" : "false" },
+			{ "Validate", validate ? "true" : "false" },
+			{ "Warmup", std::to_string(warmup) },
+			{ "Auto", auto_iterations ? "true" : "false" },
+			{ "TargetError", std::to_string(target_error) },
+			{ "TimeBudget", std::to_string(time_budget) },
+			{ "Prefetch", prefetch ? "true" : "false" },
+			{ "PipelineCache", pipeline_cache },
+			{ "CompressionThreads", std::to_string(compression_threads) },
+			{ "BlobCacheSize", std::to_string(blob_cache_size_mib) },
+			{ "SharedCacheSize", std::to_string(shared_cache_size_mib) },
+		};
+
+		for (auto &report : reports)
+			if (!Util::write_report(report, env, results))
+				return EXIT_FAILURE;
 	}
 
 	device.wait_idle();
 	device.teardown_swapchain();
 	SDL_DestroyWindow(window);
 	SDL_Quit();
+	return num_failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -0,0 +1,136 @@
+/* Copyright (c) 2025 Hans-Kristian Arntzen for Valve Corporation
+ * SPDX-License-Identifier: MIT
+ */
+
+#define NOMINMAX
+#include "file_mapping.hpp"
+#include "logging.hpp"
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include "path_utils.hpp"
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Util
+{
+FileMapping::~FileMapping()
+{
+	unmap();
+}
+
+FileMapping::FileMapping(FileMapping &&other) noexcept
+{
+	*this = std::move(other);
+}
+
+FileMapping &FileMapping::operator=(FileMapping &&other) noexcept
+{
+	if (this != &other)
+	{
+		unmap();
+		std::swap(ptr, other.ptr);
+		std::swap(len, other.len);
+#ifdef _WIN32
+		std::swap(mapping_handle, other.mapping_handle);
+#endif
+	}
+	return *this;
+}
+
+void FileMapping::unmap()
+{
+#ifdef _WIN32
+	if (ptr)
+		UnmapViewOfFile(ptr);
+	if (mapping_handle)
+		CloseHandle(mapping_handle);
+	mapping_handle = nullptr;
+#else
+	if (ptr)
+		munmap(const_cast<uint8_t *>(ptr), len);
+#endif
+	ptr = nullptr;
+	len = 0;
+}
+
+bool FileMapping::map(const std::string &path)
+{
+	unmap();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileW(Granite::Path::to_utf16(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+	                          OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		LOGE("Failed to open file: %s\n", path.c_str());
+		return false;
+	}
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		LOGE("Failed to query size of %s, or file is empty.\n", path.c_str());
+		return false;
+	}
+
+	mapping_handle = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+
+	if (!mapping_handle)
+	{
+		LOGE("Failed to create file mapping for %s.\n", path.c_str());
+		return false;
+	}
+
+	ptr = static_cast<const uint8_t *>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+	if (!ptr)
+	{
+		LOGE("Failed to map %s.\n", path.c_str());
+		unmap();
+		return false;
+	}
+
+	len = size_t(file_size.QuadPart);
+#else
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		LOGE("Failed to open file: %s\n", path.c_str());
+		return false;
+	}
+
+	struct stat s = {};
+	if (fstat(fd, &s) < 0 || s.st_size == 0)
+	{
+		close(fd);
+		LOGE("Failed to query size of %s, or file is empty.\n", path.c_str());
+		return false;
+	}
+
+	void *mapped = mmap(nullptr, size_t(s.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (mapped == MAP_FAILED)
+	{
+		LOGE("Failed to map %s.\n", path.c_str());
+		return false;
+	}
+
+	// Blobs are consumed front to back exactly once.
+	madvise(mapped, size_t(s.st_size), MADV_SEQUENTIAL);
+
+	ptr = static_cast<const uint8_t *>(mapped);
+	len = size_t(s.st_size);
+#endif
+
+	return true;
+}
+}
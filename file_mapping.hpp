@@ -0,0 +1,38 @@
+/* Copyright (c) 2025 Hans-Kristian Arntzen for Valve Corporation
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace Util
+{
+// Read-only view of a whole file, backed by the page cache.
+class FileMapping
+{
+public:
+	FileMapping() = default;
+	~FileMapping();
+
+	FileMapping(FileMapping &&other) noexcept;
+	FileMapping &operator=(FileMapping &&other) noexcept;
+	FileMapping(const FileMapping &) = delete;
+	void operator=(const FileMapping &) = delete;
+
+	bool map(const std::string &path);
+	void unmap();
+
+	const uint8_t *data() const { return ptr; }
+	size_t size() const { return len; }
+
+private:
+	const uint8_t *ptr = nullptr;
+	size_t len = 0;
+#ifdef _WIN32
+	void *mapping_handle = nullptr;
+#endif
+};
+}
@@ -29,6 +29,9 @@
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 #else
+#include <dirent.h>
+#include <stdio.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #ifdef __linux__
 #include <linux/limits.h>
@@ -128,6 +131,35 @@ bool is_root_path(const std::string &path)
 	return index != std::string::npos && (index + 3) == path.size();
 }
 
+std::string make_relative(const std::string &dir, const std::string &path)
+{
+	if (is_abspath(dir) != is_abspath(path))
+		return path;
+
+	auto dir_parts = Util::split_no_empty(canonicalize_path(dir), "/");
+	auto path_parts = Util::split_no_empty(canonicalize_path(path), "/");
+
+	size_t common = 0;
+	while (common < dir_parts.size() && common < path_parts.size() && dir_parts[common] == path_parts[common])
+		common++;
+
+	std::string res;
+	for (size_t i = common; i < dir_parts.size(); i++)
+		res += "../";
+	for (size_t i = common; i < path_parts.size(); i++)
+	{
+		res += path_parts[i];
+		if (i + 1 < path_parts.size())
+			res += "/";
+	}
+
+	if (res.empty())
+		return ".";
+	if (res.back() == '/')
+		res.pop_back();
+	return res;
+}
+
 std::string join(const std::string &base, const std::string &path)
 {
 	if (base.empty())
@@ -245,6 +277,74 @@ std::string get_executable_path()
 #endif
 }
 
+bool is_directory(const std::string &path)
+{
+#ifdef _WIN32
+	DWORD attr = GetFileAttributesW(to_utf16(path).c_str());
+	return attr != INVALID_FILE_ATTRIBUTES && (attr & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+	struct stat s;
+	return stat(path.c_str(), &s) == 0 && S_ISDIR(s.st_mode);
+#endif
+}
+
+bool make_directory(const std::string &path)
+{
+#ifdef _WIN32
+	if (CreateDirectoryW(to_utf16(path).c_str(), nullptr))
+		return true;
+#else
+	if (mkdir(path.c_str(), 0755) == 0)
+		return true;
+#endif
+	return is_directory(path);
+}
+
+bool replace_file(const std::string &src, const std::string &dst)
+{
+#ifdef _WIN32
+	return MoveFileExW(to_utf16(src).c_str(), to_utf16(dst).c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(src.c_str(), dst.c_str()) == 0;
+#endif
+}
+
+bool list_directory_files(const std::string &path, std::vector<std::string> &files)
+{
+	files.clear();
+
+#ifdef _WIN32
+	WIN32_FIND_DATAW data;
+	HANDLE handle = FindFirstFileW(to_utf16(join(path, "*")).c_str(), &data);
+	if (handle == INVALID_HANDLE_VALUE)
+		return false;
+
+	do
+	{
+		if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+			files.push_back(to_utf8(data.cFileName, wcslen(data.cFileName)));
+	} while (FindNextFileW(handle, &data));
+
+	FindClose(handle);
+#else
+	DIR *dir = opendir(path.c_str());
+	if (!dir)
+		return false;
+
+	while (auto *entry = readdir(dir))
+	{
+		struct stat s;
+		if (stat(join(path, entry->d_name).c_str(), &s) == 0 && S_ISREG(s.st_mode))
+			files.push_back(entry->d_name);
+	}
+
+	closedir(dir);
+#endif
+
+	std::sort(files.begin(), files.end());
+	return true;
+}
+
 #ifdef _WIN32
 std::string to_utf8(const wchar_t *wstr, size_t len)
 {
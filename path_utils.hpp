@@ -23,6 +23,7 @@
 #pragma once
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace Granite
 {
@@ -38,9 +39,20 @@ std::pair<std::string, std::string> protocol_split(const std::string &path);
 bool is_abspath(const std::string &path);
 bool is_root_path(const std::string &path);
 std::string canonicalize_path(const std::string &path);
+// Path leading from the directory dir to path. Both must be absolute or relative to the same directory,
+// otherwise path is returned as is.
+std::string make_relative(const std::string &dir, const std::string &path);
 std::string enforce_protocol(const std::string &path);
 std::string get_executable_path();
 
+bool is_directory(const std::string &path);
+// Creates a single directory level. Succeeds if it already exists.
+bool make_directory(const std::string &path);
+// Atomically replaces dst with src, so readers see either the old or the new file.
+bool replace_file(const std::string &src, const std::string &dst);
+// Names of the regular files directly inside path, sorted. Does not recurse.
+bool list_directory_files(const std::string &path, std::vector<std::string> &files);
+
 #ifdef _WIN32
 std::string to_utf8(const wchar_t *wstr, size_t len);
 std::wstring to_utf16(const char *str, size_t len);
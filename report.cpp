@@ -0,0 +1,357 @@
+/* Copyright (c) 2025 Hans-Kristian Arntzen for Valve Corporation
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "report.hpp"
+#include "logging.hpp"
+#include "rapidjson/prettywriter.h"
+#include "rapidjson/stringbuffer.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace Util
+{
+static std::string hash_to_string(Hash hash)
+{
+	char str[17];
+	snprintf(str, sizeof(str), "%016" PRIx64, hash);
+	return str;
+}
+
+static bool ends_with(const std::string &str, const char *suffix)
+{
+	size_t len = strlen(suffix);
+	return str.size() >= len && str.compare(str.size() - len, len, suffix) == 0;
+}
+
+template <typename Writer>
+static void write_summary(Writer &writer, const TimingStats::Summary &summary)
+{
+	writer.StartObject();
+	writer.Key("Count");
+	writer.Uint64(summary.count);
+	writer.Key("Rejected");
+	writer.Uint64(summary.rejected);
+	writer.Key("Exact");
+	writer.Bool(summary.exact);
+	writer.Key("Mean");
+	writer.Double(summary.mean);
+	writer.Key("Stddev");
+	writer.Double(summary.stddev);
+	writer.Key("Min");
+	writer.Double(summary.min);
+	writer.Key("P50");
+	writer.Double(summary.p50);
+	writer.Key("P90");
+	writer.Double(summary.p90);
+	writer.Key("P99");
+	writer.Double(summary.p99);
+	writer.Key("Max");
+	writer.Double(summary.max);
+	writer.EndObject();
+}
+
+static std::string build_json(const ReportEnvironment &env, const std::vector<CaptureResult> &results)
+{
+	rapidjson::StringBuffer buffer;
+	rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+
+	writer.StartObject();
+
+	writer.Key("Environment");
+	writer.StartObject();
+	writer.Key("CommandLine");
+	writer.String(env.command_line);
+	writer.Key("D3D12Module");
+	writer.String(env.d3d12_module);
+	writer.Key("AdapterDescription");
+	writer.String(env.adapter_description);
+	writer.Key("AdapterLuid");
+	writer.String(hash_to_string(env.adapter_luid));
+	writer.Key("AdapterVendorId");
+	writer.Uint(env.adapter_vendor_id);
+	writer.Key("AdapterDeviceId");
+	writer.Uint(env.adapter_device_id);
+	writer.Key("TimestampFrequency");
+	writer.Uint64(env.timestamp_frequency);
+	writer.Key("Settings");
+	writer.StartObject();
+	for (auto &setting : env.settings)
+	{
+		writer.Key(setting.first.c_str());
+		writer.String(setting.second);
+	}
+	writer.EndObject();
+	writer.EndObject();
+
+	writer.Key("Captures");
+	writer.StartArray();
+	for (auto &result : results)
+	{
+		writer.StartObject();
+		writer.Key("Path");
+		writer.String(result.path);
+		writer.Key("ContentHash");
+		writer.String(hash_to_string(result.content_hash));
+		writer.Key("RestorePolicy");
+		writer.String(result.restore_policy);
+		writer.Key("BlobBytes");
+		writer.Uint64(result.blob_bytes);
+		writer.Key("CompressedBlobBytes");
+		writer.Uint64(result.compressed_blob_bytes);
+		writer.Key("DecompressedBlobBytes");
+		writer.Uint64(result.decompressed_blob_bytes);
+		writer.Key("CachedBlobBytes");
+		writer.Uint64(result.cached_blob_bytes);
+
+		writer.Key("LoadStagesMs");
+		writer.StartObject();
+		for (auto &stage : result.load_stages_ms)
+		{
+			writer.Key(stage.first.c_str());
+			writer.Double(stage.second);
+		}
+		writer.EndObject();
+
+		writer.Key("TimingsUs");
+		writer.StartObject();
+		for (auto &timing : result.timings)
+		{
+			writer.Key(timing.cache_state.c_str());
+			writer.StartObject();
+			writer.Key("Summary");
+			write_summary(writer, timing.summary);
+			writer.Key("Samples");
+			writer.StartArray();
+			for (auto sample : timing.samples)
+				writer.Double(sample);
+			writer.EndArray();
+
+			if (!timing.passes.empty())
+			{
+				writer.Key("Passes");
+				writer.StartArray();
+				for (auto &pass : timing.passes)
+				{
+					writer.StartObject();
+					writer.Key("Name");
+					writer.String(pass.name);
+					writer.Key("Summary");
+					write_summary(writer, pass.summary);
+					writer.EndObject();
+				}
+				writer.EndArray();
+			}
+
+			writer.EndObject();
+		}
+		writer.EndObject();
+
+		writer.EndObject();
+	}
+	writer.EndArray();
+
+	writer.EndObject();
+	return std::string(buffer.GetString(), buffer.GetSize());
+}
+
+static std::string csv_escape(const std::string &str)
+{
+	std::string escaped = "\"";
+	for (auto c : str)
+	{
+		if (c == '"')
+			escaped += '"';
+		escaped += c;
+	}
+	escaped += '"';
+	return escaped;
+}
+
+static std::string build_csv(const std::vector<CaptureResult> &results)
+{
+	std::string csv = "capture,content_hash,cache_state,pass,restore_policy,count,rejected,exact,"
+	                  "mean_us,stddev_us,min_us,p50_us,p90_us,p99_us,max_us\n";
+	char line[512];
+
+	// The whole dispatch is reported as pass "total", followed by the individual passes if there are several.
+	auto add_row = [&](const CaptureResult &result, const ReportTiming &timing,
+	                   const std::string &pass, const TimingStats::Summary &s) {
+		snprintf(line, sizeof(line), ",%s,%s,", hash_to_string(result.content_hash).c_str(), timing.cache_state.c_str());
+		csv += csv_escape(result.path);
+		csv += line;
+		csv += csv_escape(pass);
+		snprintf(line, sizeof(line), ",%s,%" PRIu64 ",%" PRIu64 ",%d,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n",
+		         result.restore_policy.c_str(), s.count, s.rejected, int(s.exact),
+		         s.mean, s.stddev, s.min, s.p50, s.p90, s.p99, s.max);
+		csv += line;
+	};
+
+	for (auto &result : results)
+	{
+		for (auto &timing : result.timings)
+		{
+			add_row(result, timing, "total", timing.summary);
+			for (auto &pass : timing.passes)
+				add_row(result, timing, pass.name, pass.summary);
+		}
+	}
+
+	return csv;
+}
+
+static std::string openmetrics_escape(const std::string &str)
+{
+	std::string escaped;
+	for (auto c : str)
+	{
+		if (c == '\\' || c == '"')
+			escaped += '\\';
+		if (c == '\n')
+			escaped += "\\n";
+		else
+			escaped += c;
+	}
+	return escaped;
+}
+
+static std::string build_openmetrics(const ReportEnvironment &env, const std::vector<CaptureResult> &results)
+{
+	std::string text;
+	char value[64];
+
+	auto sample = [&](const char *name, const std::string &labels, double v) {
+		snprintf(value, sizeof(value), " %.10g\n", v);
+		text += name;
+		text += "{" + labels + "}";
+		text += value;
+	};
+
+	text += "# TYPE d3d12_replayer_environment info\n";
+	sample("d3d12_replayer_environment_info",
+	       "adapter=\"" + openmetrics_escape(env.adapter_description) +
+	       "\",adapter_luid=\"" + hash_to_string(env.adapter_luid) +
+	       "\",d3d12_module=\"" + openmetrics_escape(env.d3d12_module) + "\"", 1.0);
+
+	text += "# TYPE d3d12_replayer_dispatch_time_microseconds summary\n";
+	text += "# UNIT d3d12_replayer_dispatch_time_microseconds microseconds\n";
+	for (auto &result : results)
+	{
+		for (auto &timing : result.timings)
+		{
+			auto labels = "capture=\"" + openmetrics_escape(result.path) +
+			              "\",content_hash=\"" + hash_to_string(result.content_hash) +
+			              "\",cache=\"" + timing.cache_state +
+			              "\",restore=\"" + result.restore_policy + "\"";
+			auto &s = timing.summary;
+			sample("d3d12_replayer_dispatch_time_microseconds", labels + ",quantile=\"0.5\"", s.p50);
+			sample("d3d12_replayer_dispatch_time_microseconds", labels + ",quantile=\"0.9\"", s.p90);
+			sample("d3d12_replayer_dispatch_time_microseconds", labels + ",quantile=\"0.99\"", s.p99);
+			sample("d3d12_replayer_dispatch_time_microseconds_sum", labels, s.mean * double(s.count));
+			sample("d3d12_replayer_dispatch_time_microseconds_count", labels, double(s.count));
+		}
+	}
+
+	bool has_passes = false;
+	for (auto &result : results)
+		for (auto &timing : result.timings)
+			has_passes = has_passes || !timing.passes.empty();
+
+	if (has_passes)
+	{
+		text += "# TYPE d3d12_replayer_pass_time_microseconds summary\n";
+		text += "# UNIT d3d12_replayer_pass_time_microseconds microseconds\n";
+		for (auto &result : results)
+		{
+			for (auto &timing : result.timings)
+			{
+				for (auto &pass : timing.passes)
+				{
+					auto labels = "capture=\"" + openmetrics_escape(result.path) +
+					              "\",cache=\"" + timing.cache_state +
+					              "\",pass=\"" + openmetrics_escape(pass.name) + "\"";
+					auto &s = pass.summary;
+					sample("d3d12_replayer_pass_time_microseconds", labels + ",quantile=\"0.5\"", s.p50);
+					sample("d3d12_replayer_pass_time_microseconds", labels + ",quantile=\"0.9\"", s.p90);
+					sample("d3d12_replayer_pass_time_microseconds", labels + ",quantile=\"0.99\"", s.p99);
+					sample("d3d12_replayer_pass_time_microseconds_sum", labels, s.mean * double(s.count));
+					sample("d3d12_replayer_pass_time_microseconds_count", labels, double(s.count));
+				}
+			}
+		}
+	}
+
+	struct
+	{
+		const char *name;
+		double TimingStats::Summary::*member;
+	} gauges[] = {
+		{ "d3d12_replayer_dispatch_time_min_microseconds", &TimingStats::Summary::min },
+		{ "d3d12_replayer_dispatch_time_max_microseconds", &TimingStats::Summary::max },
+		{ "d3d12_replayer_dispatch_time_stddev_microseconds", &TimingStats::Summary::stddev },
+	};
+
+	for (auto &gauge : gauges)
+	{
+		text += std::string("# TYPE ") + gauge.name + " gauge\n";
+		text += std::string("# UNIT ") + gauge.name + " microseconds\n";
+		for (auto &result : results)
+		{
+			for (auto &timing : result.timings)
+			{
+				sample(gauge.name,
+				       "capture=\"" + openmetrics_escape(result.path) +
+				       "\",cache=\"" + timing.cache_state + "\"",
+				       timing.summary.*gauge.member);
+			}
+		}
+	}
+
+	text += "# TYPE d3d12_replayer_load_stage_milliseconds gauge\n";
+	text += "# UNIT d3d12_replayer_load_stage_milliseconds milliseconds\n";
+	for (auto &result : results)
+	{
+		for (auto &stage : result.load_stages_ms)
+		{
+			sample("d3d12_replayer_load_stage_milliseconds",
+			       "capture=\"" + openmetrics_escape(result.path) + "\",stage=\"" + stage.first + "\"",
+			       stage.second);
+		}
+	}
+
+	text += "# EOF\n";
+	return text;
+}
+
+bool write_report(const std::string &path, const ReportEnvironment &env, const std::vector<CaptureResult> &results)
+{
+	std::string contents;
+	if (ends_with(path, ".csv"))
+		contents = build_csv(results);
+	else if (ends_with(path, ".prom") || ends_with(path, ".om"))
+		contents = build_openmetrics(env, results);
+	else
+		contents = build_json(env, results);
+
+	FILE *file = fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		LOGE("Failed to open report %s for writing.\n", path.c_str());
+		return false;
+	}
+
+	bool success = fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+	if (fclose(file) != 0)
+		success = false;
+
+	if (!success)
+	{
+		LOGE("Failed to write report %s.\n", path.c_str());
+		return false;
+	}
+
+	LOGI("Wrote report to %s.\n", path.c_str());
+	return true;
+}
+}
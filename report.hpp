@@ -0,0 +1,63 @@
+/* Copyright (c) 2025 Hans-Kristian Arntzen for Valve Corporation
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include "hash.hpp"
+#include "timing_stats.hpp"
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Util
+{
+// Times are in microseconds.
+struct ReportPassTiming
+{
+	std::string name;
+	TimingStats::Summary summary;
+};
+
+struct ReportTiming
+{
+	std::string cache_state;
+	// Covers every pass of the dispatch.
+	TimingStats::Summary summary;
+	// In submission order. Empty once the stats fell back to a sketch.
+	std::vector<double> samples;
+	// Per pass in recording order, only for captures with more than one.
+	std::vector<ReportPassTiming> passes;
+};
+
+struct CaptureResult
+{
+	std::string path;
+	Hash content_hash = 0;
+	std::string restore_policy;
+	uint64_t blob_bytes = 0;
+	// Subset of blob_bytes stored as compressed blobs, and what they decompressed to.
+	uint64_t compressed_blob_bytes = 0;
+	uint64_t decompressed_blob_bytes = 0;
+	// Content-addressed blobs taken from memory instead of being read, not part of blob_bytes.
+	uint64_t cached_blob_bytes = 0;
+	std::vector<std::pair<std::string, double>> load_stages_ms;
+	std::vector<ReportTiming> timings;
+};
+
+struct ReportEnvironment
+{
+	std::string command_line;
+	std::vector<std::pair<std::string, std::string>> settings;
+	std::string d3d12_module;
+	std::string adapter_description;
+	uint64_t adapter_luid = 0;
+	uint32_t adapter_vendor_id = 0;
+	uint32_t adapter_device_id = 0;
+	uint64_t timestamp_frequency = 0;
+};
+
+// Format is picked from the extension: .csv for CSV, .prom or .om for OpenMetrics text, JSON otherwise.
+bool write_report(const std::string &path, const ReportEnvironment &env, const std::vector<CaptureResult> &results);
+}
@@ -0,0 +1,159 @@
+/* Copyright (c) 2025 Hans-Kristian Arntzen for Valve Corporation
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "root_signature.hpp"
+#include "logging.hpp"
+#include <algorithm>
+#include <string.h>
+
+namespace Util
+{
+static constexpr uint32_t make_fourcc(char a, char b, char c, char d)
+{
+	return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) | (uint32_t(uint8_t(c)) << 16) | (uint32_t(uint8_t(d)) << 24);
+}
+
+static constexpr uint32_t FourCCDXBC = make_fourcc('D', 'X', 'B', 'C');
+static constexpr uint32_t FourCCRTS0 = make_fourcc('R', 'T', 'S', '0');
+
+// Bounds checked little-endian reads, offsets relative to the start of the blob.
+class BlobView
+{
+public:
+	BlobView(const uint8_t *data_, size_t size_)
+		: data(data_), size(size_)
+	{
+	}
+
+	bool read_u32(size_t offset, uint32_t &value) const
+	{
+		if (offset > size || size - offset < sizeof(uint32_t))
+			return false;
+		memcpy(&value, data + offset, sizeof(value));
+		return true;
+	}
+
+	bool sub_view(size_t offset, size_t sub_size, BlobView &view) const
+	{
+		if (offset > size || size - offset < sub_size)
+			return false;
+		view = BlobView(data + offset, sub_size);
+		return true;
+	}
+
+private:
+	const uint8_t *data;
+	size_t size;
+};
+
+static bool find_rts0(const BlobView &container, BlobView &rts0)
+{
+	// Magic, 16 byte checksum, version, total size, then the part count and offsets.
+	uint32_t num_parts;
+	if (!container.read_u32(28, num_parts))
+		return false;
+
+	for (uint32_t i = 0; i < num_parts; i++)
+	{
+		uint32_t part_offset, fourcc, part_size;
+		if (!container.read_u32(32 + 4 * size_t(i), part_offset) ||
+		    !container.read_u32(part_offset, fourcc) ||
+		    !container.read_u32(part_offset + 4, part_size))
+		{
+			return false;
+		}
+
+		if (fourcc == FourCCRTS0)
+			return container.sub_view(part_offset + 8, part_size, rts0);
+	}
+
+	return false;
+}
+
+static bool parse_table(const BlobView &rts0, uint32_t version, uint32_t payload_offset, RootParameterLayout &param)
+{
+	uint32_t num_ranges, ranges_offset;
+	if (!rts0.read_u32(payload_offset, num_ranges) || !rts0.read_u32(payload_offset + 4, ranges_offset))
+		return false;
+
+	// 1.1 added a flags member ahead of the table offset.
+	size_t range_stride = version >= 2 ? 24 : 20;
+	size_t offset_member = version >= 2 ? 20 : 16;
+	uint64_t next_offset = 0;
+
+	for (uint32_t i = 0; i < num_ranges; i++)
+	{
+		size_t range = ranges_offset + range_stride * i;
+		uint32_t type, count, offset;
+		if (!rts0.read_u32(range, type) || !rts0.read_u32(range + 4, count) ||
+		    !rts0.read_u32(range + offset_member, offset) || type > 3)
+		{
+			return false;
+		}
+
+		RootDescriptorRange desc_range;
+		desc_range.type = RootDescriptorRange::Type(type);
+		desc_range.num_descriptors = count;
+		// D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND.
+		desc_range.offset = offset == UINT32_MAX ? uint32_t(next_offset) : offset;
+
+		if (count == RootDescriptorRange::Unbounded)
+			next_offset = UINT32_MAX;
+		else
+			next_offset = std::min<uint64_t>(uint64_t(desc_range.offset) + count, UINT32_MAX);
+
+		param.ranges.push_back(desc_range);
+	}
+
+	return true;
+}
+
+bool parse_root_signature(const void *data, size_t size, RootSignatureLayout &layout)
+{
+	layout = {};
+
+	BlobView blob(static_cast<const uint8_t *>(data), size);
+	BlobView rts0 = blob;
+
+	uint32_t magic;
+	if (!blob.read_u32(0, magic))
+		return false;
+
+	if (magic == FourCCDXBC && !find_rts0(blob, rts0))
+	{
+		LOGW("Failed to find RTS0 part in root signature container.\n");
+		return false;
+	}
+
+	uint32_t version, num_params, params_offset;
+	if (!rts0.read_u32(0, version) || !rts0.read_u32(4, num_params) || !rts0.read_u32(8, params_offset))
+		return false;
+
+	if (version < 1 || version > 3)
+	{
+		LOGW("Unrecognized root signature version %u.\n", version);
+		return false;
+	}
+
+	layout.parameters.resize(num_params);
+	for (uint32_t i = 0; i < num_params; i++)
+	{
+		// Type, visibility, payload offset.
+		size_t header = params_offset + 12 * size_t(i);
+		uint32_t type, payload_offset;
+		if (!rts0.read_u32(header, type) || !rts0.read_u32(header + 8, payload_offset) || type > 4)
+			return false;
+
+		auto &param = layout.parameters[i];
+		param.type = RootParameterLayout::Type(type);
+		if (param.type == RootParameterLayout::Type::DescriptorTable &&
+		    !parse_table(rts0, version, payload_offset, param))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+}
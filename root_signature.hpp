@@ -0,0 +1,55 @@
+/* Copyright (c) 2025 Hans-Kristian Arntzen for Valve Corporation
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace Util
+{
+// Just enough of a serialized root signature to tell which descriptors a table covers.
+struct RootDescriptorRange
+{
+	enum class Type
+	{
+		SRV,
+		UAV,
+		CBV,
+		Sampler
+	};
+
+	enum { Unbounded = UINT32_MAX };
+
+	Type type;
+	uint32_t num_descriptors;
+	// From the start of the table, appended ranges already resolved.
+	uint32_t offset;
+};
+
+struct RootParameterLayout
+{
+	enum class Type
+	{
+		DescriptorTable,
+		Constants,
+		CBV,
+		SRV,
+		UAV
+	};
+
+	Type type;
+	std::vector<RootDescriptorRange> ranges;
+};
+
+struct RootSignatureLayout
+{
+	std::vector<RootParameterLayout> parameters;
+};
+
+// Accepts a DXBC container with an RTS0 part, as written by D3D12SerializeRootSignature
+// or embedded in a shader, as well as a bare RTS0 blob. Versions 1.0 to 1.2 are understood.
+bool parse_root_signature(const void *data, size_t size, RootSignatureLayout &layout);
+}
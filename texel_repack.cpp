@@ -0,0 +1,385 @@
+/* Copyright (c) 2025 Hans-Kristian Arntzen for Valve Corporation
+ * SPDX-License-Identifier: MIT
+ */
+
+#define NOMINMAX
+#include "texel_repack.hpp"
+#include "logging.hpp"
+#include <chrono>
+#include <string.h>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define REPACK_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define REPACK_TARGET(x)
+#else
+#define REPACK_TARGET(x) __attribute__((target(x)))
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define REPACK_NEON 1
+#include <arm_neon.h>
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define REPACK_NEON_TBL 1
+#endif
+#endif
+
+namespace Util
+{
+void repack_texels_scalar(uint8_t *dst, const uint8_t *src, size_t count,
+                          uint32_t src_stride, uint32_t offset, uint32_t size)
+{
+	src += offset;
+	for (size_t i = 0; i < count; i++)
+	{
+		memcpy(dst, src, size);
+		dst += size;
+		src += src_stride;
+	}
+}
+
+// Each kernel handles a prefix of the texels and returns how many it processed.
+// The scalar path finishes the tail.
+using RepackKernel = size_t (*)(uint8_t *, const uint8_t *, size_t, uint32_t, uint32_t, uint32_t);
+
+// Byte shuffle which gathers the requested bytes of all texels in a 16 byte block.
+// Only valid when texels do not straddle blocks.
+static bool build_block_shuffle(uint8_t mask[16], uint32_t src_stride, uint32_t offset, uint32_t size,
+                                uint32_t &texels_per_block, uint32_t &bytes_per_block)
+{
+	if (src_stride > 16 || 16 % src_stride != 0)
+		return false;
+
+	texels_per_block = 16 / src_stride;
+	bytes_per_block = texels_per_block * size;
+
+	for (uint32_t i = 0; i < 16; i++)
+		mask[i] = i < bytes_per_block ? uint8_t((i / size) * src_stride + offset + (i % size)) : 0x80;
+
+	return true;
+}
+
+#ifdef REPACK_X86
+static size_t repack_sse2(uint8_t *dst, const uint8_t *src, size_t count,
+                          uint32_t src_stride, uint32_t offset, uint32_t size)
+{
+	size_t i = 0;
+
+	if (src_stride == 8 && size == 4 && (offset == 0 || offset == 4))
+	{
+		// D32 out of D32S8X24 and similar.
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 a = _mm_loadu_ps(reinterpret_cast<const float *>(src + 8 * i));
+			__m128 b = _mm_loadu_ps(reinterpret_cast<const float *>(src + 8 * i + 16));
+			__m128 v = offset == 0 ? _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)) :
+			                         _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+			_mm_storeu_ps(reinterpret_cast<float *>(dst + 4 * i), v);
+		}
+	}
+	else if (src_stride == 4 && size == 1)
+	{
+		// Stencil out of D24S8 and similar.
+		const __m128i byte_mask = _mm_set1_epi32(0xff);
+		for (; i + 16 <= count; i += 16)
+		{
+			auto *s = reinterpret_cast<const __m128i *>(src + 4 * i);
+			__m128i v0 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(s + 0), _mm_cvtsi32_si128(8 * offset)), byte_mask);
+			__m128i v1 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(s + 1), _mm_cvtsi32_si128(8 * offset)), byte_mask);
+			__m128i v2 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(s + 2), _mm_cvtsi32_si128(8 * offset)), byte_mask);
+			__m128i v3 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(s + 3), _mm_cvtsi32_si128(8 * offset)), byte_mask);
+			__m128i lo = _mm_packs_epi32(v0, v1);
+			__m128i hi = _mm_packs_epi32(v2, v3);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(lo, hi));
+		}
+	}
+	else if (src_stride == 4 && size == 2 && (offset == 0 || offset == 2))
+	{
+		// Sign extend the 16-bit half so the signed saturating pack is exact.
+		const __m128i shift_left = _mm_cvtsi32_si128(16 - 8 * offset);
+		for (; i + 8 <= count; i += 8)
+		{
+			auto *s = reinterpret_cast<const __m128i *>(src + 4 * i);
+			__m128i v0 = _mm_srai_epi32(_mm_sll_epi32(_mm_loadu_si128(s + 0), shift_left), 16);
+			__m128i v1 = _mm_srai_epi32(_mm_sll_epi32(_mm_loadu_si128(s + 1), shift_left), 16);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2 * i), _mm_packs_epi32(v0, v1));
+		}
+	}
+
+	return i;
+}
+
+REPACK_TARGET("ssse3")
+static size_t repack_ssse3(uint8_t *dst, const uint8_t *src, size_t count,
+                           uint32_t src_stride, uint32_t offset, uint32_t size)
+{
+	alignas(16) uint8_t mask_bytes[16];
+	uint32_t texels_per_block, bytes_per_block;
+	if (!build_block_shuffle(mask_bytes, src_stride, offset, size, texels_per_block, bytes_per_block))
+		return repack_sse2(dst, src, count, src_stride, offset, size);
+
+	const __m128i mask = _mm_load_si128(reinterpret_cast<const __m128i *>(mask_bytes));
+	size_t i = 0;
+
+	// Stores are a full 16 bytes, stop while there is still room for the overhang.
+	while (i + texels_per_block <= count && (count - i) * size >= 16)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * src_stride));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * size), _mm_shuffle_epi8(v, mask));
+		i += texels_per_block;
+	}
+
+	return i;
+}
+
+REPACK_TARGET("avx2")
+static size_t repack_avx2(uint8_t *dst, const uint8_t *src, size_t count,
+                          uint32_t src_stride, uint32_t offset, uint32_t size)
+{
+	alignas(16) uint8_t mask_bytes[16];
+	uint32_t texels_per_block, bytes_per_block;
+
+	// The shuffle is per 128-bit lane, so the two lanes are compacted with a dword permute afterwards.
+	if (!build_block_shuffle(mask_bytes, src_stride, offset, size, texels_per_block, bytes_per_block) ||
+	    bytes_per_block % 4 != 0)
+	{
+		return repack_ssse3(dst, src, count, src_stride, offset, size);
+	}
+
+	const __m256i mask = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(mask_bytes)));
+
+	alignas(32) int32_t permute_indices[8] = {};
+	uint32_t dwords_per_lane = bytes_per_block / 4;
+	for (uint32_t i = 0; i < dwords_per_lane; i++)
+	{
+		permute_indices[i] = int32_t(i);
+		permute_indices[i + dwords_per_lane] = int32_t(i + 4);
+	}
+	const __m256i permute = _mm256_load_si256(reinterpret_cast<const __m256i *>(permute_indices));
+
+	uint32_t texels_per_iteration = 2 * texels_per_block;
+	size_t i = 0;
+
+	while (i + texels_per_iteration <= count && (count - i) * size >= 32)
+	{
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * src_stride));
+		v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, mask), permute);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * size), v);
+		i += texels_per_iteration;
+	}
+
+	// Finish what is left with 16 byte stores.
+	return i + repack_ssse3(dst + i * size, src + i * src_stride, count - i, src_stride, offset, size);
+}
+
+static const char *x86_isa_name;
+
+static RepackKernel select_x86_kernel()
+{
+#ifdef _MSC_VER
+	int regs[4];
+	__cpuid(regs, 1);
+	bool has_ssse3 = (regs[2] & (1 << 9)) != 0;
+	bool has_avx = (regs[2] & (1 << 28)) != 0 && (regs[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+	__cpuidex(regs, 7, 0);
+	bool has_avx2 = has_avx && (regs[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	bool has_ssse3 = __builtin_cpu_supports("ssse3");
+	bool has_avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+	if (has_avx2)
+	{
+		x86_isa_name = "AVX2";
+		return repack_avx2;
+	}
+	else if (has_ssse3)
+	{
+		x86_isa_name = "SSSE3";
+		return repack_ssse3;
+	}
+	else
+	{
+		x86_isa_name = "SSE2";
+		return repack_sse2;
+	}
+}
+#endif
+
+#ifdef REPACK_NEON
+static size_t repack_neon(uint8_t *dst, const uint8_t *src, size_t count,
+                          uint32_t src_stride, uint32_t offset, uint32_t size)
+{
+	size_t i = 0;
+
+	if (src_stride == 4)
+	{
+		// Deinterleave 16 texels into byte planes and store back the planes we want.
+		for (; i + 16 <= count; i += 16)
+		{
+			uint8x16x4_t v = vld4q_u8(src + 4 * i);
+			if (size == 1)
+			{
+				vst1q_u8(dst + i, v.val[offset]);
+			}
+			else if (size == 2)
+			{
+				uint8x16x2_t out = { { v.val[offset], v.val[offset + 1] } };
+				vst2q_u8(dst + 2 * i, out);
+			}
+			else
+			{
+				uint8x16x3_t out = { { v.val[offset], v.val[offset + 1], v.val[offset + 2] } };
+				vst3q_u8(dst + 3 * i, out);
+			}
+		}
+	}
+	else if (src_stride == 8 && size == 4 && (offset == 0 || offset == 4))
+	{
+		for (; i + 4 <= count; i += 4)
+		{
+			uint32x4x2_t v = vld2q_u32(reinterpret_cast<const uint32_t *>(src + 8 * i));
+			vst1q_u32(reinterpret_cast<uint32_t *>(dst + 4 * i), v.val[offset / 4]);
+		}
+	}
+#ifdef REPACK_NEON_TBL
+	else
+	{
+		uint8_t mask_bytes[16];
+		uint32_t texels_per_block, bytes_per_block;
+		if (build_block_shuffle(mask_bytes, src_stride, offset, size, texels_per_block, bytes_per_block))
+		{
+			// Out of range indices produce zero with TBL, same as the x86 shuffle.
+			uint8x16_t mask = vld1q_u8(mask_bytes);
+			while (i + texels_per_block <= count && (count - i) * size >= 16)
+			{
+				vst1q_u8(dst + i * size, vqtbl1q_u8(vld1q_u8(src + i * src_stride), mask));
+				i += texels_per_block;
+			}
+		}
+	}
+#endif
+
+	return i;
+}
+#endif
+
+static RepackKernel get_kernel()
+{
+#if defined(REPACK_X86)
+	static RepackKernel kernel = select_x86_kernel();
+	return kernel;
+#elif defined(REPACK_NEON)
+	return repack_neon;
+#else
+	return nullptr;
+#endif
+}
+
+const char *get_repack_isa()
+{
+#if defined(REPACK_X86)
+	get_kernel();
+	return x86_isa_name;
+#elif defined(REPACK_NEON)
+	return "NEON";
+#else
+	return "scalar";
+#endif
+}
+
+void repack_texels(uint8_t *dst, const uint8_t *src, size_t count,
+                   uint32_t src_stride, uint32_t offset, uint32_t size)
+{
+	if (offset == 0 && size == src_stride)
+	{
+		memcpy(dst, src, count * size);
+		return;
+	}
+
+	size_t done = 0;
+	if (auto *kernel = get_kernel())
+		done = kernel(dst, src, count, src_stride, offset, size);
+
+	if (done < count)
+		repack_texels_scalar(dst + done * size, src + done * src_stride, count - done, src_stride, offset, size);
+}
+
+bool run_repack_benchmark()
+{
+	struct Case
+	{
+		const char *name;
+		uint32_t stride, offset, size;
+	};
+
+	static const Case cases[] = {
+		{ "D24S8 depth", 4, 0, 3 },
+		{ "D24S8 stencil", 4, 3, 1 },
+		{ "D32S8X24 depth", 8, 0, 4 },
+		{ "D32S8X24 stencil", 8, 4, 1 },
+		{ "R16G16 -> R16", 4, 0, 2 },
+		{ "R16G16 -> G16", 4, 2, 2 },
+		{ "RGBA16 -> RG16", 8, 0, 4 },
+	};
+
+	// One row of a 4K texture per call, like the footprint repack does.
+	const uint32_t width = 4096;
+	const uint32_t height = 2048;
+	const size_t count = size_t(width) * height;
+
+	std::vector<uint8_t> src(count * 8);
+	uint32_t seed = 1;
+	for (auto &b : src)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		b = uint8_t(seed >> 24);
+	}
+
+	std::vector<uint8_t> reference(count * 4), output(count * 4);
+	bool success = true;
+
+	LOGI("Repack benchmark, %u x %u texels, using %s.\n", width, height, get_repack_isa());
+
+	for (auto &c : cases)
+	{
+		auto run = [&](bool vectorized, uint8_t *dst) {
+			double best = 1e30;
+			for (int rep = 0; rep < 5; rep++)
+			{
+				auto start = std::chrono::steady_clock::now();
+				for (uint32_t y = 0; y < height; y++)
+				{
+					const uint8_t *s = src.data() + size_t(y) * width * c.stride;
+					uint8_t *d = dst + size_t(y) * width * c.size;
+					if (vectorized)
+						repack_texels(d, s, width, c.stride, c.offset, c.size);
+					else
+						repack_texels_scalar(d, s, width, c.stride, c.offset, c.size);
+				}
+				auto end = std::chrono::steady_clock::now();
+				double t = std::chrono::duration<double>(end - start).count();
+				if (t < best)
+					best = t;
+			}
+			return best;
+		};
+
+		double scalar_time = run(false, reference.data());
+		double simd_time = run(true, output.data());
+		bool match = memcmp(reference.data(), output.data(), count * c.size) == 0;
+		success = success && match;
+
+		double gib = double(count) * c.stride / (1024.0 * 1024.0 * 1024.0);
+		LOGI("  %-18s scalar %8.3f ms (%6.2f GiB/s), %s %8.3f ms (%6.2f GiB/s), %5.2fx%s\n",
+		     c.name, scalar_time * 1e3, gib / scalar_time, get_repack_isa(),
+		     simd_time * 1e3, gib / simd_time, scalar_time / simd_time,
+		     match ? "" : " MISMATCH");
+	}
+
+	return success;
+}
+}
@@ -0,0 +1,29 @@
+/* Copyright (c) 2025 Hans-Kristian Arntzen for Valve Corporation
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Util
+{
+// Extracts size bytes starting at byte offset from each of count texels which are src_stride bytes apart,
+// and writes them tightly packed to dst. E.g. stride 4, offset 0, size 3 extracts depth from D24S8,
+// stride 8, offset 4, size 1 extracts stencil from D32S8X24.
+// dst must not overlap src. Only count * size bytes are written.
+void repack_texels(uint8_t *dst, const uint8_t *src, size_t count,
+                   uint32_t src_stride, uint32_t offset, uint32_t size);
+
+// Reference implementation, one texel at a time.
+void repack_texels_scalar(uint8_t *dst, const uint8_t *src, size_t count,
+                          uint32_t src_stride, uint32_t offset, uint32_t size);
+
+// Name of the instruction set repack_texels picked on this CPU.
+const char *get_repack_isa();
+
+// Compares the vectorized kernels against the scalar path for common depth-stencil layouts.
+// Returns false if any kernel produced different results.
+bool run_repack_benchmark();
+}
@@ -0,0 +1,278 @@
+/* Copyright (c) 2025 Hans-Kristian Arntzen for Valve Corporation
+ * SPDX-License-Identifier: MIT
+ */
+
+#define NOMINMAX
+#include "timing_stats.hpp"
+#include "logging.hpp"
+#include <algorithm>
+#include <math.h>
+#include <utility>
+
+namespace Util
+{
+// Bucket i covers (gamma^(i-1), gamma^i], so any value in a bucket is within 1% of its midpoint.
+static constexpr double SketchGamma = 1.02;
+
+static uint32_t get_bucket_index(uint64_t ticks)
+{
+	if (ticks <= 1)
+		return 0;
+	return uint32_t(ceil(log(double(ticks)) / log(SketchGamma)));
+}
+
+static double get_bucket_value(uint32_t index)
+{
+	return 2.0 * pow(SketchGamma, double(index)) / (SketchGamma + 1.0);
+}
+
+static double get_sorted_quantile(const std::vector<uint64_t> &sorted, double q)
+{
+	if (sorted.empty())
+		return 0.0;
+
+	double pos = q * double(sorted.size() - 1);
+	size_t lo = size_t(pos);
+	size_t hi = std::min(lo + 1, sorted.size() - 1);
+	double frac = pos - double(lo);
+	return double(sorted[lo]) * (1.0 - frac) + double(sorted[hi]) * frac;
+}
+
+TimingStats::TimingStats(size_t max_exact_samples_)
+	: max_exact_samples(max_exact_samples_)
+{
+}
+
+void TimingStats::add(uint64_t ticks)
+{
+	add_to_sketch(ticks);
+
+	if (exact)
+	{
+		if (samples.size() < max_exact_samples)
+		{
+			samples.push_back(ticks);
+		}
+		else
+		{
+			exact = false;
+			samples.clear();
+			samples.shrink_to_fit();
+		}
+	}
+}
+
+void TimingStats::add_to_sketch(uint64_t ticks)
+{
+	uint32_t index = get_bucket_index(ticks);
+	if (index >= buckets.size())
+		buckets.resize(index + 1);
+	buckets[index]++;
+
+	count++;
+	min_value = std::min(min_value, ticks);
+	max_value = std::max(max_value, ticks);
+
+	// Welford, so mean and variance stay available once exact samples are gone.
+	double delta = double(ticks) - mean;
+	mean += delta / double(count);
+	m2 += delta * (double(ticks) - mean);
+}
+
+void TimingStats::clear()
+{
+	samples.clear();
+	buckets.clear();
+	exact = true;
+	count = 0;
+	min_value = UINT64_MAX;
+	max_value = 0;
+	mean = 0.0;
+	m2 = 0.0;
+}
+
+uint64_t TimingStats::get_count() const
+{
+	return count;
+}
+
+const std::vector<uint64_t> &TimingStats::get_samples() const
+{
+	return samples;
+}
+
+std::vector<uint64_t> TimingStats::get_filtered_samples(bool reject_outliers) const
+{
+	auto sorted = samples;
+	std::sort(sorted.begin(), sorted.end());
+
+	if (!reject_outliers || sorted.size() < 3)
+		return sorted;
+
+	double median = get_sorted_quantile(sorted, 0.5);
+	std::vector<double> deviations;
+	deviations.reserve(sorted.size());
+	for (auto v : sorted)
+		deviations.push_back(fabs(double(v) - median));
+
+	auto mid = deviations.begin() + deviations.size() / 2;
+	std::nth_element(deviations.begin(), mid, deviations.end());
+	double mad = *mid;
+
+	// A zero MAD means most samples are identical, nothing sensible to reject against.
+	if (mad == 0.0)
+		return sorted;
+
+	// 1.4826 scales MAD to a standard deviation for normally distributed data.
+	double threshold = 3.5 * 1.4826 * mad;
+	sorted.erase(std::remove_if(sorted.begin(), sorted.end(), [&](uint64_t v) {
+		return fabs(double(v) - median) > threshold;
+	}), sorted.end());
+
+	return sorted;
+}
+
+double TimingStats::sketch_quantile(double q) const
+{
+	uint64_t rank = uint64_t(q * double(count - 1));
+	uint64_t seen = 0;
+
+	for (uint32_t i = 0; i < uint32_t(buckets.size()); i++)
+	{
+		seen += buckets[i];
+		if (seen > rank)
+			return std::min(std::max(get_bucket_value(i), double(min_value)), double(max_value));
+	}
+
+	return double(max_value);
+}
+
+TimingStats::Summary TimingStats::summarize(bool reject_outliers) const
+{
+	Summary summary;
+	if (count == 0)
+		return summary;
+
+	if (!exact)
+	{
+		summary.count = count;
+		summary.exact = false;
+		summary.min = double(min_value);
+		summary.max = double(max_value);
+		summary.mean = mean;
+		summary.stddev = count > 1 ? sqrt(m2 / double(count - 1)) : 0.0;
+		summary.p50 = sketch_quantile(0.50);
+		summary.p90 = sketch_quantile(0.90);
+		summary.p99 = sketch_quantile(0.99);
+		return summary;
+	}
+
+	auto sorted = get_filtered_samples(reject_outliers);
+	summary.count = sorted.size();
+	summary.rejected = samples.size() - sorted.size();
+
+	double sum = 0.0;
+	for (auto v : sorted)
+		sum += double(v);
+	summary.mean = sum / double(sorted.size());
+
+	double sq = 0.0;
+	for (auto v : sorted)
+		sq += (double(v) - summary.mean) * (double(v) - summary.mean);
+	summary.stddev = sorted.size() > 1 ? sqrt(sq / double(sorted.size() - 1)) : 0.0;
+
+	summary.min = double(sorted.front());
+	summary.max = double(sorted.back());
+	summary.p50 = get_sorted_quantile(sorted, 0.50);
+	summary.p90 = get_sorted_quantile(sorted, 0.90);
+	summary.p99 = get_sorted_quantile(sorted, 0.99);
+	return summary;
+}
+
+double TimingStats::get_median_relative_error(double z) const
+{
+	if (count < 16)
+		return -1.0;
+
+	// Ranks of the order statistics bounding the median, from the normal approximation to the binomial.
+	double spread = 0.5 * z / sqrt(double(count));
+	double lo, hi, median;
+
+	if (exact)
+	{
+		auto sorted = samples;
+		std::sort(sorted.begin(), sorted.end());
+		lo = get_sorted_quantile(sorted, 0.5 - spread);
+		hi = get_sorted_quantile(sorted, 0.5 + spread);
+		median = get_sorted_quantile(sorted, 0.5);
+	}
+	else
+	{
+		lo = sketch_quantile(0.5 - spread);
+		hi = sketch_quantile(0.5 + spread);
+		median = sketch_quantile(0.5);
+	}
+
+	if (median <= 0.0)
+		return -1.0;
+
+	return 0.5 * (hi - lo) / median;
+}
+
+void TimingStats::log_histogram(bool reject_outliers, double scale, const char *unit, unsigned num_bins) const
+{
+	if (count == 0 || num_bins == 0)
+		return;
+
+	// Value and weight pairs, either raw samples or sketch buckets.
+	std::vector<std::pair<double, uint64_t>> values;
+	if (exact)
+	{
+		for (auto v : get_filtered_samples(reject_outliers))
+			values.emplace_back(double(v), 1);
+	}
+	else
+	{
+		for (uint32_t i = 0; i < uint32_t(buckets.size()); i++)
+			if (buckets[i])
+				values.emplace_back(get_bucket_value(i), buckets[i]);
+	}
+
+	if (values.empty())
+		return;
+
+	double lo = values.front().first;
+	double hi = values.front().first;
+	for (auto &v : values)
+	{
+		lo = std::min(lo, v.first);
+		hi = std::max(hi, v.first);
+	}
+
+	if (hi == lo)
+		num_bins = 1;
+
+	std::vector<uint64_t> bins(num_bins);
+	double bin_width = (hi - lo) / double(num_bins);
+	for (auto &v : values)
+	{
+		unsigned bin = bin_width > 0.0 ? unsigned((v.first - lo) / bin_width) : 0;
+		bins[std::min(bin, num_bins - 1)] += v.second;
+	}
+
+	uint64_t max_bin = *std::max_element(bins.begin(), bins.end());
+	constexpr unsigned BarWidth = 40;
+	char bar[BarWidth + 1];
+
+	for (unsigned i = 0; i < num_bins; i++)
+	{
+		unsigned len = max_bin ? unsigned((bins[i] * BarWidth + max_bin - 1) / max_bin) : 0;
+		std::fill(bar, bar + len, '#');
+		bar[len] = '\0';
+
+		LOGI("  %10.3f - %10.3f %s | %-*s %llu\n",
+		     (lo + bin_width * i) * scale, (lo + bin_width * (i + 1)) * scale, unit,
+		     int(BarWidth), bar, static_cast<unsigned long long>(bins[i]));
+	}
+}
+}
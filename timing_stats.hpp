@@ -0,0 +1,70 @@
+/* Copyright (c) 2025 Hans-Kristian Arntzen for Valve Corporation
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace Util
+{
+// Collects per-dispatch timestamp deltas. Every sample is kept up to a limit,
+// after which only a log-bucketed sketch with ~1% relative error is maintained.
+class TimingStats
+{
+public:
+	TimingStats() = default;
+	explicit TimingStats(size_t max_exact_samples);
+
+	void add(uint64_t ticks);
+	void clear();
+	uint64_t get_count() const;
+
+	// In the order they were added. Empty once only the sketch is kept.
+	const std::vector<uint64_t> &get_samples() const;
+
+	struct Summary
+	{
+		uint64_t count = 0;
+		// Samples discarded by outlier rejection.
+		uint64_t rejected = 0;
+		bool exact = true;
+		double min = 0.0;
+		double max = 0.0;
+		double mean = 0.0;
+		double stddev = 0.0;
+		double p50 = 0.0;
+		double p90 = 0.0;
+		double p99 = 0.0;
+	};
+
+	// All values in ticks. Outlier rejection drops samples further than
+	// 3.5 scaled median absolute deviations from the median. It needs exact samples.
+	Summary summarize(bool reject_outliers) const;
+
+	// Half-width of the distribution-free confidence interval on the median, relative to the median.
+	// Returns a negative value until there are enough samples to tell.
+	double get_median_relative_error(double z = 1.96) const;
+
+	// Logs a text histogram. scale converts ticks to the printed unit.
+	void log_histogram(bool reject_outliers, double scale, const char *unit, unsigned num_bins = 16) const;
+
+private:
+	size_t max_exact_samples = 16 * 1024 * 1024;
+	std::vector<uint64_t> samples;
+	bool exact = true;
+
+	std::vector<uint64_t> buckets;
+	uint64_t count = 0;
+	uint64_t min_value = UINT64_MAX;
+	uint64_t max_value = 0;
+	double mean = 0.0;
+	double m2 = 0.0;
+
+	void add_to_sketch(uint64_t ticks);
+	std::vector<uint64_t> get_filtered_samples(bool reject_outliers) const;
+	double sketch_quantile(double q) const;
+};
+}